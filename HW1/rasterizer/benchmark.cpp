@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "loader.hpp"
+#include "meshorder.hpp"
+#include "renderer.hpp"
+#include "syntheticscene.hpp"
+
+// Renders a generated scene several times and reports the median time of each pipeline stage, and
+//  the vertex and cache line misses per triangle of the loaded mesh (see AnalyzeLocality).
+//  Results can be saved as a baseline and later runs compared against it.
+
+static void PrintUsage()
+{
+    std::cout <<
+        "usage: RasterizerBenchmark [options]\n"
+        "  --triangles N      number of triangles (10000)\n"
+        "  --size S           triangle edge length in pixels (16)\n"
+        "  --overdraw O       average triangles per covered pixel (2)\n"
+        "  --lights L         number of point lights (2)\n"
+        "  --light-cutoff C   light-cutoff of the shading task, 0 shades with every light (1)\n"
+        "  --resolution WxH   viewport (800x800)\n"
+        "  --task T           shading | shading-depth | transform | triangle (shading)\n"
+        "  --mode M           shading mode, forward | visibility (visibility)\n"
+        "  --simd S           auto | scalar | SSE | AVX2 (auto)\n"
+        "  --seed N           scene seed (1)\n"
+        "  --format F         png | qoi | ppm | raw (png)\n"
+        "  --png-level N      PNG compression level, 0 to 9 (6)\n"
+        "  --geometry G       soup | grid, separate triangles or shuffled connected grids (soup)\n"
+        "  --order O          mesh order applied at load, none | cache | morton (cache)\n"
+        "  --frames N         measured frames (5), after one warm-up frame\n"
+        "  --scene NAME       basename of the generated obj/yaml/output files (benchmark-scene)\n"
+        "  --save FILE        save the results as a baseline\n"
+        "  --compare FILE     compare against a saved baseline\n"
+        "  --tolerance P      percentage a stage may slow down before it counts as a regression (10)\n";
+}
+
+static double Median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return (n % 2) ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+// Baselines are plain "key value" lines; scene parameters are stored as strings, results as numbers
+static std::map<std::string, std::string> ReadBaseline(const std::string& filename)
+{
+    std::ifstream file(filename);
+    if (!file)
+        throw std::runtime_error("cannot read baseline " + filename);
+
+    std::map<std::string, std::string> entries;
+    std::string key, value;
+    while (file >> key >> value)
+        entries[key] = value;
+    return entries;
+}
+
+int main(int argc, char** argv)
+{
+    SyntheticSceneConfig scene;
+    uint32_t frames = 5;
+    std::string sceneName = "benchmark-scene";
+    std::string saveName, compareName;
+    double tolerance = 10.0;
+
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h")
+            {
+                PrintUsage();
+                return 0;
+            }
+            if (i + 1 >= argc)
+                throw std::runtime_error("missing value for " + arg);
+            std::string value = argv[++i];
+
+            if (arg == "--triangles")
+                scene.triangles = static_cast<uint32_t>(std::stoul(value));
+            else if (arg == "--size")
+                scene.size = std::stof(value);
+            else if (arg == "--overdraw")
+                scene.overdraw = std::stof(value);
+            else if (arg == "--lights")
+                scene.lights = static_cast<uint32_t>(std::stoul(value));
+            else if (arg == "--light-cutoff")
+                scene.lightCutoff = std::stof(value);
+            else if (arg == "--resolution")
+            {
+                size_t x = value.find('x');
+                if (x == std::string::npos)
+                    throw std::runtime_error("resolution should look like 800x600");
+                scene.width = static_cast<uint32_t>(std::stoul(value.substr(0, x)));
+                scene.height = static_cast<uint32_t>(std::stoul(value.substr(x + 1)));
+            }
+            else if (arg == "--task")
+                scene.task = value;
+            else if (arg == "--mode")
+                scene.shadingMode = value;
+            else if (arg == "--simd")
+                scene.simd = value;
+            else if (arg == "--seed")
+                scene.seed = static_cast<uint32_t>(std::stoul(value));
+            else if (arg == "--format")
+                scene.format = value;
+            else if (arg == "--png-level")
+                scene.pngLevel = static_cast<uint32_t>(std::stoul(value));
+            else if (arg == "--geometry")
+                scene.geometry = value;
+            else if (arg == "--order")
+                scene.meshOrder = value;
+            else if (arg == "--frames")
+                frames = std::max(1u, static_cast<uint32_t>(std::stoul(value)));
+            else if (arg == "--scene")
+                sceneName = value;
+            else if (arg == "--save")
+                saveName = value;
+            else if (arg == "--compare")
+                compareName = value;
+            else if (arg == "--tolerance")
+                tolerance = std::stod(value);
+            else
+                throw std::runtime_error("unknown option " + arg);
+        }
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        PrintUsage();
+        return 2;
+    }
+
+    std::vector<double> load, vertex, depth, shade, write, total;
+    RenderStats last;
+    MeshLocality locality;
+    try
+    {
+        std::string yamlName = WriteSyntheticScene(scene, sceneName);
+        std::vector<char> yamlArg(yamlName.begin(), yamlName.end());
+        yamlArg.push_back('\0');
+        char* renderArgs[] = { argv[0], yamlArg.data() };
+
+        for (uint32_t frame = 0; frame <= frames; ++frame)
+        {
+            Renderer renderer(yamlName);
+            renderer.SetVerbose(false);
+            renderer.Render(2, renderArgs);
+
+            last = renderer.GetStats();
+            if (last.culling.submitted == 0 && scene.triangles != 0)
+                throw std::runtime_error("the generated scene failed to render");
+            if (frame == 0)
+                continue;               // warm-up: page faults, kernel selection, sample tables
+            load.push_back(last.load);
+            vertex.push_back(last.vertex);
+            depth.push_back(last.depth);
+            shade.push_back(last.shade);
+            write.push_back(last.write);
+            total.push_back(last.Total());
+        }
+
+        // how the vertex stage walks the loaded mesh, read back from the cache the renders left
+        Loader loader(yamlName);
+        if (!loader.Load())
+            throw std::runtime_error("cannot reload " + yamlName);
+        locality = AnalyzeLocality(loader.GetMesh());
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Benchmark failed..." << std::endl;
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    std::map<std::string, double> results;
+    results["load_ms"] = Median(load);
+    results["vertex_ms"] = Median(vertex);
+    results["depth_ms"] = Median(depth);
+    results["shade_ms"] = Median(shade);
+    results["write_ms"] = Median(write);
+    results["total_ms"] = Median(total);
+    results["vertex_misses"] = locality.vertexMisses;
+    results["line_misses"] = locality.lineMisses;
+
+    // throughput over the stages that scale with geometry and fragments
+    double geometryMs = results["vertex_ms"] + results["depth_ms"] + results["shade_ms"];
+    double rasterMs = results["depth_ms"] + results["shade_ms"];
+    results["triangles_per_s"] = geometryMs > 0 ? 1000.0 * last.culling.submitted / geometryMs : 0;
+    results["pixels_per_s"] = rasterMs > 0 ? 1000.0 * last.pixels / rasterMs : 0;
+
+    std::ostringstream params;
+    params << "task " << scene.task << "\nmode " << scene.shadingMode << "\nsimd " << scene.simd
+        << "\ntriangles " << scene.triangles << "\nsize " << scene.size << "\noverdraw " << scene.overdraw
+        << "\nlights " << scene.lights << "\nlight-cutoff " << scene.lightCutoff << "\nresolution " << scene.width << 'x' << scene.height
+        << "\nseed " << scene.seed << "\ngeometry " << scene.geometry << "\norder " << scene.meshOrder
+        << "\nformat " << scene.format;
+    if (scene.format == "png")
+        params << " (level " << scene.pngLevel << ")";
+    params << "\n";
+
+    std::cout << params.str()
+        << "rasterized " << last.triangles << " triangles, " << static_cast<uint64_t>(last.pixels) << " pixels ("
+        << last.culling.Culled() << " culled), median of " << frames << " frames\n";
+
+    const char* order[] = { "load_ms", "vertex_ms", "depth_ms", "shade_ms", "write_ms", "total_ms",
+                            "triangles_per_s", "pixels_per_s", "vertex_misses", "line_misses" };
+
+    std::map<std::string, std::string> baseline;
+    if (!compareName.empty())
+    {
+        try
+        {
+            baseline = ReadBaseline(compareName);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 2;
+        }
+
+        // comparing different workloads is allowed, but the numbers are then only indicative
+        std::istringstream lines(params.str());
+        std::string key, value;
+        while (lines >> key >> value)
+            if (baseline.count(key) && baseline[key] != value)
+                std::cout << "[WARNING] baseline was taken with " << key << " " << baseline[key] << "\n";
+    }
+
+    bool regressed = false;
+    std::cout << std::fixed;
+    for (const char* key : order)
+    {
+        double value = results[key];
+        bool isRate = std::string(key).find("_per_s") != std::string::npos;
+        std::cout << std::left << std::setw(16) << key << std::right << std::setw(16)
+            << std::setprecision(isRate ? 0 : 3) << value;
+
+        if (baseline.count(key))
+        {
+            double before = std::stod(baseline[key]);
+            double change = before > 0 ? 100.0 * (value - before) / before : 0;
+            // times regress upwards, throughputs downwards
+            bool regression = isRate ? (change < -tolerance) : (change > tolerance);
+            regressed = regressed || regression;
+            std::cout << std::setw(16) << std::setprecision(isRate ? 0 : 3) << before
+                << std::setw(10) << std::setprecision(1) << std::showpos << change << std::noshowpos << "%"
+                << (regression ? "  REGRESSION" : "");
+        }
+        std::cout << "\n";
+    }
+
+    if (!saveName.empty())
+    {
+        std::ofstream file(saveName);
+        if (!file)
+        {
+            std::cerr << "cannot write baseline " << saveName << std::endl;
+            return 2;
+        }
+        file << params.str() << std::setprecision(6);
+        for (const char* key : order)
+            file << key << " " << results[key] << "\n";
+        std::cout << "saved baseline to " << saveName << "\n";
+    }
+
+    return regressed ? 1 : 0;
+}
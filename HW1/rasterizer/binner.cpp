@@ -0,0 +1,60 @@
+#include "binner.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+bool ClampedBoundingBox(const Triangle& trig, const TileRect& bounds, TileRect& box)
+{
+    float xmin = std::min({ trig.pos[0].x, trig.pos[1].x, trig.pos[2].x });
+    float xmax = std::max({ trig.pos[0].x, trig.pos[1].x, trig.pos[2].x });
+    float ymin = std::min({ trig.pos[0].y, trig.pos[1].y, trig.pos[2].y });
+    float ymax = std::max({ trig.pos[0].y, trig.pos[1].y, trig.pos[2].y });
+
+    // also rejects NaN coordinates, for which every comparison is false
+    if (!(xmax >= static_cast<float>(bounds.x0) && xmin < static_cast<float>(bounds.x1) &&
+          ymax >= static_cast<float>(bounds.y0) && ymin < static_cast<float>(bounds.y1)))
+        return false;
+
+    // clamp in float so that far off-screen coordinates never overflow the integer conversion
+    box.x0 = static_cast<uint32_t>(std::max(std::floor(xmin), static_cast<float>(bounds.x0)));
+    box.y0 = static_cast<uint32_t>(std::max(std::floor(ymin), static_cast<float>(bounds.y0)));
+    box.x1 = static_cast<uint32_t>(std::min(std::floor(xmax) + 1.f, static_cast<float>(bounds.x1)));
+    box.y1 = static_cast<uint32_t>(std::min(std::floor(ymax) + 1.f, static_cast<float>(bounds.y1)));
+    return !box.Empty();
+}
+
+TileBinner::TileBinner(uint32_t width, uint32_t height, uint32_t tileSize) :
+    width(width),
+    height(height),
+    tileSize(std::max(tileSize, 1u)),
+    tilesX((width + this->tileSize - 1) / this->tileSize),
+    tilesY((height + this->tileSize - 1) / this->tileSize),
+    bins(static_cast<size_t>(tilesX) * tilesY)
+{  }
+
+void TileBinner::Clear()
+{
+    for (auto& bin : bins)
+        bin.clear();
+}
+
+void TileBinner::Bin(const Triangle& trig, uint32_t index)
+{
+    TileRect box;
+    if (!ClampedBoundingBox(trig, { 0, 0, width, height }, box))
+        return;
+
+    for (uint32_t ty = box.y0 / tileSize; ty <= (box.y1 - 1) / tileSize; ++ty)
+        for (uint32_t tx = box.x0 / tileSize; tx <= (box.x1 - 1) / tileSize; ++tx)
+            bins[static_cast<size_t>(ty) * tilesX + tx].push_back(index);
+}
+
+TileRect TileBinner::GetTileRect(size_t tile) const
+{
+    uint32_t tx = static_cast<uint32_t>(tile % tilesX);
+    uint32_t ty = static_cast<uint32_t>(tile / tilesX);
+    return {
+        tx * tileSize, ty * tileSize,
+        std::min((tx + 1) * tileSize, width), std::min((ty + 1) * tileSize, height)
+    };
+}
@@ -0,0 +1,43 @@
+#ifndef BINNER_H
+#define BINNER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entities.hpp"
+
+// Sorts screen-space triangles into fixed-size screen tiles (sort-middle).
+//  Every tile keeps the indices of the triangles whose bounding box touches it,
+//  in the order they were binned, so rasterizing a tile's list reproduces the
+//  per-pixel drawing order of a serial pass over all triangles.
+class TileBinner
+{
+public:
+    TileBinner(uint32_t width, uint32_t height, uint32_t tileSize = 64);
+
+    // Drop all binned triangles, keeping the tile grid
+    void Clear();
+
+    // Add a triangle that has already been homogenized to screen space
+    void Bin(const Triangle& trig, uint32_t index);
+
+    inline size_t GetTileCount() const { return bins.size(); }
+    inline uint32_t GetTileSize() const { return tileSize; }
+    inline const std::vector<uint32_t>& GetBin(size_t tile) const { return bins[tile]; }
+    TileRect GetTileRect(size_t tile) const;
+
+private:
+    uint32_t width, height;
+    uint32_t tileSize;
+    uint32_t tilesX, tilesY;
+    std::vector<std::vector<uint32_t>> bins;
+};
+
+/**
+ * Compute the pixels in the bounding box of a screen-space triangle that fall inside `bounds`.
+ * Pixel (x, y) is inside the box if floor(min) <= x <= floor(max) on each axis.
+ * @return: false if no pixel is left after clamping
+ */
+bool ClampedBoundingBox(const Triangle& trig, const TileRect& bounds, TileRect& box);
+
+#endif
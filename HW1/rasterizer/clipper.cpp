@@ -0,0 +1,118 @@
+#include "clipper.hpp"
+
+#include <array>
+
+struct ClipVertex
+{
+    glm::vec4 pos;
+    glm::vec4 original;
+    glm::vec4 normal;
+};
+
+static inline ClipVertex Lerp(const ClipVertex& a, const ClipVertex& b, float t)
+{
+    return { a.pos + (b.pos - a.pos) * t, a.original + (b.original - a.original) * t, a.normal + (b.normal - a.normal) * t };
+}
+
+// a triangle cut by up to 5 planes has at most 8 vertices
+using ClipPolygon = std::array<ClipVertex, 9>;
+
+Clipper::Clipper(uint32_t width, uint32_t height, bool perspective, float nearClip, float guardBand)
+{
+    float w = static_cast<float>(width);
+    float h = static_cast<float>(height);
+
+    // With the perspective projection w is the view-space z, negative in front of the camera;
+    //  flipping the sign of the whole position keeps the point and makes w the distance.
+    sign = perspective ? -1.f : 1.f;
+
+    if (perspective)
+    {
+        // w >= nearClip
+        planes.emplace_back(0, 0, 0, 1);
+        offsets.push_back(-nearClip);
+    }
+
+    // -guardBand <= x / w <= width + guardBand, and the same for y
+    planes.emplace_back(1, 0, 0, guardBand);
+    offsets.push_back(0.f);
+    planes.emplace_back(-1, 0, 0, w + guardBand);
+    offsets.push_back(0.f);
+    planes.emplace_back(0, 1, 0, guardBand);
+    offsets.push_back(0.f);
+    planes.emplace_back(0, -1, 0, h + guardBand);
+    offsets.push_back(0.f);
+}
+
+size_t Clipper::Clip(const Triangle& transformed, const Triangle& original,
+    std::vector<Triangle>& outTransformed, std::vector<Triangle>& outOriginal) const
+{
+    std::array<glm::vec4, 3> pos;
+    for (size_t v = 0; v != 3; ++v)
+        pos[v] = transformed.pos[v] * sign;
+
+    // Trivial accept and reject
+    bool inside = true;
+    for (size_t p = 0; p != planes.size(); ++p)
+    {
+        float d0 = Distance(p, pos[0]), d1 = Distance(p, pos[1]), d2 = Distance(p, pos[2]);
+        if (d0 < 0 && d1 < 0 && d2 < 0)
+            return 0;
+        inside = inside && d0 >= 0 && d1 >= 0 && d2 >= 0;
+    }
+
+    if (inside)
+    {
+        Triangle result = transformed;
+        result.Homogenize();
+        outTransformed.push_back(result);
+        outOriginal.push_back(original);
+        return 1;
+    }
+
+    // Sutherland-Hodgman against every plane, carrying the model-space attributes along
+    ClipPolygon polygon, next;
+    size_t count = 3;
+    for (size_t v = 0; v != 3; ++v)
+        polygon[v] = { pos[v], original.pos[v], original.normal[v] };
+
+    for (size_t p = 0; p != planes.size() && count != 0; ++p)
+    {
+        size_t nextCount = 0;
+        for (size_t i = 0; i != count; ++i)
+        {
+            const ClipVertex& a = polygon[i];
+            const ClipVertex& b = polygon[(i + 1) % count];
+            float da = Distance(p, a.pos), db = Distance(p, b.pos);
+
+            if (da >= 0)
+                next[nextCount++] = a;
+            // always interpolated from the inside endpoint, so that an edge shared by two triangles,
+            //  walked in opposite directions, is cut at bit-identical points and leaves no crack
+            if ((da >= 0) != (db >= 0))
+                next[nextCount++] = da >= 0 ? Lerp(a, b, da / (da - db)) : Lerp(b, a, db / (db - da));
+        }
+        polygon = next;
+        count = nextCount;
+    }
+
+    // Fan triangulation keeps the winding of the input
+    size_t appended = 0;
+    for (size_t i = 1; i + 1 < count; ++i)
+    {
+        Triangle clippedTransformed, clippedOriginal;
+        const ClipVertex* corners[3] = { &polygon[0], &polygon[i], &polygon[i + 1] };
+        for (size_t v = 0; v != 3; ++v)
+        {
+            clippedTransformed.pos[v] = corners[v]->pos;
+            clippedTransformed.normal[v] = glm::vec4(0.f);
+            clippedOriginal.pos[v] = corners[v]->original;
+            clippedOriginal.normal[v] = corners[v]->normal;
+        }
+        clippedTransformed.Homogenize();
+        outTransformed.push_back(clippedTransformed);
+        outOriginal.push_back(clippedOriginal);
+        ++appended;
+    }
+    return appended;
+}
@@ -0,0 +1,47 @@
+#ifndef CLIPPER_H
+#define CLIPPER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entities.hpp"
+
+// Clips triangles in homogeneous clip space, before Homogenize.
+//  The near plane removes geometry at or behind the camera, which would otherwise
+//  flip through the divide by w. The guard band is a rectangle `guardBand` pixels
+//  larger than the viewport on every side: triangles inside it are left to the
+//  viewport-clamped bounding boxes of the raster stage, and only triangles
+//  reaching outside it are cut, so raster cost scales with the visible area.
+class Clipper
+{
+public:
+    /**
+     * @param width, height: the viewport in pixels
+     * @param perspective: whether positions come from the perspective projection, where w is the
+     *  (negative) view-space z. Otherwise w is 1 and no near plane is applied.
+     * @param nearClip: the positive near clipping distance of the camera
+     * @param guardBand: extra pixels on every side of the viewport before triangles get cut
+     */
+    Clipper(uint32_t width, uint32_t height, bool perspective, float nearClip, float guardBand);
+
+    /**
+     * Clip a triangle and append the resulting screen-space (homogenized) triangles, together with the
+     * matching model-space triangles interpolated with the same weights.
+     * @return: the number of triangles appended, 0 if the triangle is entirely clipped away
+     */
+    size_t Clip(const Triangle& transformed, const Triangle& original,
+        std::vector<Triangle>& outTransformed, std::vector<Triangle>& outOriginal) const;
+
+private:
+    // distance of a homogeneous position to plane i; inside is >= 0
+    inline float Distance(size_t plane, const glm::vec4& pos) const
+    {
+        return glm::dot(planes[plane], pos) + offsets[plane];
+    }
+
+    std::vector<glm::vec4> planes;
+    std::vector<float> offsets;
+    float sign;             // multiplies positions so that visible points have w > 0
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "culler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "trianglesetup.hpp"
+
+Culler::Culler(const CullConfig& config, uint32_t width, uint32_t height, bool perspective, bool multisample) :
+    config(config),
+    width(static_cast<float>(width)),
+    height(static_cast<float>(height)),
+    perspective(perspective),
+    multisample(multisample)
+{  }
+
+void Culler::Reset()
+{
+    this->stats = CullStats();
+}
+
+size_t Culler::Filter(size_t clipped, std::vector<Triangle>& transformed, std::vector<Triangle>& original)
+{
+    ++stats.submitted;
+    if (clipped == 0)
+    {
+        ++stats.frustum;
+        return 0;
+    }
+
+    size_t first = transformed.size() - clipped;
+    size_t kept = first;
+    for (size_t i = first; i < transformed.size(); ++i)
+    {
+        if (Cull(transformed[i]))
+            continue;
+        if (kept != i)
+        {
+            transformed[kept] = transformed[i];
+            original[kept] = original[i];
+        }
+        ++kept;
+    }
+    transformed.resize(kept);
+    original.resize(kept);
+
+    stats.passed += kept - first;
+    return kept - first;
+}
+
+// A coordinate as the raster setup snaps it to the subpixel grid; exact in double
+static double SnapCoordinate(float v)
+{
+    if (!(std::abs(v) <= TriangleSetup::MaxCoordinate))
+        return v;
+    return static_cast<double>(TriangleSetup::Snap(v)) / TriangleSetup::SubpixelScale;
+}
+
+bool Culler::Cull(const Triangle& trig)
+{
+    const glm::vec4& a = trig.pos[0];
+    const glm::vec4& b = trig.pos[1];
+    const glm::vec4& c = trig.pos[2];
+
+    float xmin = std::min({ a.x, b.x, c.x });
+    float xmax = std::max({ a.x, b.x, c.x });
+    float ymin = std::min({ a.y, b.y, c.y });
+    float ymax = std::max({ a.y, b.y, c.y });
+
+    if (config.frustum)
+    {
+        // same bounds as the binner, so nothing it would rasterize is dropped
+        bool onScreen = xmax >= 0.f && xmin < width && ymax >= 0.f && ymin < height;
+        bool beyondFar = perspective && a.z < -1.f && b.z < -1.f && c.z < -1.f;
+        if (!onScreen || beyondFar)
+        {
+            ++stats.frustum;
+            return true;
+        }
+    }
+
+    // twice the signed area of the snapped triangle, positive for counter-clockwise winding with y up
+    double ax = SnapCoordinate(a.x), ay = SnapCoordinate(a.y);
+    double bx = SnapCoordinate(b.x), by = SnapCoordinate(b.y);
+    double cx = SnapCoordinate(c.x), cy = SnapCoordinate(c.y);
+    double area = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+
+    if (config.small)
+    {
+        // pixel centers sit at i + 0.5; a triangle whose snapped bounding box holds no center
+        //  in x or in y covers none, even with its edges inclusive
+        bool missesCenters = std::floor(std::max({ ax, bx, cx }) - 0.5) < std::ceil(std::min({ ax, bx, cx }) - 0.5) ||
+                             std::floor(std::max({ ay, by, cy }) - 0.5) < std::ceil(std::min({ ay, by, cy }) - 0.5);
+        if (area == 0.0 || (!multisample && missesCenters))
+        {
+            ++stats.small;
+            return true;
+        }
+    }
+
+    if (config.face != CullFace::NONE && area != 0.0)
+    {
+        bool front = (area > 0.0) == config.frontCCW;
+        if (front == (config.face == CullFace::FRONT))
+        {
+            ++stats.backface;
+            return true;
+        }
+    }
+
+    return false;
+}
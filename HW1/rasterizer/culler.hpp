@@ -0,0 +1,71 @@
+#ifndef CULLER_H
+#define CULLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entities.hpp"
+#include "loader.hpp"
+
+// Per-frame counts of the triangles dropped before rasterization
+struct CullStats
+{
+    size_t submitted = 0;       // triangles handed to the clipper
+    size_t backface = 0;        // dropped for facing away (or towards, with CullFace::FRONT)
+    size_t frustum = 0;         // clipped away, off screen or beyond the far plane
+    size_t small = 0;           // zero area or covering no pixel center
+    size_t passed = 0;          // triangles left for the raster stage
+
+    inline size_t Culled() const { return backface + frustum + small; }
+
+    inline CullStats& operator+= (const CullStats& other)
+    {
+        submitted += other.submitted;
+        backface += other.backface;
+        frustum += other.frustum;
+        small += other.small;
+        passed += other.passed;
+        return *this;
+    }
+};
+
+// Rejects screen-space triangles that cannot produce any pixel, between the vertex
+//  stage and the raster stage. Runs on homogenized (clipped) triangles, so winding and
+//  coverage tests are exact 2D tests in pixel units.
+class Culler
+{
+public:
+    /**
+     * @param config: which tests to run
+     * @param width, height: the viewport in pixels
+     * @param perspective: whether depth is perspective NDC z, where the far plane is -1
+     * @param multisample: whether coverage is taken at several positions per pixel, in which case
+     *  triangles between pixel centers may still cover samples and are only dropped at zero area
+     */
+    Culler(const CullConfig& config, uint32_t width, uint32_t height, bool perspective, bool multisample);
+
+    // Start counting a new frame
+    void Reset();
+
+    /**
+     * Account for one submitted triangle and the number of triangles the clipper made of it,
+     * then drop the culled ones among the last `clipped` entries of both lists, keeping the order.
+     * @return: the number of triangles kept
+     */
+    size_t Filter(size_t clipped, std::vector<Triangle>& transformed, std::vector<Triangle>& original);
+
+    inline const CullStats& GetStats() const { return this->stats; }
+
+private:
+    // @return: whether the homogenized triangle is rejected; counts the reason
+    bool Cull(const Triangle& trig);
+
+    CullConfig config;
+    float width;
+    float height;
+    bool perspective;
+    bool multisample;
+    CullStats stats;
+};
+
+#endif
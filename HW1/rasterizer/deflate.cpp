@@ -0,0 +1,310 @@
+#include "deflate.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+#endif
+
+// Match lengths and distances of DEFLATE: base value and number of extra bits of each code
+static const uint16_t LengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t LengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t DistanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t DistanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static constexpr uint32_t MinMatch = 3;
+static constexpr uint32_t MaxMatch = 258;
+static constexpr uint32_t Window = 32768;
+static constexpr uint32_t HashBits = 15;
+static constexpr uint32_t MaxStored = 65535;    // largest stored block
+
+// Packs codes least significant bit first, as DEFLATE stores them
+struct BitWriter
+{
+    std::vector<uint8_t>& out;
+    uint64_t buffer = 0;
+    uint32_t count = 0;
+
+    BitWriter(std::vector<uint8_t>& out) : out(out) {  }
+
+    // Append the low `n` bits of `bits`, n <= 32
+    inline void Put(uint32_t bits, uint32_t n)
+    {
+        buffer |= static_cast<uint64_t>(bits) << count;
+        count += n;
+        if (count >= 32)
+        {
+            uint8_t bytes[4] = { static_cast<uint8_t>(buffer), static_cast<uint8_t>(buffer >> 8),
+                static_cast<uint8_t>(buffer >> 16), static_cast<uint8_t>(buffer >> 24) };
+            out.insert(out.end(), bytes, bytes + 4);
+            buffer >>= 32;
+            count -= 32;
+        }
+    }
+
+    // Pad with zeros to the next byte boundary and write out every pending byte
+    inline void Align()
+    {
+        count = (count + 7) & ~7u;
+        for (; count > 0; count -= 8, buffer >>= 8)
+            out.push_back(static_cast<uint8_t>(buffer));
+        buffer = 0;
+    }
+};
+
+// Huffman codes are defined most significant bit first, so they are reversed before packing
+static uint32_t Reverse(uint32_t code, uint32_t length)
+{
+    uint32_t reversed = 0;
+    for (uint32_t i = 0; i < length; ++i, code >>= 1)
+        reversed = (reversed << 1) | (code & 1u);
+    return reversed;
+}
+
+// Bits and bit count of a code, ready to be packed
+struct Code
+{
+    uint32_t bits;
+    uint32_t length;
+};
+
+// The fixed Huffman code of every literal/length symbol, and of every match length (3 to 258)
+//  and distance (1 to 32768) together with their extra bits
+struct FixedCodes
+{
+    Code symbols[288];
+    Code lengths[MaxMatch + 1];
+    Code distances[Window + 1];
+
+    FixedCodes()
+    {
+        for (uint32_t symbol = 0; symbol < 288; ++symbol)
+        {
+            if (symbol <= 143)
+                symbols[symbol] = { Reverse(0x30 + symbol, 8), 8 };
+            else if (symbol <= 255)
+                symbols[symbol] = { Reverse(0x190 + symbol - 144, 9), 9 };
+            else if (symbol <= 279)
+                symbols[symbol] = { Reverse(symbol - 256, 7), 7 };
+            else
+                symbols[symbol] = { Reverse(0xC0 + symbol - 280, 8), 8 };
+        }
+        for (uint32_t length = MinMatch, l = 0; length <= MaxMatch; ++length)
+        {
+            while (l < 28 && LengthBase[l + 1] <= length)
+                ++l;
+            const Code& symbol = symbols[257 + l];
+            lengths[length] = { symbol.bits | ((length - LengthBase[l]) << symbol.length), symbol.length + LengthExtra[l] };
+        }
+        for (uint32_t distance = 1, d = 0; distance <= Window; ++distance)
+        {
+            while (d < 29 && DistanceBase[d + 1] <= distance)
+                ++d;
+            distances[distance] = { Reverse(d, 5) | ((distance - DistanceBase[d]) << 5), 5u + DistanceExtra[d] };
+        }
+    }
+};
+
+static const FixedCodes& GetFixedCodes()
+{
+    static const FixedCodes codes;
+    return codes;
+}
+
+// Index in memory order of the first nonzero byte of a nonzero word loaded from memory
+static inline uint32_t FirstNonzeroByte(uint64_t word)
+{
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long bit;
+    _BitScanForward64(&bit, word);
+    return static_cast<uint32_t>(bit >> 3);
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return static_cast<uint32_t>(__builtin_ctzll(word) >> 3);
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return static_cast<uint32_t>(__builtin_clzll(word) >> 3);
+#else
+    uint8_t bytes[8];
+    std::memcpy(bytes, &word, 8);
+    uint32_t i = 0;
+    while (bytes[i] == 0)
+        ++i;
+    return i;
+#endif
+}
+
+// Number of equal bytes at a and b, up to limit
+static inline uint32_t MatchLength(const uint8_t* a, const uint8_t* b, uint32_t limit)
+{
+    uint32_t length = 0;
+    while (length + 8 <= limit)
+    {
+        uint64_t x, y;
+        std::memcpy(&x, a + length, 8);
+        std::memcpy(&y, b + length, 8);
+        if (x != y)
+            return length + FirstNonzeroByte(x ^ y);
+        length += 8;
+    }
+    while (length < limit && a[length] == b[length])
+        ++length;
+    return length;
+}
+
+static inline uint32_t Hash(const uint8_t* p)
+{
+    uint32_t v = static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16);
+    return (v * 2654435761u) >> (32 - HashBits);
+}
+
+// Level 0: the data split into stored blocks, which are byte-aligned by themselves
+static void StoreChunk(const uint8_t* data, size_t size, bool last, std::vector<uint8_t>& out)
+{
+    size_t offset = 0;
+    do
+    {
+        uint32_t length = static_cast<uint32_t>(std::min<size_t>(MaxStored, size - offset));
+        bool final = last && offset + length == size;
+        out.insert(out.end(), { static_cast<uint8_t>(final ? 1 : 0),
+            static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+            static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8) });
+        out.insert(out.end(), data + offset, data + offset + length);
+        offset += length;
+    } while (offset < size);
+}
+
+void DeflateChunk(const uint8_t* data, size_t size, uint32_t level, bool last, std::vector<uint8_t>& out)
+{
+    if (level == 0)
+    {
+        StoreChunk(data, size, last, out);
+        return;
+    }
+    // candidates tried per position: 1 at level 1, doubling up to 256 at level 9
+    const uint32_t maxChain = 1u << (std::min(level, 9u) - 1);
+
+    const FixedCodes& codes = GetFixedCodes();
+    BitWriter writer(out);
+    writer.Put(last ? 1u : 0u, 1);          // BFINAL
+    writer.Put(1, 2);                       // BTYPE: fixed Huffman codes
+
+    // Greedy LZ77 over hash chains of 3-byte prefixes; positions are relative to the chunk
+    std::vector<int64_t> head(size_t(1) << HashBits, -1);
+    std::vector<int64_t> prev(Window, -1);
+    auto insert = [&](size_t i)
+    {
+        uint32_t h = Hash(data + i);
+        prev[i & (Window - 1)] = head[h];
+        head[h] = static_cast<int64_t>(i);
+    };
+
+    size_t i = 0;
+    while (i < size)
+    {
+        uint32_t bestLength = 0, bestDistance = 0;
+        if (i + MinMatch <= size)
+        {
+            const uint32_t limit = static_cast<uint32_t>(std::min<size_t>(MaxMatch, size - i));
+            int64_t candidate = head[Hash(data + i)];
+            for (uint32_t tries = 0; candidate >= 0 && tries < maxChain; ++tries)
+            {
+                size_t distance = i - static_cast<size_t>(candidate);
+                if (distance > Window)
+                    break;
+                uint32_t length = MatchLength(data + candidate, data + i, limit);
+                if (length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = static_cast<uint32_t>(distance);
+                    if (length == limit)
+                        break;
+                }
+                candidate = prev[static_cast<size_t>(candidate) & (Window - 1)];
+            }
+            insert(i);
+        }
+
+        if (bestLength >= MinMatch)
+        {
+            writer.Put(codes.lengths[bestLength].bits, codes.lengths[bestLength].length);
+            writer.Put(codes.distances[bestDistance].bits, codes.distances[bestDistance].length);
+            for (size_t k = i + 1; k < i + bestLength && k + MinMatch <= size; ++k)
+                insert(k);
+            i += bestLength;
+        }
+        else
+        {
+            writer.Put(codes.symbols[data[i]].bits, codes.symbols[data[i]].length);
+            ++i;
+        }
+    }
+    writer.Put(codes.symbols[256].bits, codes.symbols[256].length);        // end of block
+
+    if (!last)
+    {
+        // empty stored block: 3 header bits, padding, then LEN = 0 and NLEN = ~0
+        writer.Put(0, 3);
+        writer.Align();
+        out.insert(out.end(), { 0x00, 0x00, 0xFF, 0xFF });
+    }
+    else
+        writer.Align();
+}
+
+uint32_t Adler32(uint32_t adler, const uint8_t* data, size_t size)
+{
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (size > 0)
+    {
+        // the largest run before b can overflow 32 bits
+        size_t run = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < run; ++i)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += run;
+        size -= run;
+    }
+    return (b << 16) | a;
+}
+
+uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2, size_t size2)
+{
+    // each byte of the second piece adds the first piece's running sum once more to b
+    const uint32_t base = 65521;
+    uint32_t remainder = static_cast<uint32_t>(size2 % base);
+    uint32_t a = ((adler1 & 0xFFFF) + (adler2 & 0xFFFF) + base - 1) % base;
+    uint32_t b = static_cast<uint32_t>((static_cast<uint64_t>(remainder) * (adler1 & 0xFFFF)) % base);
+    b = (b + (adler1 >> 16) + (adler2 >> 16) + base - remainder) % base;
+    return (b << 16) | a;
+}
+
+uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    static const auto table = []()
+    {
+        std::vector<uint32_t> table(256);
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1u) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        return table;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
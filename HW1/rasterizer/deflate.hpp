@@ -0,0 +1,30 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Raw DEFLATE (RFC 1951) encoding with the fixed Huffman codes, for PNG streams written piece by piece.
+//  Every chunk is compressed on its own, with matches only inside the chunk, and ends on a byte
+//  boundary, so chunks compressed separately, even concurrently, concatenate into one valid stream.
+
+/**
+ * Compress `data` and append it to `out`.
+ * @param level: 0 stores the data uncompressed; 1 to 9 search more candidate matches per byte,
+ *  trading speed for size
+ * @param last: whether this chunk ends the stream. Other chunks end with an empty stored block
+ *  (a sync flush), which brings the stream back to a byte boundary.
+ */
+void DeflateChunk(const uint8_t* data, size_t size, uint32_t level, bool last, std::vector<uint8_t>& out);
+
+// Running Adler-32 checksum of the uncompressed data of a zlib stream; start from 1
+uint32_t Adler32(uint32_t adler, const uint8_t* data, size_t size);
+
+// Adler-32 of two pieces of data from the checksums of each, `size2` being the length of the second
+uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2, size_t size2);
+
+// Running CRC-32 of a PNG chunk; start from 0
+uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size);
+
+#endif
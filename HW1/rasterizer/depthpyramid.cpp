@@ -0,0 +1,60 @@
+#include "depthpyramid.hpp"
+
+#include <algorithm>
+
+DepthPyramid::DepthPyramid(uint32_t width, uint32_t height) :
+    width(width),
+    height(height),
+    blocksX((width + BlockSize - 1) / BlockSize),
+    blocksY((height + BlockSize - 1) / BlockSize),
+    cellsX((width + CellSize - 1) / CellSize),
+    cellsY((height + CellSize - 1) / CellSize),
+    blockMin(static_cast<size_t>(blocksX) * blocksY),
+    blockMax(static_cast<size_t>(blocksX) * blocksY),
+    cellMin(static_cast<size_t>(cellsX) * cellsY),
+    cellMax(static_cast<size_t>(cellsX) * cellsY)
+{  }
+
+void DepthPyramid::Reset(float depth)
+{
+    std::fill(blockMin.begin(), blockMin.end(), depth);
+    std::fill(blockMax.begin(), blockMax.end(), depth);
+    std::fill(cellMin.begin(), cellMin.end(), depth);
+    std::fill(cellMax.begin(), cellMax.end(), depth);
+}
+
+void DepthPyramid::UpdateBlock(const ImageGrey& ZBuffer, uint32_t bx, uint32_t by)
+{
+    uint32_t xEnd = std::min((bx + 1) * BlockSize, width);
+    uint32_t yEnd = std::min((by + 1) * BlockSize, height);
+
+    const float* first = ZBuffer.Row(by * BlockSize) + bx * BlockSize;
+    float lo = *first, hi = *first;
+    for (uint32_t y = by * BlockSize; y < yEnd; ++y)
+    {
+        const float* row = ZBuffer.Row(y);
+        for (uint32_t x = bx * BlockSize; x < xEnd; ++x)
+        {
+            lo = std::min(lo, row[x]);
+            hi = std::max(hi, row[x]);
+        }
+    }
+    blockMin[by * blocksX + bx] = lo;
+    blockMax[by * blocksX + bx] = hi;
+}
+
+void DepthPyramid::UpdateCell(uint32_t cx, uint32_t cy)
+{
+    uint32_t bxEnd = std::min((cx + 1) * Fanout, blocksX);
+    uint32_t byEnd = std::min((cy + 1) * Fanout, blocksY);
+
+    float lo = BlockMin(cx * Fanout, cy * Fanout), hi = BlockMax(cx * Fanout, cy * Fanout);
+    for (uint32_t by = cy * Fanout; by < byEnd; ++by)
+        for (uint32_t bx = cx * Fanout; bx < bxEnd; ++bx)
+        {
+            lo = std::min(lo, BlockMin(bx, by));
+            hi = std::max(hi, BlockMax(bx, by));
+        }
+    cellMin[cy * cellsX + cx] = lo;
+    cellMax[cy * cellsX + cx] = hi;
+}
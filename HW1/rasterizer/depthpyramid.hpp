@@ -0,0 +1,48 @@
+#ifndef DEPTHPYRAMID_H
+#define DEPTHPYRAMID_H
+
+#include <cstdint>
+#include <vector>
+
+#include "image.hpp"
+
+// Hierarchical depth bounds kept alongside a ZBuffer.
+//  Level 0 stores the min/max depth of every BlockSize x BlockSize pixel block,
+//  level 1 the min/max of every CellSize x CellSize cell (Fanout x Fanout blocks).
+//  Depth follows the ZBuffer convention: greater is nearer, and a fragment passes
+//  the depth test if it is greater than the stored value, so a triangle whose
+//  nearest depth is not above a block's minimum cannot change that block.
+//  Cells are aligned to the raster tiles, so each tile owns its pyramid entries.
+class DepthPyramid
+{
+public:
+    static constexpr uint32_t BlockSize = 8;
+    static constexpr uint32_t Fanout = 8;
+    static constexpr uint32_t CellSize = BlockSize * Fanout;
+
+    DepthPyramid() = default;
+    DepthPyramid(uint32_t width, uint32_t height);
+
+    // Set every block and cell to a cleared ZBuffer holding `depth`
+    void Reset(float depth);
+
+    // Recompute the bounds of block (bx, by) from the ZBuffer
+    void UpdateBlock(const ImageGrey& ZBuffer, uint32_t bx, uint32_t by);
+
+    // Recompute the bounds of cell (cx, cy) from its blocks
+    void UpdateCell(uint32_t cx, uint32_t cy);
+
+    inline float BlockMin(uint32_t bx, uint32_t by) const { return blockMin[by * blocksX + bx]; }
+    inline float BlockMax(uint32_t bx, uint32_t by) const { return blockMax[by * blocksX + bx]; }
+    inline float CellMin(uint32_t cx, uint32_t cy) const { return cellMin[cy * cellsX + cx]; }
+    inline float CellMax(uint32_t cx, uint32_t cy) const { return cellMax[cy * cellsX + cx]; }
+
+private:
+    uint32_t width = 0, height = 0;
+    uint32_t blocksX = 0, blocksY = 0;
+    uint32_t cellsX = 0, cellsY = 0;
+    std::vector<float> blockMin, blockMax;
+    std::vector<float> cellMin, cellMax;
+};
+
+#endif
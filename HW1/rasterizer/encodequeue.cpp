@@ -0,0 +1,80 @@
+#include "encodequeue.hpp"
+
+EncodeQueue::EncodeQueue(bool async)
+{
+    if (async)
+        worker = std::thread(&EncodeQueue::WorkerLoop, this);
+}
+
+EncodeQueue::~EncodeQueue()
+{
+    if (!worker.joinable())
+        return;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return !busy; });
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void EncodeQueue::Push(std::function<void()> job)
+{
+    if (!worker.joinable())
+    {
+        job();
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return !busy; });
+        this->job = std::move(job);
+        this->busy = true;
+    }
+    wake.notify_one();
+}
+
+void EncodeQueue::Wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return !busy; });
+    if (error)
+    {
+        std::exception_ptr rethrown = error;
+        error = nullptr;
+        std::rethrow_exception(rethrown);
+    }
+}
+
+void EncodeQueue::WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> current;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || busy; });
+            if (stopping)
+                return;
+            current = std::move(job);
+        }
+
+        try
+        {
+            current();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+                error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        busy = false;
+        idle.notify_all();
+    }
+}
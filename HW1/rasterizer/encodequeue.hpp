@@ -0,0 +1,45 @@
+#ifndef ENCODEQUEUE_H
+#define ENCODEQUEUE_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs output jobs, such as encoding a finished band, one at a time in submission order.
+//  An asynchronous queue runs them on a thread of its own, so that the next band or frame is
+//  rendered while the last one is encoded; otherwise jobs run inside Push.
+class EncodeQueue
+{
+public:
+    EncodeQueue(bool async);
+    ~EncodeQueue();
+
+    EncodeQueue(const EncodeQueue&) = delete;
+    EncodeQueue& operator= (const EncodeQueue&) = delete;
+
+    // Run `job` after every job pushed before it. Blocks until the previous job has finished,
+    //  so at most one job is in flight, and whatever it used is free again once the next Push returns.
+    void Push(std::function<void()> job);
+
+    // Block until every pushed job has finished. The first exception thrown by a job is rethrown here.
+    void Wait();
+
+private:
+    void WorkerLoop();
+
+    std::thread worker;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+
+    // the job in flight, guarded by mutex
+    std::function<void()> job;
+    bool busy = false;
+    bool stopping = false;
+    std::exception_ptr error;
+};
+
+#endif
@@ -3,8 +3,10 @@
 #ifndef ENTITIES_H
 #define ENTITIES_H
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -26,6 +28,20 @@ struct Triangle
     }
 };
 
+// A rectangle of pixels [x0, x1) x [y0, y1) that a draw call is restricted to
+struct TileRect
+{
+    uint32_t x0, y0;
+    uint32_t x1, y1;
+
+    inline bool Empty() const { return x0 >= x1 || y0 >= y1; }
+
+    inline TileRect Intersect(const TileRect& other) const
+    {
+        return { std::max(x0, other.x0), std::max(y0, other.y0), std::min(x1, other.x1), std::min(y1, other.y1) };
+    }
+};
+
 template<typename T>
 inline std::string ToStr(const T val, const int n = 3)
 {
@@ -3,12 +3,12 @@
 #include <iostream>
 #include <algorithm>
 #include <cstring>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "../thirdparty/stb/stb_image.h"
-#include "../thirdparty/stb/stb_image_write.h"
+#include "imagewriter.hpp"
+#include "threadpool.hpp"
 
 Color Color::White = Color(255, 255, 255, 255);
 Color Color::Black = Color(0, 0, 0, 255);
@@ -60,29 +60,42 @@ const char Color::operator[] (size_t index) const
     return a;
 }
 
+Color GreyColor(float value)
+{
+    float val = 127.5f - 127.5f * value;
+    val = std::clamp(val, 0.f, 255.f);
+    return Color(val, val, val, 255);
+}
+
 template<>
 ImageBuffer<Color>::ImageBuffer(std::string filename)
 {
     this->width = 100;
     this->height = 100;
-    this->canvas = new Color[100 * 100];
-    for (size_t i = 0; i != 100 * 100; ++i)
-        this->canvas[i] = Color::Black;
+    this->canvas = Allocate(100 * 100);
+    this->Clear(Color::Black);
     this->filename = filename;
 }
 
 template<>
 ImageBuffer<Color>::ImageBuffer(unsigned int w, unsigned int h, std::string filename)
 {
-    if (w > 2000)
-        w = 2000;
-    if (h > 2000)
-        h = 2000;
     this->width = w;
     this->height = h;
-    this->canvas = new Color[static_cast<size_t>(w) * static_cast<size_t>(h)];
-    for (size_t i = 0; i != this->width * this->height; ++i)
-        this->canvas[i] = Color::Black;
+    this->canvas = Allocate(static_cast<size_t>(w) * static_cast<size_t>(h));
+    this->Clear(Color::Black);
+    this->filename = filename;
+}
+
+template<>
+ImageBuffer<glm::vec4>::ImageBuffer(unsigned int w, unsigned int h, std::string filename)
+{
+    this->width = w;
+    this->height = h;
+    this->canvas = Allocate(static_cast<size_t>(w) * static_cast<size_t>(h));
+    // cleared to the same color as an Image
+    glm::vec4 black(Color::Black.r, Color::Black.g, Color::Black.b, Color::Black.a);
+    this->Clear(black / 255.f);
     this->filename = filename;
 }
 
@@ -92,40 +105,40 @@ void ImageBuffer<T>::Write()
     std::cerr << "Writing files not of greyscale or color type is not supported.\n";
 }
 
+// Stream `height` rows to a PNG file through the output stage, top row first; row(y, out) fills out with row y
+template<typename RowSource>
+static void WritePng(const std::string& filename, uint32_t width, uint32_t height, RowSource&& row)
+{
+    try
+    {
+        ThreadPool pool;
+        std::unique_ptr<ImageWriter> writer = ImageWriter::Open(filename, OutputFormat::PNG, 6, width, height, pool);
+        for (uint32_t y = height; y-- > 0; )
+            writer->WriteRow(row(y));
+        writer->Finish();
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << "Writing to " << filename << ".png failed: " << e.what() << std::endl;
+    }
+}
+
 template<>
 void ImageBuffer<Color>::Write()
 {
-    std::string resStr = std::to_string(this->width) + "x" + std::to_string(this->height);
-    std::cout << "Writing to PNG with resolution " << resStr << " for colored images.\n";
-    stbi_flip_vertically_on_write(true);
-    
-    int info;
-    info = stbi_write_png((filename + ".png").c_str(), this->width, this->height, 4, this->canvas, 0);
-    if (!info)
-        std::cerr << "Writing to " << filename << ".png failed." << std::endl;
+    WritePng(this->filename, this->width, this->height, [this](uint32_t y) { return this->Row(y); });
 }
 
 template<>
 void ImageBuffer<float>::Write()
 {
-    std::string resStr = std::to_string(this->width) + "x" + std::to_string(this->height);
-    std::cout << "Writing to PNG with resolution " << resStr << " for greyscale images.\n";
-    stbi_flip_vertically_on_write(true);
-
-    Color* colorCanvas = new Color[this->width * this->height];
-
-    for (size_t index = 0; index != this->width * this->height; ++index)
+    // converted a row at a time, so no full-frame copy is made
+    std::vector<Color> line(this->width);
+    WritePng(this->filename, this->width, this->height, [&](uint32_t y)
     {
-        float val = this->canvas[index];
-        val = 127.5f - 127.5f * val;
-        val = std::clamp(val, 0.f, 255.f);
-        colorCanvas[index] = Color(val, val, val, 255);
-    }
-    
-    int info;
-    info = stbi_write_png((filename + ".png").c_str(), this->width, this->height, 4, colorCanvas, 0);
-    if (!info)
-        std::cerr << "Writing to " << filename << ".png failed." << std::endl;
-
-    delete[] colorCanvas;
+        const float* grey = this->Row(y);
+        for (uint32_t x = 0; x != this->width; ++x)
+            line[x] = GreyColor(grey[x]);
+        return line.data();
+    });
 }
@@ -2,8 +2,10 @@
 #define ImageBuffer_H
 
 #include <algorithm>
-#include <string>
+#include <memory>
+#include <new>
 #include <optional>
+#include <string>
 
 #include "../thirdparty/glm/glm.hpp"
 
@@ -57,6 +59,9 @@ inline Color operator* (const Color& c, float coeff)
     return coeff * c;
 }
 
+// The grey level a greyscale image is written with: -1 is white, 1 is black
+Color GreyColor(float value);
+
 template<typename T>
 class ImageBuffer
 {
@@ -65,14 +70,24 @@ private:
     T* canvas;
     std::string filename;
 
+    // Storage is aligned to a cache line, so rows of SIMD-friendly types start on aligned addresses
+    //  whenever the row length allows, and two buffers never share a line at their ends
+    static constexpr size_t Alignment = 64;
+
+    static T* Allocate(size_t count);
+    static void Release(T* canvas, size_t count);
+
 public:
     // Constructors
     ImageBuffer(std::string = "output");
     ImageBuffer(uint32_t width, uint32_t height, std::string = "output");
     ImageBuffer(const ImageBuffer&);
+    ImageBuffer(ImageBuffer&&) noexcept;
     ~ImageBuffer();
 
+    // Copying into a buffer of the same size reuses its storage
     ImageBuffer& operator= (const ImageBuffer&);
+    ImageBuffer& operator= (ImageBuffer&&) noexcept;
 
     // Set/Get color for a specific pixel
     //     Attempting to set color to an invalid pixel will result in no change in the canvas
@@ -80,35 +95,67 @@ public:
     void Set(uint32_t w, uint32_t h, T);
     std::optional<T> Get(uint32_t w, uint32_t h) const;
 
-    // Write the canvas to a .png file with the designated filename
+    // Set every pixel to `value`
+    void Clear(const T& value);
+
+    // Write the canvas to a .png file with the designated filename, through ImageWriter
     void Write();
 
+    // Unchecked access to pixel (w, h), for inner loops that have already clamped their range to the image
+    inline T& At(uint32_t w, uint32_t h) { return canvas[static_cast<size_t>(h) * width + w]; }
+    inline const T& At(uint32_t w, uint32_t h) const { return canvas[static_cast<size_t>(h) * width + w]; }
+
+    // Raw access to row h, for inner loops that have already clamped their range to the image
+    inline T* Row(uint32_t h) { return canvas + static_cast<size_t>(h) * width; }
+    inline const T* Row(uint32_t h) const { return canvas + static_cast<size_t>(h) * width; }
+
+    // All pixels, row after row with no padding between rows
+    inline T* Data() { return canvas; }
+    inline const T* Data() const { return canvas; }
+    inline size_t Size() const { return static_cast<size_t>(width) * height; }
+
     inline uint32_t GetWidth() const { return width; }
     inline uint32_t GetHeight() const { return height; }
 };
 
 using Image = ImageBuffer<Color>;
 using ImageGrey = ImageBuffer<float>;
+using ImageHDR = ImageBuffer<glm::vec4>;        // linear float color, 1 being full intensity; see tonemap.hpp
+
+template<typename T>
+T* ImageBuffer<T>::Allocate(size_t count)
+{
+    if (count == 0)
+        return nullptr;
+    T* canvas = static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+    std::uninitialized_default_construct_n(canvas, count);
+    return canvas;
+}
+
+template<typename T>
+void ImageBuffer<T>::Release(T* canvas, size_t count)
+{
+    if (!canvas)
+        return;
+    std::destroy_n(canvas, count);
+    ::operator delete(canvas, std::align_val_t(Alignment));
+}
 
 template<typename T>
 ImageBuffer<T>::ImageBuffer(std::string filename)
 {
     this->width = 100;
     this->height = 100;
-    this->canvas = new T[100 * 100];
+    this->canvas = Allocate(100 * 100);
     this->filename = filename;
 }
 
 template<typename T>
 ImageBuffer<T>::ImageBuffer(unsigned int w, unsigned int h, std::string filename)
 {
-    if (w > 2000)
-        w = 2000;
-    if (h > 2000)
-        h = 2000;
     this->width = w;
     this->height = h;
-    this->canvas = new T[static_cast<size_t>(w) * static_cast<size_t>(h)];
+    this->canvas = Allocate(static_cast<size_t>(w) * static_cast<size_t>(h));
     this->filename = filename;
 }
 
@@ -116,53 +163,92 @@ template<>
 ImageBuffer<Color>::ImageBuffer(std::string filename);
 
 template<>
-ImageBuffer<Color>::ImageBuffer(std::string filename);
+ImageBuffer<Color>::ImageBuffer(unsigned int w, unsigned int h, std::string filename);
 
 template<>
-ImageBuffer<Color>::ImageBuffer(unsigned int w, unsigned int h, std::string filename);
+ImageBuffer<glm::vec4>::ImageBuffer(unsigned int w, unsigned int h, std::string filename);
 
 template<typename T>
-ImageBuffer<T>::ImageBuffer(const ImageBuffer<T>& image)
+ImageBuffer<T>::ImageBuffer(const ImageBuffer<T>& image) :
+    width(0), height(0), canvas(nullptr)
 {
     *this = image;
 }
 
+template<typename T>
+ImageBuffer<T>::ImageBuffer(ImageBuffer<T>&& image) noexcept :
+    width(image.width), height(image.height), canvas(image.canvas), filename(std::move(image.filename))
+{
+    image.width = 0;
+    image.height = 0;
+    image.canvas = nullptr;
+}
+
 template<typename T>
 ImageBuffer<T>::~ImageBuffer()
 {
-    if (canvas)
-        delete[] canvas;
+    Release(this->canvas, this->Size());
 }
 
 template<typename T>
 ImageBuffer<T>& ImageBuffer<T>::operator= (const ImageBuffer<T>& image)
 {
-    if (this->canvas)
-        delete[] canvas;
-
+    if (this == &image)
+        return *this;
+
+    if (this->Size() != image.Size())
+    {
+        Release(this->canvas, this->Size());
+        this->canvas = nullptr;
+        this->width = 0;
+        this->height = 0;
+        this->canvas = Allocate(image.Size());
+    }
     this->width = image.width;
     this->height = image.height;
-    this->canvas = new T[image.width * image.height];
-    for (unsigned int i = 0; i != image.width * image.height; ++i)
-        this->canvas[i] = image.canvas[i];
+    std::copy_n(image.canvas, image.Size(), this->canvas);
     this->filename = image.filename;
 
     return *this;
 }
 
+template<typename T>
+ImageBuffer<T>& ImageBuffer<T>::operator= (ImageBuffer<T>&& image) noexcept
+{
+    if (this == &image)
+        return *this;
+
+    Release(this->canvas, this->Size());
+    this->width = image.width;
+    this->height = image.height;
+    this->canvas = image.canvas;
+    this->filename = std::move(image.filename);
+    image.width = 0;
+    image.height = 0;
+    image.canvas = nullptr;
+
+    return *this;
+}
+
 template<typename T>
 void ImageBuffer<T>::Set(unsigned int w, unsigned int h, T c)
 {
     if (!(!canvas || w >= width || h >= height))
-        this->canvas[(size_t)(h * this->width + w)] = c;
+        this->canvas[static_cast<size_t>(h) * this->width + w] = c;
 }
 
 template<typename T>
 std::optional<T> ImageBuffer<T>::Get(unsigned int w, unsigned int h) const
 {
     if (!(!canvas || w >= width || h >= height))
-        return this->canvas[(size_t)(h * this->width + w)];
+        return this->canvas[static_cast<size_t>(h) * this->width + w];
     return std::nullopt;
 }
 
+template<typename T>
+void ImageBuffer<T>::Clear(const T& value)
+{
+    std::fill_n(this->canvas, this->Size(), value);
+}
+
 #endif
@@ -0,0 +1,402 @@
+#include "imagewriter.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "deflate.hpp"
+#include "threadpool.hpp"
+
+static void PutBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.insert(out.end(), { static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16),
+        static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value) });
+}
+
+static uint8_t Paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return static_cast<uint8_t>(a);
+    return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+// Apply PNG filter `type` to a row of RGBA pixels, and return the sum of the absolute (signed)
+//  filtered bytes, a cheap estimate of how well the row will compress
+static size_t FilterRowAs(uint8_t type, const uint8_t* current, const uint8_t* previous, size_t size, uint8_t* out)
+{
+    const size_t left = std::min<size_t>(4, size);
+    switch (type)
+    {
+    case 0:
+        std::copy(current, current + size, out);
+        break;
+    case 1:
+        std::copy(current, current + left, out);
+        for (size_t i = 4; i < size; ++i)
+            out[i] = static_cast<uint8_t>(current[i] - current[i - 4]);
+        break;
+    case 2:
+        for (size_t i = 0; i < size; ++i)
+            out[i] = static_cast<uint8_t>(current[i] - previous[i]);
+        break;
+    case 3:
+        for (size_t i = 0; i < left; ++i)
+            out[i] = static_cast<uint8_t>(current[i] - previous[i] / 2);
+        for (size_t i = 4; i < size; ++i)
+            out[i] = static_cast<uint8_t>(current[i] - (current[i - 4] + previous[i]) / 2);
+        break;
+    default:
+        for (size_t i = 0; i < left; ++i)
+            out[i] = static_cast<uint8_t>(current[i] - previous[i]);
+        for (size_t i = 4; i < size; ++i)
+            out[i] = static_cast<uint8_t>(current[i] - Paeth(current[i - 4], previous[i], previous[i - 4]));
+        break;
+    }
+
+    size_t cost = 0;
+    for (size_t i = 0; i < size; ++i)
+        cost += static_cast<size_t>(std::abs(static_cast<int>(static_cast<int8_t>(out[i]))));
+    return cost;
+}
+
+// Append `current` to `out` behind its filter type byte, with the filter of the lowest cost
+static void FilterRow(const uint8_t* current, const uint8_t* previous, size_t size, std::vector<uint8_t>& candidate, std::vector<uint8_t>& out)
+{
+    candidate.resize(size);
+
+    size_t start = out.size();
+    out.resize(start + 1 + size);
+    size_t bestCost = FilterRowAs(0, current, previous, size, out.data() + start + 1);
+    uint8_t bestType = 0;
+    for (uint8_t type = 1; type < 5; ++type)
+    {
+        size_t cost = FilterRowAs(type, current, previous, size, candidate.data());
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            bestType = type;
+            std::copy(candidate.begin(), candidate.end(), out.begin() + start + 1);
+        }
+    }
+    out[start] = bestType;
+}
+
+// 8-bit RGBA PNG. Rows are gathered into batches; every batch is cut into one segment per thread,
+//  and the segments are filtered and compressed concurrently into pieces of a single zlib stream.
+class PngStreamWriter : public ImageWriter
+{
+public:
+    PngStreamWriter(const std::string& path, uint32_t width, uint32_t height, uint32_t level, ThreadPool& pool) :
+        path(path), file(path, std::ios::binary), height(height), level(level), pool(pool),
+        rowBytes(static_cast<size_t>(width) * 4), previous(rowBytes, 0)
+    {
+        if (!file)
+            throw std::runtime_error("cannot open " + path + " for writing");
+
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+        std::vector<uint8_t> header;
+        PutBigEndian(header, width);
+        PutBigEndian(header, height);
+        header.insert(header.end(), { 8, 6, 0, 0, 0 });    // 8 bits per channel, RGBA, deflate, adaptive filters, no interlace
+        WriteChunk("IHDR", header);
+
+        compressed = { 0x78, 0x01 };                       // zlib header: deflate with a 32K window
+
+        segmentRows = std::max<size_t>(1, SegmentBytes / std::max<size_t>(rowBytes, 1));
+        segments.resize(pool.GetThreadCount());
+    }
+
+    void WriteRow(const Color* row) override
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(row);
+        pending.insert(pending.end(), bytes, bytes + rowBytes);
+        ++this->rows;
+
+        if (pending.size() >= segmentRows * segments.size() * rowBytes)
+            Flush(false);
+    }
+
+    bool Finish() override
+    {
+        Flush(true);
+        PutBigEndian(compressed, adler);
+        WriteChunk("IDAT", compressed);
+        WriteChunk("IEND", {});
+        return Complete(path, file, this->rows, this->height);
+    }
+
+private:
+    // uncompressed bytes per segment; matches never cross segments, so smaller ones compress worse
+    static constexpr size_t SegmentBytes = size_t(1) << 20;
+
+    struct Segment
+    {
+        std::vector<uint8_t> filtered, candidate, compressed;
+        uint32_t adler = 1;
+    };
+
+    std::string path;
+    std::ofstream file;
+    uint32_t height;
+    uint32_t rows = 0;
+    uint32_t level;
+    ThreadPool& pool;
+
+    size_t rowBytes;
+    size_t segmentRows;
+    std::vector<uint8_t> previous;          // the row before the pending ones, unfiltered
+    std::vector<uint8_t> pending;           // rows not compressed yet, unfiltered
+    std::vector<uint8_t> compressed;        // compressed bytes not written yet
+    std::vector<Segment> segments;
+    uint32_t adler = 1;
+
+    void Flush(bool last)
+    {
+        const size_t count = (rowBytes == 0) ? 0 : pending.size() / rowBytes;
+        const size_t used = std::min(segments.size(), (count + segmentRows - 1) / segmentRows);
+        const size_t perSegment = (used == 0) ? 0 : (count + used - 1) / used;
+
+        pool.ParallelFor(used, [&](size_t k)
+        {
+            Segment& segment = segments[k];
+            segment.filtered.clear();
+            segment.compressed.clear();
+
+            size_t first = k * perSegment, end = std::min(count, first + perSegment);
+            for (size_t r = first; r < end; ++r)
+            {
+                const uint8_t* above = (r == 0) ? previous.data() : pending.data() + (r - 1) * rowBytes;
+                FilterRow(pending.data() + r * rowBytes, above, rowBytes, segment.candidate, segment.filtered);
+            }
+            segment.adler = Adler32(1, segment.filtered.data(), segment.filtered.size());
+            DeflateChunk(segment.filtered.data(), segment.filtered.size(), level, last && k + 1 == used, segment.compressed);
+        });
+
+        for (size_t k = 0; k < used; ++k)
+        {
+            adler = Adler32Combine(adler, segments[k].adler, segments[k].filtered.size());
+            compressed.insert(compressed.end(), segments[k].compressed.begin(), segments[k].compressed.end());
+        }
+        if (last && used == 0)
+            DeflateChunk(nullptr, 0, level, true, compressed);
+
+        if (count > 0)
+            std::copy(pending.end() - rowBytes, pending.end(), previous.begin());
+        pending.clear();
+
+        if (!last)
+        {
+            WriteChunk("IDAT", compressed);
+            compressed.clear();
+        }
+    }
+
+    void WriteChunk(const char* type, const std::vector<uint8_t>& data)
+    {
+        std::vector<uint8_t> length;
+        PutBigEndian(length, static_cast<uint32_t>(data.size()));
+        file.write(reinterpret_cast<const char*>(length.data()), 4);
+
+        uint32_t crc = Crc32(0, reinterpret_cast<const uint8_t*>(type), 4);
+        crc = Crc32(crc, data.data(), data.size());
+        file.write(type, 4);
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+        std::vector<uint8_t> trailer;
+        PutBigEndian(trailer, crc);
+        file.write(reinterpret_cast<const char*>(trailer.data()), 4);
+    }
+};
+
+// QOI ("Quite OK Image" format): pixels coded against the previous one and a small hash table of
+//  recent colors, a single fast pass with no entropy coding.
+class QoiStreamWriter : public ImageWriter
+{
+public:
+    QoiStreamWriter(const std::string& path, uint32_t width, uint32_t height) :
+        path(path), file(path, std::ios::binary), width(width), height(height)
+    {
+        if (!file)
+            throw std::runtime_error("cannot open " + path + " for writing");
+
+        std::vector<uint8_t> header = { 'q', 'o', 'i', 'f' };
+        PutBigEndian(header, width);
+        PutBigEndian(header, height);
+        header.insert(header.end(), { 4, 0 });            // RGBA, sRGB with linear alpha
+        file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+    }
+
+    void WriteRow(const Color* row) override
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const Color& pixel = row[x];
+            if (Same(pixel, last))
+            {
+                if (++run == 62)
+                    EndRun();
+                continue;
+            }
+            EndRun();
+
+            const uint32_t slot = (pixel.r * 3u + pixel.g * 5u + pixel.b * 7u + pixel.a * 11u) % 64u;
+            if (Same(index[slot], pixel))
+                out.push_back(static_cast<uint8_t>(slot));                               // QOI_OP_INDEX
+            else if (pixel.a != last.a)
+                out.insert(out.end(), { 0xFF, pixel.r, pixel.g, pixel.b, pixel.a });     // QOI_OP_RGBA
+            else
+            {
+                int dr = static_cast<int8_t>(pixel.r - last.r);
+                int dg = static_cast<int8_t>(pixel.g - last.g);
+                int db = static_cast<int8_t>(pixel.b - last.b);
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)      // QOI_OP_DIFF
+                    out.push_back(static_cast<uint8_t>(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+                else if (dg >= -32 && dg <= 31 && dr - dg >= -8 && dr - dg <= 7 && db - dg >= -8 && db - dg <= 7)
+                    out.insert(out.end(), { static_cast<uint8_t>(0x80 | (dg + 32)),       // QOI_OP_LUMA
+                        static_cast<uint8_t>(((dr - dg + 8) << 4) | (db - dg + 8)) });
+                else
+                    out.insert(out.end(), { 0xFE, pixel.r, pixel.g, pixel.b });          // QOI_OP_RGB
+            }
+            index[slot] = pixel;
+            last = pixel;
+        }
+        file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+        out.clear();
+        ++this->rows;
+    }
+
+    bool Finish() override
+    {
+        EndRun();
+        out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+        file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+        return Complete(path, file, this->rows, this->height);
+    }
+
+private:
+    std::string path;
+    std::ofstream file;
+    uint32_t width, height;
+    uint32_t rows = 0;
+
+    Color last = Color(0, 0, 0, 255);
+    Color index[64] = {};
+    uint32_t run = 0;
+    std::vector<uint8_t> out;
+
+    static inline bool Same(const Color& a, const Color& b)
+    {
+        return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+    }
+
+    inline void EndRun()
+    {
+        if (run > 0)
+            out.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));                        // QOI_OP_RUN
+        run = 0;
+    }
+};
+
+// Binary PPM (P6): a text header and plain RGB rows. Alpha is dropped.
+class PpmStreamWriter : public ImageWriter
+{
+public:
+    PpmStreamWriter(const std::string& path, uint32_t width, uint32_t height) :
+        path(path), file(path, std::ios::binary), height(height), line(static_cast<size_t>(width) * 3)
+    {
+        if (!file)
+            throw std::runtime_error("cannot open " + path + " for writing");
+        file << "P6\n" << width << " " << height << "\n255\n";
+    }
+
+    void WriteRow(const Color* row) override
+    {
+        for (size_t x = 0; x < line.size() / 3; ++x)
+        {
+            line[3 * x] = row[x].r;
+            line[3 * x + 1] = row[x].g;
+            line[3 * x + 2] = row[x].b;
+        }
+        file.write(reinterpret_cast<const char*>(line.data()), static_cast<std::streamsize>(line.size()));
+        ++this->rows;
+    }
+
+    bool Finish() override
+    {
+        return Complete(path, file, this->rows, this->height);
+    }
+
+private:
+    std::string path;
+    std::ofstream file;
+    uint32_t height;
+    uint32_t rows = 0;
+    std::vector<uint8_t> line;
+};
+
+// Raw RGBA bytes, top row first, with no header at all
+class RawStreamWriter : public ImageWriter
+{
+public:
+    RawStreamWriter(const std::string& path, uint32_t width, uint32_t height) :
+        path(path), file(path, std::ios::binary), width(width), height(height)
+    {
+        if (!file)
+            throw std::runtime_error("cannot open " + path + " for writing");
+    }
+
+    void WriteRow(const Color* row) override
+    {
+        file.write(reinterpret_cast<const char*>(row), static_cast<std::streamsize>(width) * 4);
+        ++this->rows;
+    }
+
+    bool Finish() override
+    {
+        return Complete(path, file, this->rows, this->height);
+    }
+
+private:
+    std::string path;
+    std::ofstream file;
+    uint32_t width, height;
+    uint32_t rows = 0;
+};
+
+bool ImageWriter::Complete(const std::string& path, std::ostream& file, uint32_t rows, uint32_t height)
+{
+    file.flush();
+    if (rows != height)
+        std::cerr << "Writing to " << path << " failed: " << rows << " of " << height << " rows given." << std::endl;
+    else if (!file)
+        std::cerr << "Writing to " << path << " failed." << std::endl;
+    return file && rows == height;
+}
+
+std::unique_ptr<ImageWriter> ImageWriter::Open(const std::string& filename, OutputFormat format, uint32_t pngLevel,
+    uint32_t width, uint32_t height, ThreadPool& pool)
+{
+    std::string resStr = std::to_string(width) + "x" + std::to_string(height);
+    switch (format)
+    {
+    case OutputFormat::QOI:
+        std::cout << "Writing to QOI with resolution " << resStr << ".\n";
+        return std::make_unique<QoiStreamWriter>(filename + ".qoi", width, height);
+    case OutputFormat::PPM:
+        std::cout << "Writing to PPM with resolution " << resStr << ".\n";
+        return std::make_unique<PpmStreamWriter>(filename + ".ppm", width, height);
+    case OutputFormat::RAW:
+        std::cout << "Writing to raw RGBA with resolution " << resStr << ".\n";
+        return std::make_unique<RawStreamWriter>(filename + ".rgba", width, height);
+    default:
+        std::cout << "Writing to PNG with resolution " << resStr << " at level " << pngLevel << ".\n";
+        return std::make_unique<PngStreamWriter>(filename + ".png", width, height, pngLevel, pool);
+    }
+}
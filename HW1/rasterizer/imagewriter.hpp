@@ -0,0 +1,43 @@
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+#include "image.hpp"
+#include "loader.hpp"
+
+class ThreadPool;
+
+// The output stage: encodes an image to disk a row at a time, top row first, so that frames
+//  rendered in horizontal bands never have to be held in memory whole. Only the rows not yet
+//  encoded are kept, which is at most a few megabytes per thread whatever the frame size.
+class ImageWriter
+{
+public:
+    virtual ~ImageWriter() = default;
+
+    // Append the next row below the ones written so far, `width` pixels wide
+    virtual void WriteRow(const Color* row) = 0;
+
+    // Encode what is left after the last row; false if the file could not be written completely
+    virtual bool Finish() = 0;
+
+    /**
+     * Create `filename` with the extension of `format`, for an image of the given size.
+     * Throws std::runtime_error if the file cannot be opened.
+     * @param pngLevel: the compression level of PNG output, 0 (stored) to 9
+     * @param pool: the threads PNG output compresses with; it must outlive the writer
+     */
+    static std::unique_ptr<ImageWriter> Open(const std::string& filename, OutputFormat format, uint32_t pngLevel,
+        uint32_t width, uint32_t height, ThreadPool& pool);
+
+protected:
+    // Flush `file` once everything is written to it, and report if it did not get all `height`
+    //  rows of `path`; the result of Finish
+    static bool Complete(const std::string& path, std::ostream& file, uint32_t rows, uint32_t height);
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "lightgrid.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+LightGrid::LightGrid(const ShadingContext& context, const glm::mat4& view, const glm::mat4& projection, const glm::mat4& screenspace,
+    uint32_t width, uint32_t height, uint32_t tileSize, float cutoff) :
+    lights(context.lights),
+    view(view),
+    worldToScreen(-(screenspace * projection * view)),
+    depthScale(projection[3][2]),
+    depthOffset(projection[2][2]),
+    tileSize(std::max(tileSize, 1u)),
+    tilesX((width + this->tileSize - 1) / this->tileSize),
+    tiles(static_cast<size_t>(tilesX) * ((height + this->tileSize - 1) / this->tileSize)),
+    cutoff(cutoff)
+{
+    // Both the diffuse and the specular factor are at most 1, so a light of intensity I and
+    //  brightest channel c adds at most 2 * 255 * c * |I| / d^2 levels at distance d.
+    //  The margin covers the rounding of the shader's own arithmetic.
+    for (size_t i = 0; i != lights.Count(); ++i)
+    {
+        float brightest = 255.f * std::max({ lights.r[i], lights.g[i], lights.b[i] });
+        this->strength.push_back(1.001f * 2.f * std::abs(lights.intensity[i]) * brightest);
+        this->position.emplace_back(lights.x[i], lights.y[i], lights.z[i]);
+    }
+}
+
+void LightGrid::Build(const ImageGrey& ZBuffer, float cleared, const TileRect& rect, uint32_t samples)
+{
+    LightArrays& list = tiles[static_cast<size_t>(rect.y0 / tileSize) * tilesX + rect.x0 / tileSize];
+    list.Clear();
+
+    // NDC depth range of the covered pixels, greater is nearer
+    float nearest = -FLT_MAX;
+    float farthest = FLT_MAX;
+    for (uint32_t y = rect.y0; y < rect.y1; ++y)
+    {
+        const float* row = ZBuffer.Row(y);
+        for (uint32_t x = rect.x0 * samples; x < rect.x1 * samples; ++x)
+            if (row[x] > cleared)
+            {
+                nearest = std::max(nearest, row[x]);
+                farthest = std::min(farthest, row[x]);
+            }
+    }
+    if (nearest < farthest)
+        return;                     // nothing to shade
+
+    // The same range in view-space z, negative in front of the camera. Triangles crossing the far
+    //  plane leave depths past it, where the mapping no longer holds; the range is then unbounded.
+    float viewNear = depthScale / (nearest - depthOffset);
+    float viewFar = (farthest <= -1.f) ? -FLT_MAX : depthScale / (farthest - depthOffset);
+
+    // Planes bounding the tile's covered region in world space, normalized, inside is >= 0: the four
+    //  sides of the tile frustum, then the near and far depth of its pixels
+    auto row = [this](int i) {
+        return glm::vec4(worldToScreen[0][i], worldToScreen[1][i], worldToScreen[2][i], worldToScreen[3][i]);
+    };
+    const glm::vec4 viewZ(view[0][2], view[1][2], view[2][2], view[3][2]);
+    glm::vec4 planes[6] = {
+        row(0) - static_cast<float>(rect.x0) * row(3),
+        static_cast<float>(rect.x1) * row(3) - row(0),
+        row(1) - static_cast<float>(rect.y0) * row(3),
+        static_cast<float>(rect.y1) * row(3) - row(1),
+        glm::vec4(-viewZ.x, -viewZ.y, -viewZ.z, viewNear - viewZ.w),
+        glm::vec4(viewZ.x, viewZ.y, viewZ.z, viewZ.w - viewFar),
+    };
+    const size_t planeCount = (viewFar == -FLT_MAX) ? 5 : 6;
+    for (size_t k = 0; k != planeCount; ++k)
+        planes[k] /= glm::length(glm::vec3(planes[k]));
+
+    // Bound of every light over the region: the distance to a convex region is at least the
+    //  distance outside any one of its planes, and a light inside it is never dropped
+    std::vector<float> bound(lights.Count());
+    for (size_t i = 0; i != lights.Count(); ++i)
+    {
+        float distance = 0.f;
+        for (size_t k = 0; k != planeCount; ++k)
+            distance = std::max(distance, -(glm::dot(glm::vec3(planes[k]), position[i]) + planes[k].w));
+        if (strength[i] == 0.f)
+            bound[i] = 0.f;
+        else
+            bound[i] = (distance > 0.f) ? strength[i] / (distance * distance) : FLT_MAX;
+    }
+
+    // Drop the weakest lights while their sum stays within the cutoff
+    std::vector<uint32_t> order(lights.Count());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return bound[a] < bound[b]; });
+    float dropped = 0.f;
+    for (uint32_t i : order)
+    {
+        dropped += bound[i];
+        if (!(dropped <= cutoff))
+            break;
+        bound[i] = -1.f;
+    }
+
+    // the rest are shaded in their original order
+    for (size_t i = 0; i != lights.Count(); ++i)
+        if (bound[i] >= 0.f)
+            list.Add(lights, i);
+}
@@ -0,0 +1,59 @@
+#ifndef LIGHTGRID_H
+#define LIGHTGRID_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entities.hpp"
+#include "image.hpp"
+#include "shadingcontext.hpp"
+
+// Per-tile light lists for shading with many point lights (tiled forward+).
+//  After the depth pass, each tile is bounded by its frustum, cut in depth at the nearest and
+//  farthest covered pixels of the ZBuffer. Every light gets a bound on what it adds to any pixel in
+//  that region, from its distance to the region's nearest point, and the weakest lights are dropped
+//  while their summed bound stays within `cutoff` 8-bit levels. The light missing at any pixel is
+//  therefore below `cutoff` levels per channel before tone mapping, whatever the number of lights.
+//  Tiles are built independently, so they can be built concurrently.
+class LightGrid
+{
+public:
+    /**
+     * @param context: the lights to distribute
+     * @param view, projection, screenspace: the camera matrices, from world to screen space
+     * @param width, height: the viewport in pixels
+     * @param tileSize: edge of the square tiles, in pixels
+     * @param cutoff: most light dropped at a pixel, over all lights, in 8-bit color levels
+     */
+    LightGrid(const ShadingContext& context, const glm::mat4& view, const glm::mat4& projection, const glm::mat4& screenspace,
+        uint32_t width, uint32_t height, uint32_t tileSize, float cutoff);
+
+    /**
+     * Collect the lights of the tile covering `rect`, from the final depth of its pixels.
+     * @param cleared: the depth of pixels no triangle covers
+     * @param samples: depths per pixel in the rows of `ZBuffer`, e.g. the samples of MSAA
+     */
+    void Build(const ImageGrey& ZBuffer, float cleared, const TileRect& rect, uint32_t samples = 1);
+
+    // The lights to shade pixel (x, y) with
+    inline const LightArrays& At(uint32_t x, uint32_t y) const
+    {
+        return tiles[static_cast<size_t>(y / tileSize) * tilesX + x / tileSize];
+    }
+
+private:
+    const LightArrays& lights;
+    std::vector<float> strength;        // bound on the levels a light adds at unit distance
+    std::vector<glm::vec3> position;
+    float cutoff;
+
+    glm::mat4 view;
+    glm::mat4 worldToScreen;        // negated, so that w is positive in front of the camera
+    float depthScale, depthOffset;  // NDC depth = depthOffset + depthScale / view z
+
+    uint32_t tileSize;
+    uint32_t tilesX;
+    std::vector<LightArrays> tiles;
+};
+
+#endif
@@ -1,17 +1,19 @@
 #include "loader.hpp"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <iterator>
 
+#include "lod.hpp"
+#include "meshcache.hpp"
+#include "meshorder.hpp"
+#include "objparser.hpp"
+#include "threadpool.hpp"
 #include "../thirdparty/fkyaml/node.hpp"
 
-#define TINYOBJLOADER_IMPLEMENTATION 
-#define TINYOBJLOADER_USE_MAPBOX_EARCUT                 // use robust triangulation
-#define TINYOBJLOADER_DONOT_INCLUDE_MAPBOX_EARCUT
-#include "../thirdparty/mapbox/earcut.hpp"              // included as a separate header
-#include "../thirdparty/tinyobj/tiny_obj_loader.h"
-
 void LoadVec3(const fkyaml::node& parent, std::string tag, glm::vec3& vec)
 {
     if (parent.contains(tag))
@@ -160,17 +162,148 @@ bool Loader::LoadYaml()
 
         // resolution
         LOAD_NODE_FROM_YAML(resNode, root, resolution)
-        const uint32_t MAX_RES = 4096;\
+        const uint32_t MAX_RES = 16384;
         LOAD_DATA_FROM_YAML(this->width, resNode, width, uint32_t)
         LOAD_DATA_FROM_YAML(this->height, resNode, height, uint32_t)
 
         if (width > MAX_RES || height > MAX_RES)
-            throw fkyaml::exception("invalid resolution: width/height exceeding 4096");
+            throw fkyaml::exception("invalid resolution: width/height exceeding 16384");
+
+        // optional: force the instruction set of the raster kernels
+        if (root.contains("simd"))
+        {
+            LOAD_DEF_DATA_FROM_YAML(simd, root, simd, std::string)
+            if (simd == "auto")
+                this->simdLevel = SimdLevel::AUTO;
+            else if (simd == "scalar")
+                this->simdLevel = SimdLevel::SCALAR;
+            else if (simd == "SSE")
+                this->simdLevel = SimdLevel::SSE;
+            else if (simd == "AVX2")
+                this->simdLevel = SimdLevel::AVX2;
+            else
+            {
+                std::string msg = "cannot recognize simd level " + simd;
+                throw fkyaml::exception(msg.c_str());
+            }
+        }
+
+        // optional: culling stage between the transform and the raster stage
+        if (root.contains("culling"))
+        {
+            auto cullNode = root["culling"];
+            if (cullNode.contains("face"))
+            {
+                LOAD_DEF_DATA_FROM_YAML(face, cullNode, face, std::string)
+                if (face == "none")
+                    this->cullConfig.face = CullFace::NONE;
+                else if (face == "back")
+                    this->cullConfig.face = CullFace::BACK;
+                else if (face == "front")
+                    this->cullConfig.face = CullFace::FRONT;
+                else
+                {
+                    std::string msg = "cannot recognize cull face " + face;
+                    throw fkyaml::exception(msg.c_str());
+                }
+            }
+            if (cullNode.contains("winding"))
+            {
+                LOAD_DEF_DATA_FROM_YAML(winding, cullNode, winding, std::string)
+                if (winding == "ccw")
+                    this->cullConfig.frontCCW = true;
+                else if (winding == "cw")
+                    this->cullConfig.frontCCW = false;
+                else
+                {
+                    std::string msg = "cannot recognize winding " + winding;
+                    throw fkyaml::exception(msg.c_str());
+                }
+            }
+            if (cullNode.contains("frustum"))
+            {
+                LOAD_DATA_FROM_YAML(this->cullConfig.frustum, cullNode, frustum, bool)
+            }
+            if (cullNode.contains("small"))
+            {
+                LOAD_DATA_FROM_YAML(this->cullConfig.small, cullNode, small, bool)
+            }
+        }
 
         // obj/output filename
         LOAD_DATA_FROM_YAML(this->modelName, root, obj, std::string)
         LOAD_DATA_FROM_YAML(this->outputName, root, output, std::string)
 
+        // optional: whether the model is loaded through its binary cache, off by default since it
+        //  writes <obj>.meshcache next to the model
+        if (root.contains("mesh-cache"))
+        {
+            LOAD_DATA_FROM_YAML(this->meshCache, root, mesh-cache, bool)
+        }
+
+        // optional: order of the triangles of each shape, as in the OBJ file unless set
+        if (root.contains("mesh-order"))
+        {
+            LOAD_DEF_DATA_FROM_YAML(order, root, mesh-order, std::string)
+            if (order == "none")
+                this->meshOrder = MeshOrder::NONE;
+            else if (order == "cache")
+                this->meshOrder = MeshOrder::CACHE;
+            else if (order == "morton")
+                this->meshOrder = MeshOrder::MORTON;
+            else
+            {
+                std::string msg = "cannot recognize mesh order " + order;
+                throw fkyaml::exception(msg.c_str());
+            }
+        }
+
+        // optional: largest simplification error, in pixels, of the level of detail drawn for each shape;
+        //  absent or 0 draws every shape at full detail and builds no levels
+        if (root.contains("lod"))
+        {
+            auto lodNode = root["lod"];
+            if (lodNode.is_integer())
+                this->lodThreshold = static_cast<float>(lodNode.get_value<int64_t>());
+            else
+                this->lodThreshold = lodNode.get_value<float>();
+            if (this->lodThreshold < 0)
+                throw fkyaml::exception("lod cannot be negative");
+        }
+
+        // optional: output file format
+        if (root.contains("format"))
+        {
+            LOAD_DEF_DATA_FROM_YAML(format, root, format, std::string)
+            if (format == "png")
+                this->outputFormat = OutputFormat::PNG;
+            else if (format == "qoi")
+                this->outputFormat = OutputFormat::QOI;
+            else if (format == "ppm")
+                this->outputFormat = OutputFormat::PPM;
+            else if (format == "raw")
+                this->outputFormat = OutputFormat::RAW;
+            else
+            {
+                std::string msg = "cannot recognize output format " + format;
+                throw fkyaml::exception(msg.c_str());
+            }
+        }
+
+        if (root.contains("png-level"))
+        {
+            LOAD_DATA_FROM_YAML(this->pngLevel, root, png-level, uint32_t)
+            if (this->pngLevel > 9)
+                throw fkyaml::exception("invalid png-level: must be between 0 and 9");
+        }
+
+        // optional: render and write the frame in horizontal strips of this many rows,
+        //  so that memory scales with the strip instead of the frame
+        if (root.contains("strip-height"))
+        {
+            LOAD_DATA_FROM_YAML(this->stripHeight, root, strip-height, uint32_t)
+        }
+
         // If the task is TRANSFORM or SHADING, then there must be a camera; load it
         if (this->type != TestType::TRIANGLE)
         {
@@ -216,14 +349,134 @@ bool Loader::LoadYaml()
                 }
             }
 
+            // optional: render a sequence of frames, with the camera and transforms moving between keyframes
+            if (root.contains("animation"))
+            {
+                if (this->type == TestType::TRANSFORM_TEST)
+                    throw fkyaml::exception("transform-test cannot be animated");
+
+                auto animationNode = root["animation"];
+                LOAD_DATA_FROM_YAML(this->frames, animationNode, frames, uint32_t)
+                if (this->frames == 0)
+                    throw fkyaml::exception("animation needs at least one frame");
+
+                if (animationNode.contains("camera"))
+                {
+                    for (auto& keyNode : animationNode["camera"])
+                    {
+                        CameraKey key;
+                        LOAD_DATA_FROM_YAML(key.frame, keyNode, frame, uint32_t)
+                        LOAD_VEC3_FROM_YAML(keyNode, pos, key.pos)
+                        LOAD_VEC3_FROM_YAML(keyNode, lookAt, key.lookAt)
+                        LOAD_VEC3_FROM_YAML(keyNode, up, key.up)
+                        if (!this->cameraTrack.empty() && key.frame <= this->cameraTrack.back().frame)
+                            throw fkyaml::exception("camera keys must be in increasing frame order");
+                        this->cameraTrack.push_back(key);
+                    }
+                }
+
+                // one track per transform, in the order of `transforms`; a track past the last one adds a transform
+                if (animationNode.contains("transforms"))
+                {
+                    for (auto& trackNode : animationNode["transforms"])
+                    {
+                        LOAD_NODE_FROM_YAML(keysNode, trackNode, keys)
+                        std::vector<TransformKey> track;
+                        for (auto& keyNode : keysNode)
+                        {
+                            LOAD_DEF_DATA_FROM_YAML(frame, keyNode, frame, uint32_t)
+                            glm::quat rotation;
+                            glm::vec3 translation, scale;
+                            LOAD_QUAT_FROM_YAML(keyNode, rotation, rotation)
+                            LOAD_VEC3_FROM_YAML(keyNode, translation, translation)
+                            LOAD_VEC3_FROM_YAML(keyNode, scale, scale)
+                            if (!track.empty() && frame <= track.back().frame)
+                                throw fkyaml::exception("transform keys must be in increasing frame order");
+                            track.push_back({ frame, MeshTransform(rotation, translation, scale) });
+                        }
+                        if (track.empty())
+                            throw fkyaml::exception("transform track without keys");
+                        this->transformTracks.push_back(std::move(track));
+                    }
+                    while (this->transforms.size() < this->transformTracks.size())
+                        this->transforms.push_back(this->transformTracks[this->transforms.size()].front().transform);
+                }
+            }
+
             if (this->type == TestType::SHADING)
             {
                 LOAD_DATA_FROM_YAML(this->specularExponent, root, exponent, float)
                 LOAD_COLOR_FROM_YAML(root, ambient, this->ambientColor)
+
+                // optional: per-tile light culling drops at most this many 8-bit levels of light per pixel;
+                //  absent or 0 disables culling, which keeps shading exact
+                if (root.contains("light-cutoff"))
+                {
+                    auto cutoffNode = root["light-cutoff"];
+                    if (cutoffNode.is_integer())
+                        this->lightCutoff = static_cast<float>(cutoffNode.get_value<int64_t>());
+                    else
+                        this->lightCutoff = cutoffNode.get_value<float>();
+                    if (this->lightCutoff < 0)
+                        throw fkyaml::exception("light-cutoff cannot be negative");
+                }
+
+                // optional: conversion of the float framebuffer to 8 bits
+                if (root.contains("tonemap"))
+                {
+                    LOAD_DEF_DATA_FROM_YAML(tonemap, root, tonemap, std::string)
+                    if (tonemap == "none")
+                        this->toneMapping = ToneMapping::NONE;
+                    else if (tonemap == "reinhard")
+                        this->toneMapping = ToneMapping::REINHARD;
+                    else if (tonemap == "aces")
+                        this->toneMapping = ToneMapping::ACES;
+                    else
+                    {
+                        std::string msg = "cannot recognize tonemap " + tonemap;
+                        throw fkyaml::exception(msg.c_str());
+                    }
+                }
+                if (root.contains("dither"))
+                {
+                    LOAD_DATA_FROM_YAML(this->dither, root, dither, bool)
+                }
+
+                // optional: shading strategy, defaults to forward shading
+                if (root.contains("shading-mode"))
+                {
+                    LOAD_DEF_DATA_FROM_YAML(mode, root, shading-mode, std::string)
+                    if (mode == "forward")
+                        this->shadingMode = ShadingMode::FORWARD;
+                    else if (mode == "visibility")
+                        this->shadingMode = ShadingMode::VISIBILITY;
+                    else
+                    {
+                        std::string msg = "cannot recognize shading mode " + mode;
+                        throw fkyaml::exception(msg.c_str());
+                    }
+                }
+
+                // optional: MSAA keeps a depth per sample and shades every pixel once per triangle in it.
+                //  SSAA, which would shade every sample, is not applied; see AntiAliasConfig.
+                if (root.contains("antialias"))
+                {
+                    LOAD_DEF_DATA_FROM_YAML(AAName, root, antialias, std::string)
+                    if (AAName == "MSAA")
+                    {
+                        this->AAConfig = AntiAliasConfig::MSAA;
+                        LOAD_DATA_FROM_YAML(this->AASpp, root, samples, uint32_t)
+                        if (this->AASpp == 0 || this->AASpp > 32)
+                            throw fkyaml::exception("MSAA supports 1 to 32 samples");
+                    }
+                    else if (AAName == "SSAA")
+                        std::cout << "[WARNING] SSAA is not applied to shading, use MSAA" << std::endl;
+                }
             }
         }
         else if (this->type == TestType::TRIANGLE)
-        // if the task is TRIANGLE, then need to check whether it is SSAA
+        // if the task is TRIANGLE, then need to check whether it is SSAA or MSAA.
+        //  Shading reads `antialias` above, other tasks ignore it; see AntiAliasConfig.
         {
             LOAD_DEF_DATA_FROM_YAML(AAName, root, antialias, std::string)
             if (AAName == "none")
@@ -235,6 +488,15 @@ bool Loader::LoadYaml()
             {
                 this->AAConfig = AntiAliasConfig::SSAA;
                 LOAD_DATA_FROM_YAML(this->AASpp, root, samples, uint32_t)
+                if (this->AASpp == 0)
+                    throw fkyaml::exception("SSAA needs at least one sample");
+            }
+            else if (AAName == "MSAA")
+            {
+                this->AAConfig = AntiAliasConfig::MSAA;
+                LOAD_DATA_FROM_YAML(this->AASpp, root, samples, uint32_t)
+                if (this->AASpp == 0 || this->AASpp > 32)
+                    throw fkyaml::exception("MSAA supports 1 to 32 samples");
             }
         }
 
@@ -267,29 +529,143 @@ bool Loader::LoadYaml()
     return true;
 }
 
+// Index of the last key at or before `frame`, and how far `frame` is towards the next key
+template<typename Key>
+static size_t FindKey(const std::vector<Key>& track, uint32_t frame, float& t)
+{
+    size_t k = 0;
+    while (k + 1 < track.size() && track[k + 1].frame <= frame)
+        ++k;
+    t = 0.f;
+    if (k + 1 < track.size() && frame > track[k].frame)
+        t = static_cast<float>(frame - track[k].frame) / static_cast<float>(track[k + 1].frame - track[k].frame);
+    return k;
+}
+
+void Loader::SetFrame(uint32_t frame)
+{
+    float t;
+    if (!this->cameraTrack.empty())
+    {
+        size_t k = FindKey(this->cameraTrack, frame, t);
+        const CameraKey& a = this->cameraTrack[k];
+        const CameraKey& b = this->cameraTrack[std::min(k + 1, this->cameraTrack.size() - 1)];
+        this->camera.pos = glm::mix(a.pos, b.pos, t);
+        this->camera.lookAt = glm::mix(a.lookAt, b.lookAt, t);
+        this->camera.up = glm::mix(a.up, b.up, t);
+    }
+
+    for (size_t i = 0; i < this->transformTracks.size(); ++i)
+    {
+        const std::vector<TransformKey>& track = this->transformTracks[i];
+        size_t k = FindKey(track, frame, t);
+        const MeshTransform& a = track[k].transform;
+        const MeshTransform& b = track[std::min(k + 1, track.size() - 1)].transform;
+        this->transforms[i] = MeshTransform(glm::slerp(a.rotation, b.rotation, t),
+            glm::mix(a.translation, b.translation, t), glm::mix(a.scale, b.scale, t));
+    }
+}
+
+std::string Loader::GetOutputName(uint32_t frame) const
+{
+    if (this->frames <= 1)
+        return this->outputName;
+
+    char number[16];
+    std::snprintf(number, sizeof(number), "_%04u", frame);
+    return this->outputName + number;
+}
+
 bool Loader::LoadObj()
 {
     std::string filename = this->modelName + ".obj";
-    tinyobj::ObjReaderConfig readerConfig;
-    readerConfig.mtl_search_path = "./";
-    readerConfig.triangulate = true;
-    readerConfig.triangulation_method = "earcut";
-    readerConfig.vertex_color = true;
+    MeshBuild build;
+    build.levels = (this->lodThreshold > 0);
+    build.order = this->meshOrder;
+    if (this->meshCache && LoadMeshCache(filename, this->mesh, build))
+        return true;
 
-    tinyobj::ObjReader reader;
+    // Large models are parsed on every thread; the pool is gone before rendering sets up its own
+    ThreadPool pool;
+    ObjParser reader(pool);
 
-    if (!reader.ParseFromFile(filename, readerConfig)) 
+    if (!reader.ParseFromFile(filename, "./")) 
     {
         if (!reader.Error().empty()) 
-            std::cerr << "TinyObjReader [ERROR]: " << reader.Error();
+            std::cerr << "ObjParser [ERROR]: " << reader.Error();
         return false;
     }
 
     if (!reader.Warning().empty()) 
-        std::cout << "TinyObjReader [WARNING]: " << reader.Warning();
+        std::cout << "ObjParser [WARNING]: " << reader.Warning();
+
+    // Keep the positions, normals and triangle corners, all shapes sharing one index array
+    tinyobj::attrib_t attribs = reader.TakeAttrib();
+    std::vector<float> vertices = std::move(attribs.vertices);
+    std::vector<float> normals = std::move(attribs.normals);
+    std::vector<MeshIndex> indices;
+    std::vector<MeshShape> shapes;
+
+    // The parser only warns about corners past the arrays, which every later stage would read from
+    const int64_t vertexLimit = static_cast<int64_t>(vertices.size() / 3);
+    const int64_t normalLimit = static_cast<int64_t>(normals.size() / 3);
+    for (const tinyobj::shape_t& shape : reader.GetShapes())
+    {
+        MeshShape meshShape;
+        meshShape.name = shape.name;
+        meshShape.first = indices.size();
+        meshShape.count = shape.mesh.indices.size();
+        for (const tinyobj::index_t& index : shape.mesh.indices)
+        {
+            if (index.vertex_index < 0 || index.vertex_index >= vertexLimit ||
+                index.normal_index < -1 || index.normal_index >= normalLimit)
+            {
+                std::cerr << "ObjParser [ERROR]: face index out of range in shape '" << shape.name << "' of " << filename << "\n";
+                return false;
+            }
+            indices.push_back({ index.vertex_index, index.normal_index });
+        }
+        shapes.push_back(std::move(meshShape));
+    }
+
+    // Triangles are reordered within each shape, shapes on separate threads
+    pool.ParallelFor(shapes.size(), [&](size_t s)
+    {
+        OrderTriangles(indices, shapes[s].first, shapes[s].count, vertices, this->meshOrder);
+    });
+
+    // Levels of detail: every shape is simplified on its own thread, and the corners of its levels
+    //  are appended after those of all shapes at full detail
+    if (build.levels)
+    {
+        std::vector<LodChain> chains(shapes.size());
+        const ArrayView<float> vertexView{ vertices.data(), vertices.size() };
+        pool.ParallelFor(shapes.size(), [&](size_t s)
+        {
+            chains[s] = BuildLodChain(vertexView, { indices.data() + shapes[s].first, shapes[s].count });
+            for (const MeshLevel& level : chains[s].levels)
+                OrderTriangles(chains[s].indices, level.first, level.count, vertices, this->meshOrder);
+        });
+        for (size_t s = 0; s < shapes.size(); ++s)
+        {
+            for (MeshLevel level : chains[s].levels)
+            {
+                level.first += indices.size();
+                shapes[s].levels.push_back(level);
+            }
+            indices.insert(indices.end(), chains[s].indices.begin(), chains[s].indices.end());
+            std::copy(std::begin(chains[s].center), std::end(chains[s].center), shapes[s].center);
+            shapes[s].radius = chains[s].radius;
+        }
+    }
+
+    // Positions and normals follow the order of the triangles, so the vertex stage reads them front to back
+    if (this->meshOrder != MeshOrder::NONE)
+        OrderVertices(vertices, normals, indices);
+    this->mesh.Assign(std::move(vertices), std::move(normals), std::move(indices), std::move(shapes));
 
-    this->attribs = reader.GetAttrib();
-    this->shapes = reader.GetShapes();
+    if (this->meshCache && !SaveMeshCache(filename, this->mesh, build))
+        std::cout << "[WARNING] cannot write mesh cache " << MeshCacheName(filename) << std::endl;
 
     return true;
 }
@@ -6,13 +6,7 @@
 #include <optional>
 
 #include "entities.hpp"
-#include "../thirdparty/tinyobj/tiny_obj_fwd.h"
-
-namespace tinyobj
-{
-    struct shape_t;
-    struct attrib_t;
-}
+#include "mesh.hpp"
 
 // Loads yaml config and obj models
 
@@ -24,9 +18,79 @@ enum class TestType
     ERROR
 };
 
+// Anti-aliasing of TestType::TRIANGLE and TestType::SHADING, the tasks that read `antialias`; the
+//  transform and depth tasks ignore it. Both modes test coverage at `spp` fixed sample positions.
+//  SSAA weights the triangle's color by its covered fraction, and is not applied to shading, where
+//  it would shade every sample. MSAA stores a color per sample, shaded once per pixel and triangle,
+//  and averages the samples when the tile is done; shading also keeps a depth per sample.
 enum class AntiAliasConfig
 {
-    NONE, SSAA
+    NONE, SSAA, MSAA
+};
+
+// How TestType::SHADING shades visible pixels:
+//  FORWARD rasterizes twice and shades where the depth equals the ZBuffer,
+//  VISIBILITY records the nearest triangle per pixel and shades each pixel once afterwards
+enum class ShadingMode
+{
+    FORWARD, VISIBILITY
+};
+
+// Instruction set used by the raster and vertex kernels; AUTO picks the best one the CPU supports
+enum class SimdLevel
+{
+    AUTO, SCALAR, SSE, AVX2
+};
+
+// Curve applied to the float framebuffer of shading tasks before it is packed to 8 bits:
+//  NONE clamps at full intensity, REINHARD maps c to c / (1 + c), ACES uses the filmic fit of Narkowicz
+enum class ToneMapping
+{
+    NONE, REINHARD, ACES
+};
+
+// File format of the output image. PNG is compressed at a configurable level; QOI is a fast
+//  lossless format, PPM and RAW are uncompressed, for pipelines that convert the frames anyway
+enum class OutputFormat
+{
+    PNG, QOI, PPM, RAW
+};
+
+// Order of the triangles of each shape after loading: NONE keeps the order of the file, CACHE orders
+//  them for vertex reuse, MORTON along a Z-order curve through their centroids
+enum class MeshOrder
+{
+    NONE, CACHE, MORTON
+};
+
+// Which faces the cull stage drops, judged by their winding on screen
+enum class CullFace
+{
+    NONE, BACK, FRONT
+};
+
+struct CullConfig
+{
+    CullFace face = CullFace::NONE;
+    bool frontCCW = true;           // front faces wind counter-clockwise on screen (y up)
+    bool frustum = true;            // drop triangles entirely outside the viewport or beyond the far plane
+    bool small = true;              // drop zero-area triangles and, without multisampling, those missing every pixel center
+};
+
+// Keyframes of an animation. Frames between two keys interpolate them, linearly for positions and
+//  spherically for rotations; frames before the first or after the last key hold that key.
+struct CameraKey
+{
+    uint32_t frame;
+    glm::vec3 pos;
+    glm::vec3 lookAt;
+    glm::vec3 up;
+};
+
+struct TransformKey
+{
+    uint32_t frame;
+    MeshTransform transform;
 };
 
 std::string ToStr(glm::vec4 vec);
@@ -40,6 +104,8 @@ public:
 
     bool Load();
 
+    // Move the camera and the transforms to `frame` of the animation; does nothing without one
+    void SetFrame(uint32_t frame);
 
     inline std::string Info() const
     {
@@ -60,6 +126,47 @@ public:
             AAStr = "none";
         else if (this->AAConfig == AntiAliasConfig::SSAA)
             AAStr = "SSAA";
+        else if (this->AAConfig == AntiAliasConfig::MSAA)
+            AAStr = "MSAA";
+
+        std::string simdStr = "auto";
+        if (this->simdLevel == SimdLevel::SCALAR)
+            simdStr = "scalar";
+        else if (this->simdLevel == SimdLevel::SSE)
+            simdStr = "SSE";
+        else if (this->simdLevel == SimdLevel::AVX2)
+            simdStr = "AVX2";
+
+        std::string orderStr = "none";
+        if (this->meshOrder == MeshOrder::CACHE)
+            orderStr = "cache";
+        else if (this->meshOrder == MeshOrder::MORTON)
+            orderStr = "morton";
+
+        std::string cullStr = "none";
+        if (this->cullConfig.face == CullFace::BACK)
+            cullStr = "back";
+        else if (this->cullConfig.face == CullFace::FRONT)
+            cullStr = "front";
+        if (this->cullConfig.face != CullFace::NONE)
+            cullStr += this->cullConfig.frontCCW ? " (front ccw)" : " (front cw)";
+        if (this->cullConfig.frustum)
+            cullStr += ", frustum";
+        if (this->cullConfig.small)
+            cullStr += ", small";
+
+        std::string formatStr = ".png (level " + ToStr(this->pngLevel) + ")";
+        if (this->outputFormat == OutputFormat::QOI)
+            formatStr = ".qoi";
+        else if (this->outputFormat == OutputFormat::PPM)
+            formatStr = ".ppm";
+        else if (this->outputFormat == OutputFormat::RAW)
+            formatStr = ".rgba";
+
+        std::string animationStr = "";
+        if (this->frames > 1)
+            animationStr = "Animation: " + ToStr(this->frames) + " frames, " + ToStr(this->cameraTrack.size()) +
+                " camera keys, " + ToStr(this->transformTracks.size()) + " transform tracks\n";
 
         std::string transformStr = "<no transform needed>\n";
         if (this->type != TestType::TRIANGLE)
@@ -76,7 +183,7 @@ public:
                     transformStr += "|   scale: " + ToStr(transform.scale) + "\n";
                 }
             }
-            if (this->transforms.size() != this->shapes.size())
+            if (this->transforms.size() != this->mesh.GetShapes().size())
                 transformStr += "[WARNING] number of transforms does not match number of shapes\n";
         }
 
@@ -84,6 +191,10 @@ public:
         if (this->type == TestType::SHADING)
         {
             lightStr = "";
+            lightStr += std::string("Shading Mode: ") + (this->shadingMode == ShadingMode::FORWARD ? "forward" : "visibility") + "\n";
+            lightStr += std::string("Tone Mapping: ") + (this->toneMapping == ToneMapping::REINHARD ? "reinhard" :
+                (this->toneMapping == ToneMapping::ACES ? "aces" : "none")) + (this->dither ? ", dithered" : "") + "\n";
+            lightStr += "Light Cutoff: " + ((this->lightCutoff > 0) ? ToStr(this->lightCutoff) : std::string("off")) + "\n";
             lightStr += "Specular Exponent: " + ToStr(this->specularExponent) + "\n";
             lightStr += "Ambient Color: " + ToStr(this->ambientColor) + "\n";
             if (this->lights.empty())
@@ -103,18 +214,35 @@ public:
         return "Type: " + typeStr + "\n" +
             "Anti-alias: " + AAStr + ((this->AAConfig == AntiAliasConfig::NONE) ? "" : " with spp " + ToStr(this->AASpp)) + "\n" +
             "Resolution: " + ToStr(this->width) + "x" + ToStr(this->height) + "\n" +
-            "Model: " + this->modelName + "\n" +
-            "Output: " + this->outputName + "\n" + 
+            "SIMD: " + simdStr + "\n" +
+            "Culling: " + cullStr + "\n" +
+            "Model: " + this->modelName + (this->meshCache ? " (mesh cache on)" : "") + "\n" +
+            "Mesh Order: " + orderStr + "\n" +
+            "LOD: " + ((this->lodThreshold > 0) ? "within " + ToStr(this->lodThreshold) + " pixels" : std::string("off")) + "\n" +
+            "Output: " + this->outputName + formatStr +
+                ((this->stripHeight == 0) ? "" : ", in strips of " + ToStr(this->stripHeight) + " rows") + "\n" +
             ((camera.width == 0) ? "<no camera specified>" : (this->camera.Info())) + "\n" +
-            transformStr + lightStr;
+            animationStr + transformStr + lightStr;
     }
 
     inline const TestType GetType() const { return this->type; }
     inline const AntiAliasConfig GetAntiAliasConfig() const { return this->AAConfig; }
     inline const uint32_t GetSpp() const { return this->AASpp; }
+    inline const SimdLevel GetSimdLevel() const { return this->simdLevel; }
+    inline const ShadingMode GetShadingMode() const { return this->shadingMode; }
+    inline const CullConfig& GetCullConfig() const { return this->cullConfig; }
     inline const uint32_t GetWidth() const { return this->width; }
     inline const uint32_t GetHeight() const { return this->height; }
     inline const std::string GetOutputName() const { return this->outputName; }
+    inline const OutputFormat GetOutputFormat() const { return this->outputFormat; }
+    inline const uint32_t GetPngLevel() const { return this->pngLevel; }
+    inline const uint32_t GetStripHeight() const { return this->stripHeight; }
+    inline const uint32_t GetFrameCount() const { return this->frames; }
+    inline const MeshOrder GetMeshOrder() const { return this->meshOrder; }
+    inline const float GetLodThreshold() const { return this->lodThreshold; }
+
+    // Name of the output of `frame`: the configured name, followed by the frame number for animations
+    std::string GetOutputName(uint32_t frame) const;
 
     inline const glm::vec3 GetTestInput() const 
     {
@@ -132,12 +260,14 @@ public:
     }
 
     inline const Camera& GetCamera() const { return this->camera; }
-    inline const std::vector<tinyobj::shape_t>& GetShapes() const { return this->shapes; }
+    inline const Mesh& GetMesh() const { return this->mesh; }
     inline const std::vector<MeshTransform>& GetTransforms() const { return this->transforms; }
     inline const std::vector<Light>& GetLights() const { return this->lights; }
     inline const float GetSpecularExponent() const { return this->specularExponent; }
     inline const Color GetAmbientColor() const { return this->ambientColor; }
-    inline const tinyobj::attrib_t& GetAttribs() const { return this->attribs; }
+    inline const float GetLightCutoff() const { return this->lightCutoff; }
+    inline const ToneMapping GetToneMapping() const { return this->toneMapping; }
+    inline const bool GetDither() const { return this->dither; }
 
 private:
     // configs
@@ -148,21 +278,37 @@ private:
     uint32_t height;
     std::string modelName;
     std::string outputName;
+    OutputFormat outputFormat = OutputFormat::PNG;
+    uint32_t pngLevel = 6;          // 0 stores, 9 compresses the most
+    uint32_t stripHeight = 0;       // rows rendered and written at a time; 0 renders the whole frame at once
     AntiAliasConfig AAConfig = AntiAliasConfig::NONE;
     uint32_t AASpp = 0;
+    SimdLevel simdLevel = SimdLevel::AUTO;
+    CullConfig cullConfig;
 
     std::optional<glm::vec3> expected;
     std::optional<glm::vec3> input;
 
     Camera camera;
 
-    tinyobj::attrib_t attribs;
-    std::vector<tinyobj::shape_t> shapes;
+    Mesh mesh;
+    bool meshCache = false;         // map the triangulated model from its binary cache, and write the cache when stale
+    MeshOrder meshOrder = MeshOrder::NONE;  // reordering changes which of two equal depths wins, so it is opt-in
+    float lodThreshold = 0.f;       // largest simplification error shown, in pixels; 0 draws full detail only
     std::vector<MeshTransform> transforms;
 
     std::vector<Light> lights;
     float specularExponent;
     Color ambientColor;
+    ShadingMode shadingMode = ShadingMode::FORWARD;
+    float lightCutoff = 0.f;        // most light culling may drop per pixel, in 8-bit color levels; 0 shades every pixel with every light
+    ToneMapping toneMapping = ToneMapping::NONE;
+    bool dither = false;
+
+    // animation: frames rendered, and keys of the camera and of each transform, in frame order
+    uint32_t frames = 1;
+    std::vector<CameraKey> cameraTrack;
+    std::vector<std::vector<TransformKey>> transformTracks;
 
     // helpers
     bool LoadYaml();
@@ -0,0 +1,463 @@
+#include "lod.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+// The simplification stops once a shape is down to this many triangles
+static constexpr size_t LodTargetFaces = 256;
+
+// Weight of the planes that hold open borders in place, relative to the faces along them
+static constexpr double LodBorderWeight = 10.0;
+
+// A collapse is refused if it turns a remaining triangle by more than about 80 degrees
+static constexpr double LodMinTurnCosine = 0.2;
+
+// Sum of squared distances to weighted planes, as the symmetric 4x4 matrix of Garland and Heckbert,
+//  with the total weight of those planes
+struct LodQuadric
+{
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double weight = 0;
+};
+
+static void AddPlane(LodQuadric& q, const glm::dvec3& n, double d, double w)
+{
+    q.a00 += w * n.x * n.x; q.a01 += w * n.x * n.y; q.a02 += w * n.x * n.z; q.a03 += w * n.x * d;
+    q.a11 += w * n.y * n.y; q.a12 += w * n.y * n.z; q.a13 += w * n.y * d;
+    q.a22 += w * n.z * n.z; q.a23 += w * n.z * d;
+    q.a33 += w * d * d;
+    q.weight += w;
+}
+
+static LodQuadric Sum(const LodQuadric& a, const LodQuadric& b)
+{
+    LodQuadric q;
+    q.a00 = a.a00 + b.a00; q.a01 = a.a01 + b.a01; q.a02 = a.a02 + b.a02; q.a03 = a.a03 + b.a03;
+    q.a11 = a.a11 + b.a11; q.a12 = a.a12 + b.a12; q.a13 = a.a13 + b.a13;
+    q.a22 = a.a22 + b.a22; q.a23 = a.a23 + b.a23;
+    q.a33 = a.a33 + b.a33;
+    q.weight = a.weight + b.weight;
+    return q;
+}
+
+// Weighted mean of the squared distances from p to the planes of q
+static double Evaluate(const LodQuadric& q, const glm::dvec3& p)
+{
+    if (q.weight <= 0)
+        return 0;
+    double e = q.a00 * p.x * p.x + q.a11 * p.y * p.y + q.a22 * p.z * p.z + q.a33
+        + 2 * (q.a01 * p.x * p.y + q.a02 * p.x * p.z + q.a12 * p.y * p.z)
+        + 2 * (q.a03 * p.x + q.a13 * p.y + q.a23 * p.z);
+    return std::max(e, 0.0) / q.weight;
+}
+
+// A triangle of the shape being simplified: local position indices and the normal index of each corner
+struct LodFace
+{
+    uint32_t v[3];
+    int32_t n[3];
+
+    inline bool Has(uint32_t vertex) const { return v[0] == vertex || v[1] == vertex || v[2] == vertex; }
+};
+
+// Moving `from` onto `to`; the versions are those of both vertices when the cost was computed
+struct LodCollapse
+{
+    double cost;
+    uint32_t from, to;
+    uint32_t fromVersion, toVersion;
+
+    inline bool operator> (const LodCollapse& other) const { return cost > other.cost; }
+};
+
+// Edge collapses over the faces of one shape
+class LodSimplifier
+{
+public:
+    LodSimplifier(std::vector<glm::dvec3>&& positions, std::vector<LodFace>&& faces);
+
+    // Collapse edges until at most `target` faces are left or no collapse is allowed; false in the latter case
+    bool Reduce(size_t target);
+
+    inline size_t GetFaceCount() const { return this->live; }
+    // Square root of the largest collapse cost so far, a distance in model units
+    inline float GetError() const { return static_cast<float>(std::sqrt(this->error)); }
+
+    // Append the corners of the remaining faces, with positions numbered as in `ids`
+    void Emit(const std::vector<int32_t>& ids, std::vector<MeshIndex>& indices) const;
+
+private:
+    void Consider(uint32_t a, uint32_t b);
+    void Neighbors(uint32_t vertex, std::vector<uint32_t>& out) const;
+    bool CanCollapse(uint32_t from, uint32_t to);
+    void Collapse(uint32_t from, uint32_t to);
+
+    std::vector<glm::dvec3> positions;
+    std::vector<LodFace> faces;
+    std::vector<uint8_t> alive;                     // per face
+    std::vector<std::vector<uint32_t>> adjacent;    // per vertex: faces that use it, dead ones included until compacted
+    std::vector<LodQuadric> quadrics;
+    std::vector<uint32_t> versions;                 // per vertex, bumped whenever its quadric changes
+    std::vector<uint8_t> removed;
+    std::priority_queue<LodCollapse, std::vector<LodCollapse>, std::greater<LodCollapse>> heap;
+    size_t live = 0;
+    double error = 0;
+
+    std::vector<uint32_t> fromNeighbors, toNeighbors;
+    std::vector<std::pair<int32_t, int32_t>> normalPairs;
+};
+
+LodSimplifier::LodSimplifier(std::vector<glm::dvec3>&& positions, std::vector<LodFace>&& faces)
+    : positions(std::move(positions)), faces(std::move(faces))
+{
+    const size_t vertexCount = this->positions.size();
+    const size_t faceCount = this->faces.size();
+    this->alive.assign(faceCount, 1);
+    this->adjacent.resize(vertexCount);
+    this->quadrics.resize(vertexCount);
+    this->versions.assign(vertexCount, 0);
+    this->removed.assign(vertexCount, 0);
+    this->live = faceCount;
+
+    // Every face adds its plane to its corners, weighted by its area
+    std::vector<glm::dvec3> normals(faceCount);
+    for (uint32_t f = 0; f < faceCount; ++f)
+    {
+        const LodFace& face = this->faces[f];
+        for (uint32_t k = 0; k < 3; ++k)
+            this->adjacent[face.v[k]].push_back(f);
+
+        const glm::dvec3& p0 = this->positions[face.v[0]];
+        glm::dvec3 n = glm::cross(this->positions[face.v[1]] - p0, this->positions[face.v[2]] - p0);
+        double length = glm::length(n);
+        if (length == 0)
+            continue;
+        normals[f] = n / length;
+        for (uint32_t k = 0; k < 3; ++k)
+            AddPlane(this->quadrics[face.v[k]], normals[f], -glm::dot(normals[f], p0), 0.5 * length);
+    }
+
+    // Edges sorted by their endpoints: those used by a single face are borders, held by a plane through
+    //  them and perpendicular to the face
+    std::vector<std::pair<uint64_t, uint32_t>> edges;
+    edges.reserve(faceCount * 3);
+    for (uint32_t f = 0; f < faceCount; ++f)
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            uint64_t a = this->faces[f].v[k], b = this->faces[f].v[(k + 1) % 3];
+            edges.emplace_back((std::min(a, b) << 32) | std::max(a, b), f);
+        }
+    std::sort(edges.begin(), edges.end());
+
+    for (size_t i = 0; i < edges.size(); )
+    {
+        size_t j = i + 1;
+        while (j < edges.size() && edges[j].first == edges[i].first)
+            ++j;
+
+        const uint32_t a = static_cast<uint32_t>(edges[i].first >> 32);
+        const uint32_t b = static_cast<uint32_t>(edges[i].first & UINT32_MAX);
+        if (j - i == 1)
+        {
+            glm::dvec3 edge = this->positions[b] - this->positions[a];
+            glm::dvec3 n = glm::cross(edge, normals[edges[i].second]);
+            double length = glm::length(n);
+            if (length > 0)
+            {
+                n /= length;
+                double d = -glm::dot(n, this->positions[a]);
+                AddPlane(this->quadrics[a], n, d, LodBorderWeight * glm::dot(edge, edge));
+                AddPlane(this->quadrics[b], n, d, LodBorderWeight * glm::dot(edge, edge));
+            }
+        }
+        i = j;
+    }
+
+    for (size_t i = 0; i < edges.size(); ++i)
+        if (i == 0 || edges[i].first != edges[i - 1].first)
+            Consider(static_cast<uint32_t>(edges[i].first >> 32), static_cast<uint32_t>(edges[i].first & UINT32_MAX));
+}
+
+void LodSimplifier::Consider(uint32_t a, uint32_t b)
+{
+    // the merged vertex stays at whichever endpoint moves the surface least
+    LodQuadric q = Sum(this->quadrics[a], this->quadrics[b]);
+    double costA = Evaluate(q, this->positions[a]);
+    double costB = Evaluate(q, this->positions[b]);
+    if (costA <= costB)
+        this->heap.push({ costA, b, a, this->versions[b], this->versions[a] });
+    else
+        this->heap.push({ costB, a, b, this->versions[a], this->versions[b] });
+}
+
+void LodSimplifier::Neighbors(uint32_t vertex, std::vector<uint32_t>& out) const
+{
+    out.clear();
+    for (uint32_t f : this->adjacent[vertex])
+        if (this->alive[f])
+            for (uint32_t k = 0; k < 3; ++k)
+                if (this->faces[f].v[k] != vertex)
+                    out.push_back(this->faces[f].v[k]);
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+bool LodSimplifier::CanCollapse(uint32_t from, uint32_t to)
+{
+    // The vertices next to both endpoints must be exactly the far corners of the faces on the edge;
+    //  otherwise the collapse would pinch the surface into a non-manifold edge
+    size_t edgeFaces = 0;
+    for (uint32_t f : this->adjacent[from])
+        if (this->alive[f] && this->faces[f].Has(to))
+            ++edgeFaces;
+    if (edgeFaces == 0)
+        return false;
+
+    Neighbors(from, this->fromNeighbors);
+    Neighbors(to, this->toNeighbors);
+    size_t common = 0;
+    for (size_t i = 0, j = 0; i < this->fromNeighbors.size() && j < this->toNeighbors.size(); )
+    {
+        if (this->fromNeighbors[i] < this->toNeighbors[j])
+            ++i;
+        else if (this->fromNeighbors[i] > this->toNeighbors[j])
+            ++j;
+        else
+        {
+            ++common;
+            ++i;
+            ++j;
+        }
+    }
+    if (common != edgeFaces)
+        return false;
+
+    // No face that survives may flip over or collapse to a line
+    for (uint32_t f : this->adjacent[from])
+    {
+        if (!this->alive[f] || this->faces[f].Has(to))
+            continue;
+        const LodFace& face = this->faces[f];
+        glm::dvec3 p[3], q[3];
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            p[k] = this->positions[face.v[k]];
+            q[k] = (face.v[k] == from) ? this->positions[to] : p[k];
+        }
+        glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::dvec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+        double lengths = glm::length(before) * glm::length(after);
+        if (lengths == 0 && glm::length(before) > 0)
+            return false;
+        if (glm::dot(before, after) < LodMinTurnCosine * lengths)
+            return false;
+    }
+    return true;
+}
+
+void LodSimplifier::Collapse(uint32_t from, uint32_t to)
+{
+    // The faces on the edge disappear; each pairs the normal of `from` on its side of any seam with the
+    //  normal of `to` there, which the corners moved onto `to` take with them
+    this->normalPairs.clear();
+    for (uint32_t f : this->adjacent[from])
+    {
+        if (!this->alive[f] || !this->faces[f].Has(to))
+            continue;
+        const LodFace& face = this->faces[f];
+        int32_t fromNormal = -1, toNormal = -1;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            if (face.v[k] == from)
+                fromNormal = face.n[k];
+            else if (face.v[k] == to)
+                toNormal = face.n[k];
+        }
+        this->normalPairs.emplace_back(fromNormal, toNormal);
+        this->alive[f] = 0;
+        --this->live;
+    }
+
+    for (uint32_t f : this->adjacent[from])
+    {
+        if (!this->alive[f])
+            continue;
+        LodFace& face = this->faces[f];
+        for (uint32_t k = 0; k < 3; ++k)
+            if (face.v[k] == from)
+            {
+                face.v[k] = to;
+                for (const auto& pair : this->normalPairs)
+                    if (pair.first == face.n[k])
+                    {
+                        face.n[k] = pair.second;
+                        break;
+                    }
+            }
+        this->adjacent[to].push_back(f);
+    }
+    std::vector<uint32_t>().swap(this->adjacent[from]);
+    this->removed[from] = 1;
+
+    std::vector<uint32_t>& faces = this->adjacent[to];
+    faces.erase(std::remove_if(faces.begin(), faces.end(), [&](uint32_t f) { return !this->alive[f]; }), faces.end());
+
+    this->quadrics[to] = Sum(this->quadrics[to], this->quadrics[from]);
+    ++this->versions[to];
+
+    Neighbors(to, this->toNeighbors);
+    for (uint32_t n : this->toNeighbors)
+        Consider(to, n);
+}
+
+bool LodSimplifier::Reduce(size_t target)
+{
+    while (this->live > target)
+    {
+        if (this->heap.empty())
+            return false;
+        LodCollapse c = this->heap.top();
+        this->heap.pop();
+
+        // entries left behind by earlier collapses
+        if (this->removed[c.from] || this->removed[c.to] ||
+            this->versions[c.from] != c.fromVersion || this->versions[c.to] != c.toVersion)
+            continue;
+        if (!CanCollapse(c.from, c.to))
+            continue;
+
+        Collapse(c.from, c.to);
+        this->error = std::max(this->error, c.cost);
+    }
+    return true;
+}
+
+void LodSimplifier::Emit(const std::vector<int32_t>& ids, std::vector<MeshIndex>& indices) const
+{
+    for (size_t f = 0; f < this->faces.size(); ++f)
+        if (this->alive[f])
+            for (uint32_t k = 0; k < 3; ++k)
+                indices.push_back({ ids[this->faces[f].v[k]], this->faces[f].n[k] });
+}
+
+LodChain BuildLodChain(const ArrayView<float>& vertices, const ArrayView<MeshIndex>& corners)
+{
+    LodChain chain;
+    const size_t faceCount = corners.size / 3;
+    if (faceCount < LodChain::MinFaces)
+        return chain;
+
+    // The positions the shape uses, numbered locally in ascending mesh order
+    std::vector<int32_t> ids(corners.size);
+    for (size_t i = 0; i < corners.size; ++i)
+        ids[i] = corners[i].vertex;
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    auto local = [&](int32_t vertex)
+    {
+        return static_cast<uint32_t>(std::lower_bound(ids.begin(), ids.end(), vertex) - ids.begin());
+    };
+
+    std::vector<glm::dvec3> positions(ids.size());
+    glm::dvec3 lo(std::numeric_limits<double>::max()), hi(std::numeric_limits<double>::lowest());
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        const float* p = vertices.data + static_cast<size_t>(ids[i]) * 3;
+        positions[i] = glm::dvec3(p[0], p[1], p[2]);
+        lo = glm::min(lo, positions[i]);
+        hi = glm::max(hi, positions[i]);
+    }
+
+    // Bounding sphere around the center of the box, for the renderer to project
+    glm::dvec3 center = 0.5 * (lo + hi);
+    double radius = 0;
+    for (const glm::dvec3& p : positions)
+        radius = std::max(radius, glm::length(p - center));
+    for (int k = 0; k < 3; ++k)
+        chain.center[k] = static_cast<float>(center[k]);
+    chain.radius = static_cast<float>(radius);
+
+    // Faces with a repeated corner cover nothing and are dropped from every level
+    std::vector<LodFace> faces;
+    faces.reserve(faceCount);
+    for (size_t f = 0; f < faceCount; ++f)
+    {
+        LodFace face;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            face.v[k] = local(corners[f * 3 + k].vertex);
+            face.n[k] = corners[f * 3 + k].normal;
+        }
+        if (face.v[0] != face.v[1] && face.v[1] != face.v[2] && face.v[2] != face.v[0])
+            faces.push_back(face);
+    }
+
+    // Each level halves the faces of the previous one; a level that could not go below three quarters of
+    //  the previous one is kept only if it is the last
+    LodSimplifier simplifier(std::move(positions), std::move(faces));
+    size_t previous = faceCount;
+    while (previous > LodTargetFaces)
+    {
+        bool reduced = simplifier.Reduce(std::max(previous / 2, LodTargetFaces));
+        size_t count = simplifier.GetFaceCount();
+        if (count * 4 > previous * 3)
+            break;
+
+        MeshLevel level;
+        level.first = chain.indices.size();
+        simplifier.Emit(ids, chain.indices);
+        level.count = chain.indices.size() - level.first;
+        level.error = simplifier.GetError();
+        chain.levels.push_back(level);
+
+        previous = count;
+        if (!reduced)
+            break;
+    }
+    return chain;
+}
+
+LodSelector::LodSelector(float threshold, bool perspective, float nearClip)
+    : threshold(threshold), sign(perspective ? -1.f : 1.f), nearClip(perspective ? nearClip : 0.f)
+{
+}
+
+ArrayView<MeshIndex> LodSelector::Select(const Mesh& mesh, const MeshShape& shape, const glm::mat4& modelToScreen) const
+{
+    if (this->threshold <= 0 || shape.levels.empty())
+        return mesh.GetIndices(shape);
+
+    // Rows of the matrix that give x, y and w, with w made the distance in front of the camera
+    const glm::mat4 m = modelToScreen * this->sign;
+    const glm::vec3 rowX(m[0][0], m[1][0], m[2][0]);
+    const glm::vec3 rowY(m[0][1], m[1][1], m[2][1]);
+    const glm::vec3 rowW(m[0][3], m[1][3], m[2][3]);
+    const glm::vec4 center = m * glm::vec4(shape.center[0], shape.center[1], shape.center[2], 1.f);
+
+    // The nearest point of the bounding sphere; a sphere reaching the near plane is drawn in full
+    const float w = center.w - glm::length(rowW) * shape.radius;
+    if (w <= this->nearClip || w <= 0.f)
+        return mesh.GetIndices(shape);
+
+    // Derivatives of the screen position x / w, y / w at the center, scaled to the nearest w, and the
+    //  largest length they give a unit model-space step: the pixels per model unit
+    const float px = center.x / center.w, py = center.y / center.w;
+    const glm::vec3 dx = (rowX - px * rowW) / w;
+    const glm::vec3 dy = (rowY - py * rowW) / w;
+    const float a = glm::dot(dx, dx), b = glm::dot(dx, dy), c = glm::dot(dy, dy);
+    const float scale = std::sqrt(0.5f * (a + c) + std::sqrt(0.25f * (a - c) * (a - c) + b * b));
+
+    // The coarsest level whose error stays below the threshold
+    for (size_t l = shape.levels.size(); l > 0; --l)
+        if (shape.levels[l - 1].error * scale <= this->threshold)
+            return mesh.GetIndices(shape.levels[l - 1]);
+    return mesh.GetIndices(shape);
+}
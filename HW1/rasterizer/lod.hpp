@@ -0,0 +1,57 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <vector>
+
+#include "entities.hpp"
+#include "mesh.hpp"
+
+// Levels of detail built by quadric error simplification (Garland and Heckbert). Edges are collapsed
+//  cheapest first, each onto one of its own endpoints, so every level is only a new index buffer over
+//  the positions and normals of the full mesh. Each level has about half the triangles of the previous
+//  one, down to a few hundred.
+
+// The levels of one shape: their corners, with MeshLevel::first counted from the start of `indices`
+struct LodChain
+{
+    // shapes with fewer triangles are drawn at full detail only
+    static constexpr size_t MinFaces = 512;
+
+    std::vector<MeshIndex> indices;
+    std::vector<MeshLevel> levels;
+    float center[3] = { 0.f, 0.f, 0.f };
+    float radius = 0.f;
+};
+
+/**
+ * Simplify one shape.
+ * @param vertices: xyz triples of positions of the whole mesh
+ * @param corners: the shape's triangles; the chain is empty if there are fewer than LodChain::MinFaces of them
+ */
+LodChain BuildLodChain(const ArrayView<float>& vertices, const ArrayView<MeshIndex>& corners);
+
+// Picks the level each shape is drawn at, from how large the simplification error of each level
+//  would appear on screen
+class LodSelector
+{
+public:
+    /**
+     * @param threshold: the largest error, in pixels, a level may show; 0 always draws full detail
+     * @param perspective: whether w is the negated view-space depth, as the clipper assumes
+     * @param nearClip: shapes whose bounding sphere reaches closer than this are drawn at full detail
+     */
+    LodSelector(float threshold, bool perspective, float nearClip);
+
+    /**
+     * The corners to draw `shape` with.
+     * @param modelToScreen: the shape's model matrix composed with the view, projection and screen space matrices
+     */
+    ArrayView<MeshIndex> Select(const Mesh& mesh, const MeshShape& shape, const glm::mat4& modelToScreen) const;
+
+private:
+    float threshold;
+    float sign;
+    float nearClip;
+};
+
+#endif
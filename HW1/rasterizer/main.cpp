@@ -17,5 +17,6 @@ int main(int argc, char** argv)
     {
         std::cerr << "Rendering process failed..." << std::endl; 
         std::cerr << e.what() << std::endl;
+        return 1;
     }
 }
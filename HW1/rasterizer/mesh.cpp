@@ -0,0 +1,128 @@
+#include "mesh.hpp"
+
+#include <utility>
+
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    this->Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator= (MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->Close();
+        this->data = std::exchange(other.data, nullptr);
+        this->size = std::exchange(other.size, 0);
+#if defined(_WIN32)
+        this->contents = std::move(other.contents);
+#endif
+    }
+    return *this;
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const std::string& filename)
+{
+    this->Close();
+    std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+    if (!ifs)
+        return false;
+    this->contents.resize(static_cast<size_t>(ifs.tellg()));
+    ifs.seekg(0);
+    if (!ifs.read(reinterpret_cast<char*>(this->contents.data()), static_cast<std::streamsize>(this->contents.size())))
+    {
+        this->contents.clear();
+        return false;
+    }
+    this->data = this->contents.data();
+    this->size = this->contents.size();
+    return true;
+}
+
+void MappedFile::Close()
+{
+    this->contents = std::vector<uint8_t>();
+    this->data = nullptr;
+    this->size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& filename)
+{
+    this->Close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    void* mapped = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    this->data = static_cast<const uint8_t*>(mapped);
+    this->size = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (this->data != nullptr)
+        ::munmap(const_cast<uint8_t*>(this->data), this->size);
+    this->data = nullptr;
+    this->size = 0;
+}
+
+#endif
+
+void Mesh::Assign(std::vector<float>&& vertices, std::vector<float>&& normals, std::vector<MeshIndex>&& indices,
+    std::vector<MeshShape>&& shapes)
+{
+    this->file.Close();
+    this->vertexStorage = std::move(vertices);
+    this->normalStorage = std::move(normals);
+    this->indexStorage = std::move(indices);
+    this->shapes = std::move(shapes);
+
+    this->vertices = { this->vertexStorage.data(), this->vertexStorage.size() };
+    this->normals = { this->normalStorage.data(), this->normalStorage.size() };
+    this->indices = { this->indexStorage.data(), this->indexStorage.size() };
+}
+
+void Mesh::Assign(MappedFile&& file, ArrayView<float> vertices, ArrayView<float> normals, ArrayView<MeshIndex> indices,
+    std::vector<MeshShape>&& shapes)
+{
+    this->vertexStorage = std::vector<float>();
+    this->normalStorage = std::vector<float>();
+    this->indexStorage = std::vector<MeshIndex>();
+    this->file = std::move(file);
+    this->shapes = std::move(shapes);
+
+    this->vertices = vertices;
+    this->normals = normals;
+    this->indices = indices;
+}
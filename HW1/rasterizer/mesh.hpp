@@ -0,0 +1,123 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only view of `size` contiguous elements stored elsewhere
+template<typename T>
+struct ArrayView
+{
+    const T* data = nullptr;
+    size_t size = 0;
+
+    inline const T& operator[] (size_t index) const { return data[index]; }
+    inline const T* begin() const { return data; }
+    inline const T* end() const { return data + size; }
+};
+
+// One corner of a triangle: the index of its position and of its normal, -1 when it has no normal
+struct MeshIndex
+{
+    int32_t vertex;
+    int32_t normal;
+};
+
+// A simplified version of a shape, over the same positions and normals: the corners [first, first + count)
+//  of the mesh's index array, and how far the simplified surface strays from the full one, in model units
+struct MeshLevel
+{
+    size_t first = 0;
+    size_t count = 0;
+    float error = 0.f;
+
+    inline size_t GetFaceCount() const { return count / 3; }
+};
+
+// A named group of triangles, the corners [first, first + count) of the mesh's index array
+struct MeshShape
+{
+    std::string name;
+    size_t first = 0;
+    size_t count = 0;
+
+    // levels of detail, from the finest to the coarsest; empty for shapes that were not simplified
+    std::vector<MeshLevel> levels;
+    float center[3] = { 0.f, 0.f, 0.f };    // bounding sphere of the positions, set along with the levels
+    float radius = 0.f;
+
+    inline size_t GetFaceCount() const { return count / 3; }
+};
+
+// A file mapped read-only into memory, released when the object is destroyed
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator= (MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator= (const MappedFile&) = delete;
+
+    // Map the whole of `filename`, replacing the current mapping; false if it cannot be opened
+    bool Open(const std::string& filename);
+    void Close();
+
+    inline const uint8_t* Data() const { return this->data; }
+    inline size_t Size() const { return this->size; }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#if defined(_WIN32)
+    std::vector<uint8_t> contents;      // read in whole where mmap is not available
+#endif
+};
+
+// Triangulated geometry of a model: xyz triples of positions and normals shared by every shape, and
+//  three corners per triangle. The arrays are either owned by the mesh or point into a mapped cache
+//  file, which the mesh then keeps open; readers cannot tell the two apart.
+class Mesh
+{
+public:
+    Mesh() = default;
+    Mesh(Mesh&&) = default;
+    Mesh& operator= (Mesh&&) = default;
+
+    // Take over arrays built in memory, e.g. by the OBJ parser
+    void Assign(std::vector<float>&& vertices, std::vector<float>&& normals, std::vector<MeshIndex>&& indices,
+        std::vector<MeshShape>&& shapes);
+
+    // Use arrays lying inside `file`, without copying them
+    void Assign(MappedFile&& file, ArrayView<float> vertices, ArrayView<float> normals, ArrayView<MeshIndex> indices,
+        std::vector<MeshShape>&& shapes);
+
+    inline const ArrayView<float>& GetVertices() const { return this->vertices; }
+    inline const ArrayView<float>& GetNormals() const { return this->normals; }
+    inline const ArrayView<MeshIndex>& GetIndices() const { return this->indices; }
+    inline const std::vector<MeshShape>& GetShapes() const { return this->shapes; }
+
+    inline ArrayView<MeshIndex> GetIndices(const MeshShape& shape) const { return { this->indices.data + shape.first, shape.count }; }
+    inline ArrayView<MeshIndex> GetIndices(const MeshLevel& level) const { return { this->indices.data + level.first, level.count }; }
+    inline size_t GetVertexCount() const { return this->vertices.size / 3; }
+    inline size_t GetNormalCount() const { return this->normals.size / 3; }
+    inline bool IsMapped() const { return this->file.Data() != nullptr; }
+
+private:
+    ArrayView<float> vertices;
+    ArrayView<float> normals;
+    ArrayView<MeshIndex> indices;
+    std::vector<MeshShape> shapes;
+
+    // backing storage: owned arrays, or the mapped file
+    std::vector<float> vertexStorage;
+    std::vector<float> normalStorage;
+    std::vector<MeshIndex> indexStorage;
+    MappedFile file;
+};
+
+#endif
@@ -0,0 +1,256 @@
+#include "meshcache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+// Bumped whenever the layout below or the triangulation of the OBJ loader changes
+static constexpr uint32_t MeshCacheVersion = 4;
+static const char MeshCacheMagic[8] = { 'M', 'E', 'S', 'H', 'C', 'A', 'C', 'H' };
+
+// Arrays start on cache-line boundaries, which mmap's page-aligned base preserves
+static constexpr size_t MeshCacheAlignment = 64;
+
+// The file starts with this header, followed by the source path, the shape table, the level table, the
+//  shape names, then the vertex, normal and index arrays, each aligned to MeshCacheAlignment
+struct MeshCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t shapeCount;
+    uint64_t sourceSize;
+    int64_t sourceTime;             // modification time in the clock ticks of std::filesystem
+    uint64_t pathBytes;
+    uint64_t nameBytes;
+    uint64_t vertexCount;           // floats, three per position
+    uint64_t normalCount;           // floats, three per normal
+    uint64_t indexCount;            // corners, three per triangle
+    uint64_t levelCount;            // levels of detail of all shapes, in shape order
+    uint64_t levelsBuilt;           // 1 if the levels of detail were built, even if no shape got any
+    uint64_t order;                 // the MeshOrder of the triangles and vertices
+};
+
+struct MeshCacheShape
+{
+    uint64_t first;
+    uint64_t count;
+    uint64_t nameBytes;
+    uint64_t levelCount;
+    float center[3];
+    float radius;
+};
+
+struct MeshCacheLevel
+{
+    uint64_t first;
+    uint64_t count;
+    float error;
+    uint32_t padding;
+};
+
+// Byte offsets of every part of a cache file, from its header
+struct MeshCacheLayout
+{
+    size_t path, shapes, levels, names, vertices, normals, indices, end;
+
+    MeshCacheLayout(const MeshCacheHeader& header)
+    {
+        auto align = [](size_t offset) { return (offset + MeshCacheAlignment - 1) & ~(MeshCacheAlignment - 1); };
+        path = sizeof(MeshCacheHeader);
+        shapes = align(path + header.pathBytes);
+        levels = shapes + header.shapeCount * sizeof(MeshCacheShape);
+        names = levels + header.levelCount * sizeof(MeshCacheLevel);
+        vertices = align(names + header.nameBytes);
+        normals = align(vertices + header.vertexCount * sizeof(float));
+        indices = align(normals + header.normalCount * sizeof(float));
+        end = indices + header.indexCount * sizeof(MeshIndex);
+    }
+};
+
+// What identifies the source file: its canonical path, size and modification time
+struct MeshSource
+{
+    std::string path;
+    uint64_t size = 0;
+    int64_t time = 0;
+};
+
+static bool GetMeshSource(const std::string& objFilename, MeshSource& source)
+{
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::canonical(objFilename, error);
+    if (error)
+        return false;
+    source.path = path.string();
+    source.size = std::filesystem::file_size(path, error);
+    if (error)
+        return false;
+    source.time = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+    return !error;
+}
+
+std::string MeshCacheName(const std::string& objFilename)
+{
+    return objFilename + ".meshcache";
+}
+
+bool LoadMeshCache(const std::string& objFilename, Mesh& mesh, const MeshBuild& build)
+{
+    MeshSource source;
+    if (!GetMeshSource(objFilename, source))
+        return false;
+
+    MappedFile file;
+    if (!file.Open(MeshCacheName(objFilename)) || file.Size() < sizeof(MeshCacheHeader))
+        return false;
+
+    MeshCacheHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic)) != 0 || header.version != MeshCacheVersion)
+        return false;
+    if (header.sourceSize != source.size || header.sourceTime != source.time || header.pathBytes != source.path.size())
+        return false;
+    if ((build.levels && header.levelsBuilt == 0) || header.order != static_cast<uint64_t>(build.order))
+        return false;
+
+    // a truncated file would otherwise be read past its end
+    MeshCacheLayout layout(header);
+    if (layout.end > file.Size() || header.vertexCount % 3 != 0 || header.normalCount % 3 != 0)
+        return false;
+    if (std::memcmp(file.Data() + layout.path, source.path.data(), source.path.size()) != 0)
+        return false;
+
+    std::vector<MeshShape> shapes(header.shapeCount);
+    size_t nameOffset = layout.names;
+    uint64_t levelIndex = 0;
+    for (uint32_t s = 0; s < header.shapeCount; ++s)
+    {
+        MeshCacheShape entry;
+        std::memcpy(&entry, file.Data() + layout.shapes + s * sizeof(MeshCacheShape), sizeof(entry));
+        if (entry.first + entry.count > header.indexCount || nameOffset + entry.nameBytes > layout.names + header.nameBytes)
+            return false;
+        if (entry.levelCount > header.levelCount - levelIndex)
+            return false;
+        shapes[s].name.assign(reinterpret_cast<const char*>(file.Data() + nameOffset), entry.nameBytes);
+        shapes[s].first = entry.first;
+        shapes[s].count = entry.count;
+        std::memcpy(shapes[s].center, entry.center, sizeof(entry.center));
+        shapes[s].radius = entry.radius;
+        nameOffset += entry.nameBytes;
+
+        for (uint64_t l = 0; l < entry.levelCount; ++l, ++levelIndex)
+        {
+            MeshCacheLevel level;
+            std::memcpy(&level, file.Data() + layout.levels + levelIndex * sizeof(MeshCacheLevel), sizeof(level));
+            if (level.first + level.count > header.indexCount)
+                return false;
+            shapes[s].levels.push_back({ level.first, level.count, level.error });
+        }
+    }
+    if (levelIndex != header.levelCount)
+        return false;
+
+    ArrayView<float> vertices{ reinterpret_cast<const float*>(file.Data() + layout.vertices), header.vertexCount };
+    ArrayView<float> normals{ reinterpret_cast<const float*>(file.Data() + layout.normals), header.normalCount };
+    ArrayView<MeshIndex> indices{ reinterpret_cast<const MeshIndex*>(file.Data() + layout.indices), header.indexCount };
+
+    // every index must fall inside the arrays it refers to
+    const int64_t vertexLimit = static_cast<int64_t>(header.vertexCount / 3);
+    const int64_t normalLimit = static_cast<int64_t>(header.normalCount / 3);
+    for (const MeshIndex& index : indices)
+        if (index.vertex < 0 || index.vertex >= vertexLimit || index.normal < -1 || index.normal >= normalLimit)
+            return false;
+
+    mesh.Assign(std::move(file), vertices, normals, indices, std::move(shapes));
+    return true;
+}
+
+bool SaveMeshCache(const std::string& objFilename, const Mesh& mesh, const MeshBuild& build)
+{
+    MeshSource source;
+    if (!GetMeshSource(objFilename, source))
+        return false;
+
+    MeshCacheHeader header{};
+    std::memcpy(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic));
+    header.version = MeshCacheVersion;
+    header.shapeCount = static_cast<uint32_t>(mesh.GetShapes().size());
+    header.sourceSize = source.size;
+    header.sourceTime = source.time;
+    header.pathBytes = source.path.size();
+    for (const MeshShape& shape : mesh.GetShapes())
+    {
+        header.nameBytes += shape.name.size();
+        header.levelCount += shape.levels.size();
+    }
+    header.levelsBuilt = build.levels ? 1 : 0;
+    header.order = static_cast<uint64_t>(build.order);
+    header.vertexCount = mesh.GetVertices().size;
+    header.normalCount = mesh.GetNormals().size;
+    header.indexCount = mesh.GetIndices().size;
+    MeshCacheLayout layout(header);
+
+    // Written under a temporary name and renamed, so that readers never map a partial file
+    const std::string filename = MeshCacheName(objFilename);
+    const std::string temporary = filename + ".tmp";
+    {
+        std::ofstream ofs(temporary, std::ios::binary | std::ios::trunc);
+        if (!ofs)
+            return false;
+
+        size_t offset = 0;
+        auto write = [&](const void* data, size_t bytes)
+        {
+            ofs.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+            offset += bytes;
+        };
+        auto pad = [&](size_t to)
+        {
+            static const char zeros[MeshCacheAlignment] = {};
+            write(zeros, to - offset);
+        };
+
+        write(&header, sizeof(header));
+        write(source.path.data(), source.path.size());
+        pad(layout.shapes);
+        for (const MeshShape& shape : mesh.GetShapes())
+        {
+            MeshCacheShape entry{ shape.first, shape.count, shape.name.size(), shape.levels.size(),
+                { shape.center[0], shape.center[1], shape.center[2] }, shape.radius };
+            write(&entry, sizeof(entry));
+        }
+        for (const MeshShape& shape : mesh.GetShapes())
+            for (const MeshLevel& level : shape.levels)
+            {
+                MeshCacheLevel entry{ level.first, level.count, level.error, 0 };
+                write(&entry, sizeof(entry));
+            }
+        for (const MeshShape& shape : mesh.GetShapes())
+            write(shape.name.data(), shape.name.size());
+        pad(layout.vertices);
+        write(mesh.GetVertices().data, mesh.GetVertices().size * sizeof(float));
+        pad(layout.normals);
+        write(mesh.GetNormals().data, mesh.GetNormals().size * sizeof(float));
+        pad(layout.indices);
+        write(mesh.GetIndices().data, mesh.GetIndices().size * sizeof(MeshIndex));
+
+        if (!ofs.flush())
+        {
+            ofs.close();
+            std::error_code error;
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, filename, error);
+    if (error)
+    {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
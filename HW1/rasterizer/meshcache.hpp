@@ -0,0 +1,33 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <string>
+
+#include "loader.hpp"
+#include "mesh.hpp"
+
+// Binary cache of the triangulated mesh of an OBJ file, written next to it as `<obj>.meshcache`.
+//  The cache records the canonical path, size and modification time of the OBJ it was built from,
+//  and is ignored as soon as any of them changes. Levels of detail are stored along with the shapes,
+//  so the cache also keeps them from being simplified again on every load. Its arrays are stored aligned in the layout of
+//  Mesh, so a valid cache is mapped and used in place instead of being parsed.
+
+// Name of the cache file of `objFilename`
+std::string MeshCacheName(const std::string& objFilename);
+
+// What was done to a mesh after parsing. A cache only serves loads that would build the mesh the same
+//  way, except that levels of detail it holds may go unused.
+struct MeshBuild
+{
+    bool levels = false;                    // levels of detail were built
+    MeshOrder order = MeshOrder::NONE;      // how triangles and vertices were reordered
+};
+
+// Map the cache of `objFilename` into `mesh`; false if there is none, or it is stale or damaged, or was
+//  not built as `build` asks
+bool LoadMeshCache(const std::string& objFilename, Mesh& mesh, const MeshBuild& build);
+
+// Write the cache of `objFilename` from `mesh`, built as `build` says; false if it could not be written
+bool SaveMeshCache(const std::string& objFilename, const Mesh& mesh, const MeshBuild& build);
+
+#endif
@@ -0,0 +1,323 @@
+#include "meshorder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+// Entries of the cache modeled by the vertex cache order, as in Forsyth's linear-speed optimizer
+static constexpr uint32_t ForsythCacheSize = 32;
+// Valences up to this have a precomputed score
+static constexpr uint32_t ForsythMaxValence = 32;
+
+// Score of a vertex: high if it was used recently, and higher the fewer triangles still need it,
+//  so that finishing a vertex off is preferred to starting a new one
+static float ForsythScore(int32_t cachePosition, uint32_t remaining)
+{
+    if (remaining == 0)
+        return -1.f;
+
+    float score = 0.f;
+    if (cachePosition >= 0)
+    {
+        // the last triangle's vertices get a fixed score, so that strips are not favored
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.f - static_cast<float>(cachePosition - 3) / (ForsythCacheSize - 3), 1.5f);
+    }
+    return score + 2.f / std::sqrt(static_cast<float>(remaining));
+}
+
+// Positions the triangles of `corners` use, numbered locally from 0 in ascending mesh order
+static std::vector<uint32_t> LocalVertices(const MeshIndex* corners, size_t count, size_t& vertexCount)
+{
+    std::vector<int32_t> ids(count);
+    for (size_t i = 0; i < count; ++i)
+        ids[i] = corners[i].vertex;
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    std::vector<uint32_t> local(count);
+    for (size_t i = 0; i < count; ++i)
+        local[i] = static_cast<uint32_t>(std::lower_bound(ids.begin(), ids.end(), corners[i].vertex) - ids.begin());
+    vertexCount = ids.size();
+    return local;
+}
+
+// The triangle order of Forsyth's "Linear-speed vertex cache optimisation": greedily emit the triangle
+//  whose vertices score highest, rescoring only the vertices in the modeled cache after each one
+static std::vector<uint32_t> CacheOrder(const MeshIndex* corners, size_t faceCount)
+{
+    size_t vertexCount = 0;
+    const std::vector<uint32_t> local = LocalVertices(corners, faceCount * 3, vertexCount);
+
+    // Triangles of each vertex; the first `remaining` entries are those not emitted yet
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (uint32_t v : local)
+        ++offsets[v + 1];
+    for (size_t v = 0; v < vertexCount; ++v)
+        offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacent(local.size());
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < local.size(); ++i)
+        adjacent[offsets[local[i]] + remaining[local[i]]++] = static_cast<uint32_t>(i / 3);
+
+    float valenceScores[ForsythMaxValence + 1];
+    for (uint32_t r = 0; r <= ForsythMaxValence; ++r)
+        valenceScores[r] = ForsythScore(-1, r);
+    auto score = [&](int32_t cachePosition, uint32_t r)
+    {
+        return (cachePosition < 0 && r <= ForsythMaxValence) ? valenceScores[r] : ForsythScore(cachePosition, r);
+    };
+
+    std::vector<int32_t> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScores[v] = score(-1, remaining[v]);
+
+    std::vector<float> faceScores(faceCount);
+    for (size_t f = 0; f < faceCount; ++f)
+        faceScores[f] = vertexScores[local[f * 3]] + vertexScores[local[f * 3 + 1]] + vertexScores[local[f * 3 + 2]];
+    std::vector<uint8_t> emitted(faceCount, 0);
+
+    std::vector<uint32_t> order;
+    order.reserve(faceCount);
+    std::vector<uint32_t> cache, next;
+    cache.reserve(ForsythCacheSize + 3);
+    next.reserve(ForsythCacheSize + 3);
+
+    size_t best = std::max_element(faceScores.begin(), faceScores.end()) - faceScores.begin();
+    size_t scan = 0;
+    while (order.size() < faceCount)
+    {
+        // nothing in the cache leads anywhere: continue with the first triangle left in file order
+        if (best == SIZE_MAX)
+        {
+            while (emitted[scan])
+                ++scan;
+            best = scan;
+        }
+
+        order.push_back(static_cast<uint32_t>(best));
+        emitted[best] = 1;
+
+        // The triangle's vertices go to the front of the cache, the others move back
+        next.clear();
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            uint32_t v = local[best * 3 + k];
+            if (std::find(next.begin(), next.end(), v) == next.end())
+                next.push_back(v);
+
+            uint32_t* list = adjacent.data() + offsets[v];
+            uint32_t* end = list + remaining[v];
+            *std::find(list, end, static_cast<uint32_t>(best)) = *(end - 1);
+            --remaining[v];
+        }
+        const size_t fresh = next.size();
+        for (uint32_t v : cache)
+            if (std::find(next.begin(), next.begin() + fresh, v) == next.begin() + fresh)
+                next.push_back(v);
+
+        // Rescore the vertices of the cache, including those just pushed out of it, and pick the best
+        //  triangle among those they still belong to
+        float bestScore = -1.f;
+        best = SIZE_MAX;
+        for (size_t i = 0; i < next.size(); ++i)
+        {
+            uint32_t v = next[i];
+            cachePositions[v] = (i < ForsythCacheSize) ? static_cast<int32_t>(i) : -1;
+            float updated = score(cachePositions[v], remaining[v]);
+            float delta = updated - vertexScores[v];
+            vertexScores[v] = updated;
+            for (uint32_t j = offsets[v]; j < offsets[v] + remaining[v]; ++j)
+            {
+                uint32_t f = adjacent[j];
+                faceScores[f] += delta;
+                if (faceScores[f] > bestScore)
+                {
+                    bestScore = faceScores[f];
+                    best = f;
+                }
+            }
+        }
+        next.resize(std::min<size_t>(next.size(), ForsythCacheSize));
+        std::swap(cache, next);
+    }
+    return order;
+}
+
+// Spreads the low 10 bits of x three bits apart
+static uint32_t SpreadBits(uint32_t x)
+{
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+// Triangles sorted by the Morton code of their centroids in the bounding box of the shape
+static std::vector<uint32_t> MortonOrder(const MeshIndex* corners, size_t faceCount, const std::vector<float>& vertices)
+{
+    std::vector<float> centroids(faceCount * 3);
+    float lo[3], hi[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        lo[k] = std::numeric_limits<float>::max();
+        hi[k] = std::numeric_limits<float>::lowest();
+    }
+    for (size_t f = 0; f < faceCount; ++f)
+        for (int k = 0; k < 3; ++k)
+        {
+            float sum = 0.f;
+            for (int c = 0; c < 3; ++c)
+                sum += vertices[static_cast<size_t>(corners[f * 3 + c].vertex) * 3 + k];
+            centroids[f * 3 + k] = sum / 3.f;
+            lo[k] = std::min(lo[k], centroids[f * 3 + k]);
+            hi[k] = std::max(hi[k], centroids[f * 3 + k]);
+        }
+
+    // one scale for all axes keeps the cells cubic
+    float extent = std::max({ hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] });
+    float scale = (extent > 0.f) ? 1023.f / extent : 0.f;
+
+    std::vector<std::pair<uint32_t, uint32_t>> codes(faceCount);
+    for (size_t f = 0; f < faceCount; ++f)
+    {
+        uint32_t cell[3];
+        for (int k = 0; k < 3; ++k)
+            cell[k] = static_cast<uint32_t>((centroids[f * 3 + k] - lo[k]) * scale + 0.5f);
+        codes[f] = { SpreadBits(cell[0]) | (SpreadBits(cell[1]) << 1) | (SpreadBits(cell[2]) << 2), static_cast<uint32_t>(f) };
+    }
+    std::sort(codes.begin(), codes.end());
+
+    std::vector<uint32_t> order(faceCount);
+    for (size_t f = 0; f < faceCount; ++f)
+        order[f] = codes[f].second;
+    return order;
+}
+
+void OrderTriangles(std::vector<MeshIndex>& indices, size_t first, size_t count, const std::vector<float>& vertices,
+    MeshOrder order)
+{
+    const size_t faceCount = count / 3;
+    if (order == MeshOrder::NONE || faceCount < 2)
+        return;
+
+    const MeshIndex* corners = indices.data() + first;
+    std::vector<uint32_t> faces = (order == MeshOrder::CACHE) ? CacheOrder(corners, faceCount)
+        : MortonOrder(corners, faceCount, vertices);
+
+    std::vector<MeshIndex> reordered(faceCount * 3);
+    for (size_t f = 0; f < faceCount; ++f)
+        for (size_t k = 0; k < 3; ++k)
+            reordered[f * 3 + k] = corners[faces[f] * 3 + k];
+    std::copy(reordered.begin(), reordered.end(), indices.begin() + first);
+}
+
+// New numbers of the `count` entries of an attribute array, in first-use order, and the array permuted to match
+static std::vector<int32_t> Renumber(std::vector<float>& values, size_t count, const std::vector<MeshIndex>& indices,
+    int32_t MeshIndex::* member)
+{
+    std::vector<int32_t> numbers(count, -1);
+    int32_t used = 0;
+    for (const MeshIndex& index : indices)
+    {
+        int32_t i = index.*member;
+        if (i >= 0 && numbers[i] < 0)
+            numbers[i] = used++;
+    }
+    for (int32_t& number : numbers)
+        if (number < 0)
+            number = used++;
+
+    std::vector<float> permuted(values.size());
+    for (size_t i = 0; i < count; ++i)
+        std::copy_n(values.begin() + i * 3, 3, permuted.begin() + static_cast<size_t>(numbers[i]) * 3);
+    values.swap(permuted);
+    return numbers;
+}
+
+void OrderVertices(std::vector<float>& vertices, std::vector<float>& normals, std::vector<MeshIndex>& indices)
+{
+    std::vector<int32_t> vertexNumbers = Renumber(vertices, vertices.size() / 3, indices, &MeshIndex::vertex);
+    std::vector<int32_t> normalNumbers = Renumber(normals, normals.size() / 3, indices, &MeshIndex::normal);
+    for (MeshIndex& index : indices)
+    {
+        index.vertex = vertexNumbers[index.vertex];
+        if (index.normal >= 0)
+            index.normal = normalNumbers[index.normal];
+    }
+}
+
+// Models a FIFO cache of `size` entries over keys below `keyCount`: a key is cached as long as fewer
+//  than `size` misses happened since its own
+class FifoCache
+{
+public:
+    FifoCache(size_t keyCount, size_t size) : stamps(keyCount, 0), size(size) {}
+
+    inline bool Miss(size_t key)
+    {
+        if (stamps[key] != 0 && misses - stamps[key] < size)
+            return false;
+        if (stamps[key] == 0)
+            touched.push_back(key);
+        stamps[key] = ++misses;
+        return true;
+    }
+
+    // Empty the cache; only the keys cached since the last reset are cleared
+    inline void Reset()
+    {
+        for (size_t key : touched)
+            stamps[key] = 0;
+        touched.clear();
+        misses = 0;
+    }
+
+    inline size_t GetMisses() const { return misses; }
+
+private:
+    std::vector<size_t> stamps;     // 1 + the miss count before the key's last miss, 0 if never cached
+    std::vector<size_t> touched;    // keys with a nonzero stamp
+    size_t size;
+    size_t misses = 0;
+};
+
+MeshLocality AnalyzeLocality(const Mesh& mesh)
+{
+    MeshLocality locality;
+    const size_t positionBytes = 3 * sizeof(float);
+    const size_t lineBytes = 64;
+
+    size_t faces = 0, vertexMisses = 0, lineMisses = 0;
+    FifoCache vertexCache(mesh.GetVertexCount(), 16);
+    FifoCache lineCache(mesh.GetVertexCount() * positionBytes / lineBytes + 1, 32 * 1024 / lineBytes);
+    for (const MeshShape& shape : mesh.GetShapes())
+    {
+        // every shape starts cold, as the vertex cache of the renderer does
+        vertexCache.Reset();
+        lineCache.Reset();
+        for (const MeshIndex& index : mesh.GetIndices(shape))
+        {
+            const size_t vertex = static_cast<size_t>(index.vertex);
+            vertexCache.Miss(vertex);
+            lineCache.Miss(vertex * positionBytes / lineBytes);
+        }
+        faces += shape.GetFaceCount();
+        vertexMisses += vertexCache.GetMisses();
+        lineMisses += lineCache.GetMisses();
+    }
+
+    if (faces > 0)
+    {
+        locality.vertexMisses = static_cast<double>(vertexMisses) / faces;
+        locality.lineMisses = static_cast<double>(lineMisses) / faces;
+    }
+    return locality;
+}
@@ -0,0 +1,36 @@
+#ifndef MESHORDER_H
+#define MESHORDER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "loader.hpp"
+#include "mesh.hpp"
+
+// Load-time reordering of a mesh for locality. OBJ exporters leave faces and vertices in any order,
+//  so the vertex stage jumps around the position array and consecutive triangles land far apart on
+//  screen. Triangles are reordered within each shape, then positions and normals are renumbered in the
+//  order the triangles first use them, so the vertex stage reads both arrays front to back.
+
+/**
+ * Reorder the triangles [first, first + count) of `indices` in place; the corners of each triangle keep
+ * their order, and so their winding.
+ * @param vertices: xyz triples of positions, for the spatial order
+ */
+void OrderTriangles(std::vector<MeshIndex>& indices, size_t first, size_t count, const std::vector<float>& vertices,
+    MeshOrder order);
+
+// Renumber positions and normals by their first use in `indices`, which is rewritten to match.
+//  Unused positions and normals move to the end.
+void OrderVertices(std::vector<float>& vertices, std::vector<float>& normals, std::vector<MeshIndex>& indices);
+
+// How well the full-detail shapes of a mesh reuse what the vertex stage has just read
+struct MeshLocality
+{
+    double vertexMisses = 0;        // per triangle: misses of a 16-entry FIFO cache of vertices (ACMR)
+    double lineMisses = 0;          // per triangle: 64-byte lines of the position array missing a 32 KiB FIFO cache
+};
+
+MeshLocality AnalyzeLocality(const Mesh& mesh);
+
+#endif
@@ -0,0 +1,707 @@
+#include "objparser.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#include "mesh.hpp"
+#include "threadpool.hpp"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#define TINYOBJLOADER_USE_MAPBOX_EARCUT                 // use robust triangulation
+#define TINYOBJLOADER_DONOT_INCLUDE_MAPBOX_EARCUT
+#include "../thirdparty/mapbox/earcut.hpp"              // included as a separate header
+#include "../thirdparty/tinyobj/tiny_obj_loader.h"
+
+// Chunks are sized so that every thread gets a few of them, within these bounds
+static constexpr size_t MinChunkBytes = size_t(256) << 10;
+static constexpr size_t MaxChunkBytes = size_t(16) << 20;
+
+// A state change between faces, applying to the faces of its chunk parsed after it
+struct ObjCommand
+{
+    enum class Kind
+    {
+        OBJECT, GROUP, MATERIAL, LIBRARY, SMOOTHING
+    };
+
+    Kind kind;
+    size_t face;                // faces of the chunk before the command
+    size_t triangle = 0;        // triangles of the chunk before the command, set by TriangulateChunk
+    size_t line;
+    std::string value;          // object or group name, material name, or library list
+    unsigned int smoothing = 0;
+};
+
+// A face corner whose index was relative to the records before it, and is only known within its chunk yet
+struct RelativeIndex
+{
+    size_t corner;
+    size_t line;
+    int field;                  // 0 vertex, 1 normal, 2 texcoord
+};
+
+struct ObjMessage
+{
+    size_t line;                // line in the chunk, 0 when the message is not about a line
+    std::string text;
+};
+
+// One piece of the file, cut on line boundaries, and what was read from it
+struct ObjChunk
+{
+    const char* begin;
+    const char* end;
+    size_t lines = 0;
+    size_t firstLine = 0;       // lines of the file before the chunk
+
+    std::vector<float> vertices, normals, texcoords;
+    size_t vertexOffset = 0, normalOffset = 0, texcoordOffset = 0;      // records of the file before the chunk
+
+    // corners of every face, then the number of corners of each face
+    std::vector<tinyobj::index_t> corners;
+    std::vector<unsigned int> faceSizes;
+    std::vector<ObjCommand> commands;
+    std::vector<RelativeIndex> relative;
+
+    // three corners per triangle, in face order
+    std::vector<tinyobj::index_t> triangles;
+
+    std::vector<ObjMessage> warnings;
+    ObjMessage error{ 0, "" };
+};
+
+// Triangles [first, last) of a chunk, all belonging to one shape with one material and smoothing group
+struct ObjRun
+{
+    size_t chunk;
+    size_t first, last;
+    size_t shape;
+    size_t offset;              // triangles of the shape before the run
+    int material;
+    unsigned int smoothing;
+};
+
+static inline bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static inline const char* SkipSpace(const char* p, const char* end)
+{
+    while (p < end && IsSpace(*p))
+        ++p;
+    return p;
+}
+
+// End of the token starting at p: the next space, tab or carriage return
+static inline const char* TokenEnd(const char* p, const char* end)
+{
+    while (p < end && !IsSpace(*p) && *p != '\r')
+        ++p;
+    return p;
+}
+
+static inline float ParseReal(const char*& p, const char* end)
+{
+    p = SkipSpace(p, end);
+    const char* tokenEnd = TokenEnd(p, end);
+    const char* first = (p < tokenEnd && *p == '+') ? p + 1 : p;
+    float value = 0.f;
+#if defined(__cpp_lib_to_chars)
+    auto result = std::from_chars(first, tokenEnd, value);
+    if (result.ec != std::errc() || result.ptr != tokenEnd)
+        value = 0.f;
+#else
+    char buffer[64];
+    size_t length = std::min<size_t>(tokenEnd - first, sizeof(buffer) - 1);
+    std::memcpy(buffer, first, length);
+    buffer[length] = '\0';
+    char* parsed = nullptr;
+    value = std::strtof(buffer, &parsed);
+    if (parsed != buffer + length)
+        value = 0.f;
+#endif
+    p = tokenEnd;
+    return value;
+}
+
+// atoi: optional spaces and sign, then as many digits as there are; 0 without any
+static inline int ParseInt(const char* p, const char* end)
+{
+    while (p < end && (IsSpace(*p) || *p == '\r'))
+        ++p;
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-'))
+        negative = (*p++ == '-');
+    int value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        value = value * 10 + (*p - '0');
+    return negative ? -value : value;
+}
+
+// Skip to the next '/', space, tab or carriage return
+static inline const char* FieldEnd(const char* p, const char* end)
+{
+    while (p < end && *p != '/' && !IsSpace(*p) && *p != '\r')
+        ++p;
+    return p;
+}
+
+static inline std::string ParseString(const char*& p, const char* end)
+{
+    p = SkipSpace(p, end);
+    const char* tokenEnd = TokenEnd(p, end);
+    std::string value(p, tokenEnd);
+    p = tokenEnd;
+    return value;
+}
+
+// Turn a 1-based or negative OBJ index into a 0-based one, relative to `count` records of the chunk
+//  when negative; false if the index is invalid
+static inline bool FixIndex(ObjChunk& chunk, int index, size_t count, int field, bool allowZero, int& out)
+{
+    if (index > 0)
+    {
+        out = index - 1;
+        return true;
+    }
+    if (index == 0)
+    {
+        chunk.warnings.push_back({ chunk.lines, "A zero value index found (will have a value of -1 for normal and tex indices." });
+        out = -1;
+        return allowZero;
+    }
+    // resolved against the records before the chunk once their number is known
+    out = static_cast<int>(count) + index;
+    chunk.relative.push_back({ chunk.corners.size(), chunk.lines, field });
+    return true;
+}
+
+// v, v//vn, v/vt or v/vt/vn
+static bool ParseCorner(ObjChunk& chunk, const char*& p, const char* end, tinyobj::index_t& corner)
+{
+    corner.vertex_index = corner.normal_index = corner.texcoord_index = -1;
+    if (!FixIndex(chunk, ParseInt(p, end), chunk.vertices.size() / 3, 0, false, corner.vertex_index))
+        return false;
+    p = FieldEnd(p, end);
+    if (p == end || *p != '/')
+        return true;
+    ++p;
+
+    if (p < end && *p == '/')
+    {
+        ++p;
+        if (!FixIndex(chunk, ParseInt(p, end), chunk.normals.size() / 3, 1, true, corner.normal_index))
+            return false;
+        p = FieldEnd(p, end);
+        return true;
+    }
+
+    if (!FixIndex(chunk, ParseInt(p, end), chunk.texcoords.size() / 2, 2, true, corner.texcoord_index))
+        return false;
+    p = FieldEnd(p, end);
+    if (p == end || *p != '/')
+        return true;
+    ++p;
+
+    if (!FixIndex(chunk, ParseInt(p, end), chunk.normals.size() / 3, 1, true, corner.normal_index))
+        return false;
+    p = FieldEnd(p, end);
+    return true;
+}
+
+// Read one line, without its line break; false on a malformed face
+static bool ParseLine(ObjChunk& chunk, const char* p, const char* end)
+{
+    p = SkipSpace(p, end);
+    if (p == end || *p == '#')
+        return true;
+    const size_t length = static_cast<size_t>(end - p);
+
+    if (p[0] == 'v' && length > 1 && IsSpace(p[1]))
+    {
+        p += 2;
+        for (int i = 0; i < 3; ++i)
+            chunk.vertices.push_back(ParseReal(p, end));
+        return true;
+    }
+    if (p[0] == 'v' && length > 2 && p[1] == 'n' && IsSpace(p[2]))
+    {
+        p += 3;
+        for (int i = 0; i < 3; ++i)
+            chunk.normals.push_back(ParseReal(p, end));
+        return true;
+    }
+    if (p[0] == 'v' && length > 2 && p[1] == 't' && IsSpace(p[2]))
+    {
+        p += 3;
+        for (int i = 0; i < 2; ++i)
+            chunk.texcoords.push_back(ParseReal(p, end));
+        return true;
+    }
+
+    if (p[0] == 'f' && length > 1 && IsSpace(p[1]))
+    {
+        p = SkipSpace(p + 2, end);
+        size_t first = chunk.corners.size();
+        while (p < end)
+        {
+            tinyobj::index_t corner;
+            if (!ParseCorner(chunk, p, end, corner))
+            {
+                chunk.error = { chunk.lines, "Failed to parse `f' line (e.g. a zero value for vertex index "
+                    "or invalid relative vertex index)." };
+                return false;
+            }
+            chunk.corners.push_back(corner);
+            while (p < end && (IsSpace(*p) || *p == '\r'))
+                ++p;
+        }
+        chunk.faceSizes.push_back(static_cast<unsigned int>(chunk.corners.size() - first));
+        return true;
+    }
+
+    ObjCommand command{ ObjCommand::Kind::OBJECT, chunk.faceSizes.size(), 0, chunk.lines, "" };
+    if (length >= 6 && std::strncmp(p, "usemtl", 6) == 0)
+    {
+        p += 6;
+        command.kind = ObjCommand::Kind::MATERIAL;
+        command.value = ParseString(p, end);
+    }
+    else if (length > 6 && std::strncmp(p, "mtllib", 6) == 0 && IsSpace(p[6]))
+    {
+        command.kind = ObjCommand::Kind::LIBRARY;
+        command.value.assign(p + 7, end);
+    }
+    else if (p[0] == 'g' && length > 1 && IsSpace(p[1]))
+    {
+        // the names after `g`, joined by single spaces
+        command.kind = ObjCommand::Kind::GROUP;
+        ParseString(p, end);
+        while (true)
+        {
+            while (p < end && (IsSpace(*p) || *p == '\r'))
+                ++p;
+            if (p == end)
+                break;
+            if (!command.value.empty())
+                command.value += ' ';
+            command.value += ParseString(p, end);
+        }
+    }
+    else if (p[0] == 'o' && length > 1 && IsSpace(p[1]))
+    {
+        command.kind = ObjCommand::Kind::OBJECT;
+        command.value.assign(p + 2, end);
+    }
+    else if (p[0] == 's' && length > 1 && IsSpace(p[1]))
+    {
+        p = SkipSpace(p + 2, end);
+        if (p == end || *p == '\r')
+            return true;
+        command.kind = ObjCommand::Kind::SMOOTHING;
+        if (end - p >= 3 && std::strncmp(p, "off", 3) == 0)
+            command.smoothing = 0;
+        else
+            command.smoothing = static_cast<unsigned int>(std::max(0, ParseInt(p, end)));
+    }
+    else
+        return true;        // records the renderers do not use
+
+    chunk.commands.push_back(std::move(command));
+    return true;
+}
+
+static void ParseChunk(ObjChunk& chunk)
+{
+    const char* p = chunk.begin;
+    while (p < chunk.end)
+    {
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(chunk.end - p)));
+        if (lineEnd == nullptr)
+            lineEnd = chunk.end;
+        const char* end = (lineEnd > p && lineEnd[-1] == '\r') ? lineEnd - 1 : lineEnd;
+
+        ++chunk.lines;
+        if (!ParseLine(chunk, p, end))
+            return;
+        p = (lineEnd < chunk.end) ? lineEnd + 1 : chunk.end;
+    }
+}
+
+// The arithmetic of tinyobj's polygon triangulation, reproduced so that both split polygons identically
+struct PolygonPoint
+{
+    float x, y, z;
+};
+
+static inline PolygonPoint Cross(const PolygonPoint& a, const PolygonPoint& b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static inline float Dot(const PolygonPoint& a, const PolygonPoint& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static inline float Length(const PolygonPoint& a)
+{
+    return std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+}
+
+static inline PolygonPoint Normalize(const PolygonPoint& a)
+{
+    float inverse = 1.f / Length(a);
+    return { a.x * inverse, a.y * inverse, a.z * inverse };
+}
+
+static inline bool IsValidVertex(const tinyobj::index_t& corner, const std::vector<float>& vertices)
+{
+    return corner.vertex_index >= 0 && 3 * static_cast<size_t>(corner.vertex_index) + 2 < vertices.size();
+}
+
+// Split the faces of a chunk into triangles: quads along their shorter diagonal, larger polygons by
+//  ear clipping in the plane of their Newell normal
+static void TriangulateChunk(ObjChunk& chunk, const std::vector<float>& vertices)
+{
+    chunk.triangles.reserve(chunk.corners.size());
+    auto point = [&](const tinyobj::index_t& corner)
+    {
+        const float* v = &vertices[3 * static_cast<size_t>(corner.vertex_index)];
+        return PolygonPoint{ v[0], v[1], v[2] };
+    };
+
+    size_t command = 0;
+    size_t corner = 0;
+    for (size_t f = 0; f < chunk.faceSizes.size(); ++f)
+    {
+        while (command < chunk.commands.size() && chunk.commands[command].face == f)
+            chunk.commands[command++].triangle = chunk.triangles.size() / 3;
+
+        const tinyobj::index_t* face = &chunk.corners[corner];
+        const size_t count = chunk.faceSizes[f];
+        corner += count;
+
+        if (count < 3)
+        {
+            chunk.warnings.push_back({ 0, "Degenerated face found." });
+            continue;
+        }
+        if (count == 3)
+        {
+            chunk.triangles.insert(chunk.triangles.end(), face, face + 3);
+            continue;
+        }
+        if (!std::all_of(face, face + count, [&](const tinyobj::index_t& c) { return IsValidVertex(c, vertices); }))
+        {
+            chunk.warnings.push_back({ 0, "Face with invalid vertex index found." });
+            continue;
+        }
+
+        if (count == 4)
+        {
+            PolygonPoint v0 = point(face[0]), v1 = point(face[1]), v2 = point(face[2]), v3 = point(face[3]);
+            PolygonPoint e02{ v2.x - v0.x, v2.y - v0.y, v2.z - v0.z };
+            PolygonPoint e13{ v3.x - v1.x, v3.y - v1.y, v3.z - v1.z };
+            if (Dot(e02, e02) < Dot(e13, e13))
+                chunk.triangles.insert(chunk.triangles.end(), { face[0], face[1], face[2], face[0], face[2], face[3] });
+            else
+                chunk.triangles.insert(chunk.triangles.end(), { face[0], face[1], face[3], face[1], face[2], face[3] });
+            continue;
+        }
+
+        PolygonPoint normal{ 0.f, 0.f, 0.f };
+        for (size_t k = 0; k < count; ++k)
+        {
+            PolygonPoint p1 = point(face[k]);
+            PolygonPoint p2 = point(face[(k + 1) % count]);
+            PolygonPoint a{ p1.x - p2.x, p1.y - p2.y, p1.z - p2.z };
+            PolygonPoint b{ p1.x + p2.x, p1.y + p2.y, p1.z + p2.z };
+            normal.x += a.y * b.z;
+            normal.y += a.z * b.x;
+            normal.z += a.x * b.y;
+        }
+        float length = Length(normal);
+        if (length <= 0)
+            continue;
+        float inverse = -1.f / length;
+        PolygonPoint axisW{ normal.x * inverse, normal.y * inverse, normal.z * inverse };
+        PolygonPoint helper = (std::fabs(axisW.x) > 0.9999999f) ? PolygonPoint{ 0.f, 1.f, 0.f } : PolygonPoint{ 1.f, 0.f, 0.f };
+        PolygonPoint axisV = Normalize(Cross(axisW, helper));
+        PolygonPoint axisU = Cross(axisW, axisV);
+
+        std::vector<std::vector<std::array<float, 2>>> polygon(1);
+        for (size_t k = 0; k < count; ++k)
+        {
+            PolygonPoint p = point(face[k]);
+            polygon[0].push_back({ Dot(p, axisU), Dot(p, axisV) });
+        }
+        for (uint32_t k : mapbox::earcut<uint32_t>(polygon))
+            chunk.triangles.push_back(face[k]);
+    }
+    while (command < chunk.commands.size())
+        chunk.commands[command++].triangle = chunk.triangles.size() / 3;
+}
+
+// The file names of an mtllib line: separated by spaces, where a backslash escapes the next character
+static std::vector<std::string> SplitLibraries(const std::string& line)
+{
+    std::vector<std::string> names;
+    std::string name;
+    bool escaping = false;
+    for (char c : line)
+    {
+        if (!escaping && c == '\\')
+        {
+            escaping = true;
+            continue;
+        }
+        if (!escaping && c == ' ')
+        {
+            if (!name.empty())
+                names.push_back(name);
+            name.clear();
+            continue;
+        }
+        escaping = false;
+        name += c;
+    }
+    names.push_back(name);
+    return names;
+}
+
+bool ObjParser::ParseFromFile(const std::string& filename, const std::string& mtlSearchPath)
+{
+    this->attrib = tinyobj::attrib_t();
+    this->shapes.clear();
+    this->materials.clear();
+    this->warning.clear();
+    this->error.clear();
+
+    MappedFile file;
+    if (!file.Open(filename))
+    {
+        // an empty file cannot be mapped, but is a valid model without any shape
+        std::ifstream ifs(filename);
+        if (ifs && ifs.peek() == std::ifstream::traits_type::eof())
+            return true;
+        this->error = "Cannot open file [" + filename + "]\n";
+        return false;
+    }
+
+    // materials are looked up next to the model unless a search path is given
+    std::string searchPath = mtlSearchPath;
+    if (searchPath.empty())
+    {
+        size_t slash = filename.find_last_of("/\\");
+        if (slash != std::string::npos)
+            searchPath = filename.substr(0, slash);
+    }
+
+    // Cut the file into chunks ending on line breaks
+    const char* text = reinterpret_cast<const char*>(file.Data());
+    const size_t size = file.Size();
+    const size_t chunkBytes = std::clamp(size / (this->pool.GetThreadCount() * 4), MinChunkBytes, MaxChunkBytes);
+    std::vector<ObjChunk> chunks;
+    for (size_t begin = 0; begin < size; )
+    {
+        size_t end = std::min(size, begin + chunkBytes);
+        if (end < size)
+        {
+            const void* lineBreak = std::memchr(text + end, '\n', size - end);
+            end = (lineBreak == nullptr) ? size : static_cast<size_t>(static_cast<const char*>(lineBreak) - text) + 1;
+        }
+        chunks.emplace_back();
+        chunks.back().begin = text + begin;
+        chunks.back().end = text + end;
+        begin = end;
+    }
+
+    this->pool.ParallelFor(chunks.size(), [&](size_t c) { ParseChunk(chunks[c]); });
+
+    // Every chunk now knows how many records and lines come before it
+    size_t vertexCount = 0, normalCount = 0, texcoordCount = 0, lines = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.firstLine = lines;
+        chunk.vertexOffset = vertexCount;
+        chunk.normalOffset = normalCount;
+        chunk.texcoordOffset = texcoordCount;
+        lines += chunk.lines;
+        vertexCount += chunk.vertices.size() / 3;
+        normalCount += chunk.normals.size() / 3;
+        texcoordCount += chunk.texcoords.size() / 2;
+        if (!chunk.error.text.empty())
+        {
+            this->error = chunk.error.text + " Line " + std::to_string(chunk.firstLine + chunk.error.line) + ").\n";
+            return false;
+        }
+    }
+
+    // Concatenate the records, and resolve relative indices against the records of earlier chunks
+    this->attrib.vertices.resize(3 * vertexCount);
+    this->attrib.normals.resize(3 * normalCount);
+    this->attrib.texcoords.resize(2 * texcoordCount);
+    this->pool.ParallelFor(chunks.size(), [&](size_t c)
+    {
+        ObjChunk& chunk = chunks[c];
+        std::copy(chunk.vertices.begin(), chunk.vertices.end(), this->attrib.vertices.begin() + 3 * chunk.vertexOffset);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), this->attrib.normals.begin() + 3 * chunk.normalOffset);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), this->attrib.texcoords.begin() + 2 * chunk.texcoordOffset);
+        chunk.vertices = std::vector<float>();
+        chunk.normals = std::vector<float>();
+        chunk.texcoords = std::vector<float>();
+
+        for (const RelativeIndex& relative : chunk.relative)
+        {
+            tinyobj::index_t& corner = chunk.corners[relative.corner];
+            int& index = (relative.field == 0) ? corner.vertex_index : (relative.field == 1 ? corner.normal_index : corner.texcoord_index);
+            index += static_cast<int>(relative.field == 0 ? chunk.vertexOffset : (relative.field == 1 ? chunk.normalOffset : chunk.texcoordOffset));
+            if (index < 0 && chunk.error.text.empty())
+                chunk.error = { relative.line, "Failed to parse `f' line (e.g. a zero value for vertex index "
+                    "or invalid relative vertex index)." };
+        }
+
+        TriangulateChunk(chunk, this->attrib.vertices);
+    });
+
+    for (const ObjChunk& chunk : chunks)
+    {
+        if (!chunk.error.text.empty())
+        {
+            this->error = chunk.error.text + " Line " + std::to_string(chunk.firstLine + chunk.error.line) + ").\n";
+            return false;
+        }
+    }
+
+    // Replay the commands in file order to cut the triangles into shapes, as tinyobj does:
+    //  `o` and `g` start a new shape, which is kept only if it gets any triangle
+    tinyobj::MaterialFileReader materialReader(searchPath);
+    std::map<std::string, int> materialMap;
+    std::vector<std::string> libraries;
+    std::string name;
+    int material = -1;
+    unsigned int smoothing = 0;
+    size_t shape = SIZE_MAX;        // the shape of the current name, once it has a triangle
+
+    std::vector<ObjRun> runs;
+    std::vector<size_t> shapeTriangles;
+    auto addRun = [&](size_t c, size_t first, size_t last)
+    {
+        if (first == last)
+            return;
+        if (shape == SIZE_MAX)
+        {
+            shape = this->shapes.size();
+            this->shapes.emplace_back();
+            this->shapes.back().name = name;
+            shapeTriangles.push_back(0);
+        }
+        runs.push_back({ c, first, last, shape, shapeTriangles[shape], material, smoothing });
+        shapeTriangles[shape] += last - first;
+    };
+
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        const ObjChunk& chunk = chunks[c];
+        size_t first = 0;
+        for (const ObjCommand& command : chunk.commands)
+        {
+            addRun(c, first, command.triangle);
+            first = command.triangle;
+
+            if (command.kind == ObjCommand::Kind::OBJECT || command.kind == ObjCommand::Kind::GROUP)
+            {
+                shape = SIZE_MAX;
+                name = command.value;
+                if (command.kind == ObjCommand::Kind::GROUP && name.empty())
+                    this->warning += "Empty group name. line: " + std::to_string(chunk.firstLine + command.line) + "\n";
+            }
+            else if (command.kind == ObjCommand::Kind::MATERIAL)
+            {
+                auto found = materialMap.find(command.value);
+                if (found == materialMap.end())
+                    this->warning += "material [ '" + command.value + "' ] not found in .mtl\n";
+                material = (found == materialMap.end()) ? -1 : found->second;
+            }
+            else if (command.kind == ObjCommand::Kind::LIBRARY)
+            {
+                bool found = false;
+                for (const std::string& library : SplitLibraries(command.value))
+                {
+                    if (std::find(libraries.begin(), libraries.end(), library) != libraries.end())
+                    {
+                        found = true;
+                        continue;
+                    }
+                    std::string libraryWarning, libraryError;
+                    bool loaded = materialReader(library, &this->materials, &materialMap, &libraryWarning, &libraryError);
+                    this->warning += libraryWarning;
+                    this->error += libraryError;
+                    if (loaded)
+                    {
+                        found = true;
+                        libraries.push_back(library);
+                        break;
+                    }
+                }
+                if (!found)
+                    this->warning += "Failed to load material file(s). Use default material.\n";
+            }
+            else
+                smoothing = command.smoothing;
+        }
+        addRun(c, first, chunk.triangles.size() / 3);
+    }
+
+    // Fill the shapes, every run into its own range
+    for (size_t s = 0; s < this->shapes.size(); ++s)
+    {
+        tinyobj::mesh_t& mesh = this->shapes[s].mesh;
+        mesh.indices.resize(3 * shapeTriangles[s]);
+        mesh.num_face_vertices.resize(shapeTriangles[s]);
+        mesh.material_ids.resize(shapeTriangles[s]);
+        mesh.smoothing_group_ids.resize(shapeTriangles[s]);
+    }
+    this->pool.ParallelFor(runs.size(), [&](size_t r)
+    {
+        const ObjRun& run = runs[r];
+        const ObjChunk& chunk = chunks[run.chunk];
+        tinyobj::mesh_t& mesh = this->shapes[run.shape].mesh;
+        std::copy(chunk.triangles.begin() + 3 * run.first, chunk.triangles.begin() + 3 * run.last, mesh.indices.begin() + 3 * run.offset);
+        const size_t count = run.last - run.first;
+        std::fill_n(mesh.num_face_vertices.begin() + run.offset, count, 3u);
+        std::fill_n(mesh.material_ids.begin() + run.offset, count, run.material);
+        std::fill_n(mesh.smoothing_group_ids.begin() + run.offset, count, run.smoothing);
+    });
+
+    // Messages of the chunks in file order, then indices beyond the records
+    int greatest[3] = { -1, -1, -1 };
+    for (const ObjChunk& chunk : chunks)
+    {
+        for (const ObjMessage& message : chunk.warnings)
+            this->warning += message.text + ((message.line == 0) ? "" : " Line " + std::to_string(chunk.firstLine + message.line) + ").") + "\n";
+        for (const tinyobj::index_t& corner : chunk.corners)
+        {
+            greatest[0] = std::max(greatest[0], corner.vertex_index);
+            greatest[1] = std::max(greatest[1], corner.normal_index);
+            greatest[2] = std::max(greatest[2], corner.texcoord_index);
+        }
+    }
+    if (greatest[0] >= static_cast<int>(vertexCount))
+        this->warning += "Vertex indices out of bounds.\n";
+    if (greatest[1] >= static_cast<int>(normalCount))
+        this->warning += "Vertex normal indices out of bounds.\n";
+    if (greatest[2] >= static_cast<int>(texcoordCount))
+        this->warning += "Vertex texcoord indices out of bounds.\n";
+
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "../thirdparty/tinyobj/tiny_obj_loader.h"
+
+class ThreadPool;
+
+// Wavefront OBJ reader that parses a file on every thread of a pool, as a drop-in for
+//  tinyobj::ObjReader with triangulation on. The file is mapped and cut into chunks on line
+//  boundaries; the chunks are parsed concurrently, then their vertices are concatenated, their
+//  relative indices resolved, their faces triangulated and assigned to shapes, the same way and
+//  in the same order as tinyobj does. Only the records the renderers read are parsed:
+//  v, vn, vt, f, o, g, s, usemtl and mtllib. Lines, points, vertex colors, weights and tags are skipped.
+class ObjParser
+{
+public:
+    ObjParser(ThreadPool& pool) : pool(pool) {  }
+
+    /**
+     * Parse `filename`; false on a malformed file, with the reason in Error().
+     * @param mtlSearchPath: where the material libraries named by `mtllib` are looked up
+     */
+    bool ParseFromFile(const std::string& filename, const std::string& mtlSearchPath = "");
+
+    inline const tinyobj::attrib_t& GetAttrib() const { return this->attrib; }
+    // Hands the attributes over to the caller, leaving the parser's empty
+    inline tinyobj::attrib_t TakeAttrib() { return std::move(this->attrib); }
+    inline const std::vector<tinyobj::shape_t>& GetShapes() const { return this->shapes; }
+    inline const std::vector<tinyobj::material_t>& GetMaterials() const { return this->materials; }
+    inline const std::string& Warning() const { return this->warning; }
+    inline const std::string& Error() const { return this->error; }
+
+private:
+    ThreadPool& pool;
+
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warning;
+    std::string error;
+};
+
+#endif
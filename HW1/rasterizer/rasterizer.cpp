@@ -1,6 +1,12 @@
 #include "rasterizer.hpp"
 
+#include "binner.hpp"
+#include "depthpyramid.hpp"
 #include "loader.hpp"
+#include "rasterkernels.hpp"
+#include "rasterpasses.hpp"
+#include "trianglesetup.hpp"
+#include <algorithm>
 #include <array>
 #include <cstdint>
 
@@ -17,43 +23,49 @@
 //  please add the files to the @includealso tag above. Otherwise, your files will
 //  not be included in grading. 
 
-Rasterizer::Rasterizer(Loader& loader) : 
+// An MSAA buffer with `spp` entries per pixel, or an empty one if MSAA is off or the task does not `read` it
+template<typename T>
+static ImageBuffer<T> SampleBuffer(const Loader& loader, uint32_t width, uint32_t height, bool read)
+{
+    if (!read || loader.GetAntiAliasConfig() != AntiAliasConfig::MSAA)
+        return ImageBuffer<T>(0, 0);
+    return ImageBuffer<T>(width * loader.GetSpp(), height);
+}
+
+Rasterizer::Rasterizer(Loader& loader) :
+    Rasterizer(loader, loader.GetWidth(), loader.GetHeight()) {  }
+
+Rasterizer::Rasterizer(Loader& loader, uint32_t width, uint32_t height) :
     loader(loader),
     model(),
     view(glm::mat4(1.f)),  
     projection(glm::mat4(1.f)),  
     screenspace(glm::mat4(1.f)),
-    ZBuffer(loader.GetWidth(), loader.GetHeight(), loader.GetOutputName())
+    kernels(GetRasterKernels(loader.GetSimdLevel())),
+    shading(loader),
+    ZBuffer(width, height, loader.GetOutputName()),
+    ZPyramid(width, height),
+    SampleMask(loader.GetAntiAliasConfig() == AntiAliasConfig::MSAA ? width : 0,
+        loader.GetAntiAliasConfig() == AntiAliasConfig::MSAA ? height : 0),
+    SampleColor(SampleBuffer<Color>(loader, width, height, loader.GetType() == TestType::TRIANGLE)),
+    SampleDepth(SampleBuffer<float>(loader, width, height, loader.GetType() == TestType::SHADING)),
+    SampleHDR(SampleBuffer<glm::vec4>(loader, width, height,
+        loader.GetType() == TestType::SHADING && loader.GetShadingMode() == ShadingMode::FORWARD)),
+    samplePattern(loader.GetAntiAliasConfig() == AntiAliasConfig::NONE ? nullptr : &SamplePattern::Get(loader.GetSpp()))
 {   
-    for (size_t i = 0; i != loader.GetHeight(); ++i)
-        for (size_t j = 0; j != loader.GetWidth(); ++j)
-            ZBuffer.Set(j, i, -1.f);
+    ZBuffer.Clear(-1.f);
+    ZPyramid.Reset(-1.f);
+    SampleMask.Clear(0u);
 }
 
 void Rasterizer::DrawPrimitiveRaw(Image &image, Triangle trig, AntiAliasConfig config, uint32_t spp)
 {
-    uint32_t xmax = 0, xmin = UINT32_MAX;
-    uint32_t ymax = 0, ymin = UINT32_MAX;
-    const std::array<glm::vec4, 3>& vertices = trig.pos;
+    this->DrawPrimitiveRaw(image, trig, config, spp, this->FullFrame());
+}
 
-    std::array<glm::vec3, 3> trimmedPos;
-    for (size_t ind = 0; ind != 3; ++ind)
-    {
-        const glm::vec4& v = vertices[ind];
-        if (v.x > xmax)
-            xmax = v.x;
-        if (v.x < xmin)
-            xmin = v.x;
-        if (v.y > ymax)
-            ymax = v.y;
-        if (v.y < ymin)
-            ymin = v.y;
-        trimmedPos[ind] = glm::vec3(v.x, v.y, 0);
-    }
-    
-    for (uint32_t x = xmin; x <= xmax; ++x)
-        for (uint32_t y = ymin; y <= ymax; ++y)
-            this->DrawPixel(x, y, trig, config, spp, image, Color::White);
+void Rasterizer::DrawPrimitiveRaw(Image &image, const Triangle& trig, AntiAliasConfig config, uint32_t spp, const TileRect& tile)
+{
+    CoverPrimitive(*this, image, trig, config, spp, Color::White, tile);
 }
 
 void Rasterizer::AddModel(MeshTransform transform)
@@ -64,59 +76,425 @@ void Rasterizer::AddModel(MeshTransform transform)
 
 void Rasterizer::InitZBuffer(ImageGrey& ZBuffer)
 {
-    for (size_t i = 0; i != this->loader.GetHeight(); ++i)
-        for (size_t j = 0; j != this->loader.GetWidth(); ++j)
-            ZBuffer.Set(j, i, Rasterizer::zBufferDefault);
+    ZBuffer.Clear(Rasterizer::zBufferDefault);
+
+    // the pyramid and the depth of the MSAA samples go with the rasterizer's own ZBuffer
+    if (&ZBuffer == &this->ZBuffer)
+    {
+        this->ZPyramid.Reset(Rasterizer::zBufferDefault);
+        this->SampleDepth.Clear(Rasterizer::zBufferDefault);
+    }
+}
+
+/**
+ * Depth-test a triangle against the rasterizer's ZBuffer, walking the pyramid cells and blocks under
+ * the bounding box and skipping every part outside the triangle or where the nearest depth the triangle
+ * can reach is not above the farthest depth already stored. onWrite(y, xSpan, mask) is called for every span with stored depths.
+ */
+template<typename OnWrite>
+static void DepthPass(Rasterizer& rasterizer, const TriangleSetup& setup, const TileRect& box, OnWrite&& onWrite)
+{
+    ImageGrey& ZBuffer = rasterizer.ZBuffer;
+    DepthPyramid& ZPyramid = rasterizer.ZPyramid;
+    const uint32_t blockSize = DepthPyramid::BlockSize;
+    const uint32_t cellSize = DepthPyramid::CellSize;
+    float lo, hi;
+    for (uint32_t cy = box.y0 / cellSize; cy <= (box.y1 - 1) / cellSize; ++cy)
+        for (uint32_t cx = box.x0 / cellSize; cx <= (box.x1 - 1) / cellSize; ++cx)
+        {
+            TileRect cell = box.Intersect({ cx * cellSize, cy * cellSize, (cx + 1) * cellSize, (cy + 1) * cellSize });
+            if (setup.ClassifyCenters(cell) == BlockCoverage::OUTSIDE)
+                continue;
+            setup.DepthBounds(cell, lo, hi);
+            if (hi <= ZPyramid.CellMin(cx, cy))
+                continue;
+
+            bool cellChanged = false;
+            for (uint32_t by = cell.y0 / blockSize; by <= (cell.y1 - 1) / blockSize; ++by)
+                for (uint32_t bx = cell.x0 / blockSize; bx <= (cell.x1 - 1) / blockSize; ++bx)
+                {
+                    TileRect block = cell.Intersect({ bx * blockSize, by * blockSize, (bx + 1) * blockSize, (by + 1) * blockSize });
+                    BlockCoverage coverage = setup.ClassifyCenters(block);
+                    if (coverage == BlockCoverage::OUTSIDE)
+                        continue;
+                    setup.DepthBounds(block, lo, hi);
+                    if (hi <= ZPyramid.BlockMin(bx, by))
+                        continue;
+
+                    // each block row is a single span, tested against the edges only if the block is partially covered
+                    static_assert(DepthPyramid::BlockSize == TriangleSetup::StepSpan, "pyramid blocks must match raster spans");
+                    const uint32_t xSpan = bx * blockSize;
+                    auto depthSpan = (coverage == BlockCoverage::INSIDE) ? rasterizer.kernels.DepthSpanInside : rasterizer.kernels.DepthSpan;
+                    bool written = false;
+                    for (uint32_t y = block.y0; y < block.y1; ++y)
+                    {
+                        uint32_t mask = depthSpan(setup, y, xSpan, block.x0, block.x1, ZBuffer.Row(y));
+                        if (mask != 0)
+                        {
+                            onWrite(y, xSpan, mask);
+                            written = true;
+                        }
+                    }
+
+                    if (written)
+                    {
+                        ZPyramid.UpdateBlock(ZBuffer, bx, by);
+                        cellChanged = true;
+                    }
+                }
+
+            if (cellChanged)
+                ZPyramid.UpdateCell(cx, cy);
+        }
+}
+
+void Rasterizer::DrawPrimitiveDepth(Triangle transformed, Triangle /*original*/, ImageGrey& ZBuffer)
+{
+    this->DrawPrimitiveDepth(transformed, ZBuffer, this->FullFrame());
 }
 
-void Rasterizer::DrawPrimitiveDepth(Triangle transformed, Triangle original, ImageGrey& ZBuffer)
+void Rasterizer::DrawPrimitiveDepth(const Triangle& transformed, ImageGrey& ZBuffer, const TileRect& tile)
 {
-    uint32_t xmax = 0, xmin = UINT32_MAX;
-    uint32_t ymax = 0, ymin = UINT32_MAX;
-    const std::array<glm::vec4, 3>& vertices = transformed.pos;
+    TileRect box;
+    if (!ClampedBoundingBox(transformed, tile, box))
+        return;
 
-    std::array<glm::vec3, 3> trimmedPos;
-    for (size_t ind = 0; ind != 3; ++ind)
+    TriangleSetup setup(transformed);
+    if (!setup.valid)
+        return;
+
+    // The depth pyramid only describes the rasterizer's own ZBuffer
+    if (&ZBuffer != &this->ZBuffer)
     {
-        const glm::vec4& v = vertices[ind];
-        if (v.x > xmax)
-            xmax = v.x;
-        if (v.x < xmin)
-            xmin = v.x;
-        if (v.y > ymax)
-            ymax = v.y;
-        if (v.y < ymin)
-            ymin = v.y;
-        trimmedPos[ind] = glm::vec3(v.x, v.y, 0);
+        for (uint32_t y = box.y0; y < box.y1; ++y)
+            this->kernels.DepthRow(setup, y, box.x0, box.x1, ZBuffer.Row(y));
+        return;
     }
 
-    for (uint32_t x = xmin; x <= xmax; ++x)
-        for (uint32_t y = ymin; y <= ymax; ++y)
-            this->UpdateDepthAtPixel(x, y, original, transformed, ZBuffer);
+    DepthPass(*this, setup, box, [](uint32_t, uint32_t, uint32_t) {  });
+}
+
+void Rasterizer::DrawPrimitiveVisibility(const Triangle& transformed, uint32_t id, VisibilityBuffer& visibility, const TileRect& tile)
+{
+    TileRect box;
+    if (!ClampedBoundingBox(transformed, tile, box))
+        return;
+
+    TriangleSetup setup(transformed);
+    if (!setup.valid)
+        return;
+
+    DepthPass(*this, setup, box, [&](uint32_t y, uint32_t xSpan, uint32_t written)
+    {
+        TriangleSetup::Edges edgesStart;
+        float depthStart;
+        setup.SpanStart(xSpan, y, edgesStart, depthStart);
+
+        uint32_t* ids = visibility.ids.Row(y);
+        glm::vec2* barycentrics = visibility.barycentrics.Row(y);
+        for (uint32_t k = 0; k != TriangleSetup::StepSpan; ++k)
+            if (written & (1u << k))
+            {
+                ids[xSpan + k] = id;
+                barycentrics[xSpan + k] = glm::vec2(setup.Barycentric(setup.EdgesInSpan(edgesStart, k)));
+            }
+    });
+}
+
+void Rasterizer::ResolveVisibility(const VisibilityBuffer& visibility, const std::vector<Triangle>& originals, ImageHDR& image, const TileRect& tile)
+{
+    this->ResolveVisibility<true>(visibility, originals, image, tile);
+}
+
+template<bool Normals>
+void Rasterizer::ResolveVisibility(const VisibilityBuffer& visibility, const std::vector<Triangle>& originals, ImageHDR& image, const TileRect& tile)
+{
+    for (uint32_t y = tile.y0; y < tile.y1; ++y)
+    {
+        const uint32_t* ids = visibility.ids.Row(y);
+        const glm::vec2* barycentrics = visibility.barycentrics.Row(y);
+        glm::vec4* colors = image.Row(y);
+        for (uint32_t x = tile.x0; x < tile.x1; ++x)
+        {
+            if (ids[x] == VisibilityBuffer::Empty)
+                continue;
+            glm::vec2 weights = barycentrics[x];
+            colors[x] = glm::vec4(this->ShadeFragment<Normals>(x, y, glm::vec3(weights, 1.f - weights.x - weights.y), originals[ids[x]]), 1.f);
+        }
+    }
+}
+
+template void Rasterizer::ResolveVisibility<true>(const VisibilityBuffer&, const std::vector<Triangle>&, ImageHDR&, const TileRect&);
+template void Rasterizer::ResolveVisibility<false>(const VisibilityBuffer&, const std::vector<Triangle>&, ImageHDR&, const TileRect&);
+
+void Rasterizer::DrawPrimitiveShaded(Triangle transformed, Triangle original, ImageHDR& image)
+{
+    this->DrawPrimitiveShaded(transformed, original, image, this->FullFrame());
+}
+
+void Rasterizer::DrawPrimitiveShaded(const Triangle& transformed, const Triangle& original, ImageHDR& image, const TileRect& tile)
+{
+    this->DrawPrimitiveShaded<true>(transformed, original, image, tile);
+}
+
+template<bool Normals>
+void Rasterizer::DrawPrimitiveShaded(const Triangle& transformed, const Triangle& original, ImageHDR& image, const TileRect& tile)
+{
+    TileRect box;
+    if (!ClampedBoundingBox(transformed, tile, box))
+        return;
+
+    TriangleSetup setup(transformed);
+    if (!setup.valid)
+        return;
+
+    // A pixel is shaded only where its depth equals the stored one, so parts of the box outside the
+    //  triangle or whose depth range does not overlap the stored range are skipped.
+    const uint32_t blockSize = DepthPyramid::BlockSize;
+    const uint32_t cellSize = DepthPyramid::CellSize;
+    float lo, hi;
+    for (uint32_t cy = box.y0 / cellSize; cy <= (box.y1 - 1) / cellSize; ++cy)
+        for (uint32_t cx = box.x0 / cellSize; cx <= (box.x1 - 1) / cellSize; ++cx)
+        {
+            TileRect cell = box.Intersect({ cx * cellSize, cy * cellSize, (cx + 1) * cellSize, (cy + 1) * cellSize });
+            if (setup.ClassifyCenters(cell) == BlockCoverage::OUTSIDE)
+                continue;
+            setup.DepthBounds(cell, lo, hi);
+            if (hi < this->ZPyramid.CellMin(cx, cy) || lo > this->ZPyramid.CellMax(cx, cy))
+                continue;
+
+            for (uint32_t by = cell.y0 / blockSize; by <= (cell.y1 - 1) / blockSize; ++by)
+                for (uint32_t bx = cell.x0 / blockSize; bx <= (cell.x1 - 1) / blockSize; ++bx)
+                {
+                    TileRect block = cell.Intersect({ bx * blockSize, by * blockSize, (bx + 1) * blockSize, (by + 1) * blockSize });
+                    BlockCoverage coverage = setup.ClassifyCenters(block);
+                    if (coverage == BlockCoverage::OUTSIDE)
+                        continue;
+                    setup.DepthBounds(block, lo, hi);
+                    if (hi < this->ZPyramid.BlockMin(bx, by) || lo > this->ZPyramid.BlockMax(bx, by))
+                        continue;
+
+                    // each block row is a single span, tested against the edges only if the block is partially covered
+                    static_assert(DepthPyramid::BlockSize == TriangleSetup::StepSpan, "pyramid blocks must match raster spans");
+                    const uint32_t xSpan = bx * blockSize;
+                    auto visibleSpan = (coverage == BlockCoverage::INSIDE) ? this->kernels.VisibleSpanInside : this->kernels.VisibleSpan;
+                    for (uint32_t y = block.y0; y < block.y1; ++y)
+                    {
+                        uint32_t visible = visibleSpan(setup, y, xSpan, block.x0, block.x1, this->ZBuffer.Row(y));
+                        if (visible == 0)
+                            continue;
+
+                        TriangleSetup::Edges edgesStart;
+                        float depthStart;
+                        setup.SpanStart(xSpan, y, edgesStart, depthStart);
+                        glm::vec4* colors = image.Row(y);
+                        for (uint32_t k = 0; k != TriangleSetup::StepSpan; ++k)
+                            if (visible & (1u << k))
+                                colors[xSpan + k] = glm::vec4(this->ShadeFragment<Normals>(xSpan + k, y,
+                                    setup.Barycentric(setup.EdgesInSpan(edgesStart, k)), original), 1.f);
+                    }
+                }
+        }
+}
+
+template void Rasterizer::DrawPrimitiveShaded<true>(const Triangle&, const Triangle&, ImageHDR&, const TileRect&);
+template void Rasterizer::DrawPrimitiveShaded<false>(const Triangle&, const Triangle&, ImageHDR&, const TileRect&);
+
+// Call pixel(x, y) for every pixel of `box` in a block whose area the triangle may touch
+template<typename Pixel>
+static void ForEachSampledPixel(const TriangleSetup& setup, const TileRect& box, Pixel&& pixel)
+{
+    setup.ForEachBlock(box, true, [&](const TileRect& block, BlockCoverage)
+    {
+        for (uint32_t y = block.y0; y < block.y1; ++y)
+            for (uint32_t x = block.x0; x < block.x1; ++x)
+                pixel(x, y);
+    });
+}
+
+// Edge values at sample i of pixel (x, y), at the same points as the coverage passes test
+static inline TriangleSetup::Edges SampleEdges(const TriangleSetup& setup, const SamplePattern& samples, uint32_t x, uint32_t y, uint32_t i)
+{
+    return setup.EdgesAt(TriangleSetup::Snap(x + samples[i].x), TriangleSetup::Snap(y + samples[i].y));
 }
 
-void Rasterizer::DrawPrimitiveShaded(Triangle transformed, Triangle original, Image& image)
+static inline float SampleDepthAt(const TriangleSetup& setup, const SamplePattern& samples, uint32_t x, uint32_t y, uint32_t i)
 {
-    uint32_t xmax = 0, xmin = UINT32_MAX;
-    uint32_t ymax = 0, ymin = UINT32_MAX;
-    const std::array<glm::vec4, 3>& vertices = transformed.pos;
+    return setup.DepthAt(x + samples[i].x, y + samples[i].y);
+}
 
-    std::array<glm::vec3, 3> trimmedPos;
-    for (size_t ind = 0; ind != 3; ++ind)
+/**
+ * Depth-test every sample the triangle covers in `box` against the rasterizer's SampleDepth, and call
+ * onWrite(y, index, edges) for every sample stored, `index` being its entry in row y of the per-sample buffers.
+ */
+template<typename OnWrite>
+static void DepthPassMultisample(Rasterizer& rasterizer, const TriangleSetup& setup, const TileRect& box, OnWrite&& onWrite)
+{
+    const SamplePattern& samples = *rasterizer.samplePattern;
+    const uint32_t spp = samples.Count();
+    ForEachSampledPixel(setup, box, [&](uint32_t x, uint32_t y)
     {
-        const glm::vec4& v = vertices[ind];
-        if (v.x > xmax)
-            xmax = v.x;
-        if (v.x < xmin)
-            xmin = v.x;
-        if (v.y > ymax)
-            ymax = v.y;
-        if (v.y < ymin)
-            ymin = v.y;
-        trimmedPos[ind] = glm::vec3(v.x, v.y, 0);
+        const size_t first = static_cast<size_t>(x) * spp;
+        float* depths = rasterizer.SampleDepth.Row(y) + first;
+        for (uint32_t i = 0; i < spp; ++i)
+        {
+            TriangleSetup::Edges edges = SampleEdges(setup, samples, x, y, i);
+            if (!edges.Inside())
+                continue;
+            float depth = SampleDepthAt(setup, samples, x, y, i);
+            if (depth > depths[i])
+            {
+                depths[i] = depth;
+                onWrite(y, first + i, edges);
+            }
+        }
+    });
+}
+
+void Rasterizer::DrawPrimitiveDepthMultisample(const Triangle& transformed, const TileRect& tile)
+{
+    TileRect box;
+    if (!ClampedBoundingBox(transformed, tile, box))
+        return;
+
+    TriangleSetup setup(transformed);
+    if (!setup.valid)
+        return;
+
+    DepthPassMultisample(*this, setup, box, [](uint32_t, size_t, const TriangleSetup::Edges&) {  });
+}
+
+void Rasterizer::DrawPrimitiveVisibilityMultisample(const Triangle& transformed, uint32_t id, VisibilityBuffer& visibility, const TileRect& tile)
+{
+    TileRect box;
+    if (!ClampedBoundingBox(transformed, tile, box))
+        return;
+
+    TriangleSetup setup(transformed);
+    if (!setup.valid)
+        return;
+
+    DepthPassMultisample(*this, setup, box, [&](uint32_t y, size_t index, const TriangleSetup::Edges& edges)
+    {
+        visibility.ids.Row(y)[index] = id;
+        visibility.barycentrics.Row(y)[index] = glm::vec2(setup.Barycentric(edges));
+    });
+}
+
+template<bool Normals>
+void Rasterizer::DrawPrimitiveShadedMultisample(const Triangle& transformed, const Triangle& original, const TileRect& tile)
+{
+    TileRect box;
+    if (!ClampedBoundingBox(transformed, tile, box))
+        return;
+
+    TriangleSetup setup(transformed);
+    if (!setup.valid)
+        return;
+
+    const SamplePattern& samples = *this->samplePattern;
+    const uint32_t spp = samples.Count();
+    ForEachSampledPixel(setup, box, [&](uint32_t x, uint32_t y)
+    {
+        // the samples whose stored depth is this triangle's
+        const size_t first = static_cast<size_t>(x) * spp;
+        const float* depths = this->SampleDepth.Row(y) + first;
+        uint32_t owned = 0, count = 0;
+        glm::vec3 barycentric(0.f);
+        for (uint32_t i = 0; i < spp; ++i)
+        {
+            TriangleSetup::Edges edges = SampleEdges(setup, samples, x, y, i);
+            if (edges.Inside() && SampleDepthAt(setup, samples, x, y, i) == depths[i])
+            {
+                owned |= 1u << i;
+                ++count;
+                barycentric += setup.Barycentric(edges);
+            }
+        }
+        if (count == 0)
+            return;
+
+        // barycentric weights are affine, so their mean is the weight at the centroid of the samples
+        const glm::vec4 color(this->ShadeFragment<Normals>(x, y, barycentric / static_cast<float>(count), original), 1.f);
+        glm::vec4* colors = this->SampleHDR.Row(y) + first;
+        for (uint32_t i = 0; i < spp; ++i)
+            if (owned & (1u << i))
+                colors[i] = color;
+    });
+}
+
+template void Rasterizer::DrawPrimitiveShadedMultisample<true>(const Triangle&, const Triangle&, const TileRect&);
+template void Rasterizer::DrawPrimitiveShadedMultisample<false>(const Triangle&, const Triangle&, const TileRect&);
+
+void Rasterizer::ResolveShadedMultisample(ImageHDR& image, const TileRect& tile)
+{
+    const uint32_t spp = this->samplePattern->Count();
+    for (uint32_t y = tile.y0; y < tile.y1; ++y)
+    {
+        glm::vec4* pixels = image.Row(y);
+        for (uint32_t x = tile.x0; x < tile.x1; ++x)
+        {
+            const size_t first = static_cast<size_t>(x) * spp;
+            const float* depths = this->SampleDepth.Row(y) + first;
+            const glm::vec4* colors = this->SampleHDR.Row(y) + first;
+            glm::vec4 sum(0.f);
+            uint32_t covered = 0;
+            for (uint32_t i = 0; i < spp; ++i)
+                if (depths[i] > Rasterizer::zBufferDefault)
+                {
+                    sum += colors[i];
+                    ++covered;
+                }
+            if (covered != 0)
+                pixels[x] = (sum + static_cast<float>(spp - covered) * pixels[x]) / static_cast<float>(spp);
+        }
     }
+}
+
+template<bool Normals>
+void Rasterizer::ResolveVisibilityMultisample(const VisibilityBuffer& visibility, const std::vector<Triangle>& originals, ImageHDR& image, const TileRect& tile)
+{
+    const uint32_t spp = this->samplePattern->Count();
+    for (uint32_t y = tile.y0; y < tile.y1; ++y)
+    {
+        glm::vec4* pixels = image.Row(y);
+        for (uint32_t x = tile.x0; x < tile.x1; ++x)
+        {
+            const size_t first = static_cast<size_t>(x) * spp;
+            const uint32_t* ids = visibility.ids.Row(y) + first;
+            const glm::vec2* barycentrics = visibility.barycentrics.Row(y) + first;
 
-    for (uint32_t x = xmin; x <= xmax; ++x)
-        for (uint32_t y = ymin; y <= ymax; ++y)
-            this->ShadeAtPixel(x, y, original, transformed, image);
+            // The samples of one triangle are shaded once, at their centroid, and weighted by their count
+            glm::vec3 sum(0.f);
+            uint32_t covered = 0, grouped = 0;
+            for (uint32_t i = 0; i < spp; ++i)
+            {
+                if (ids[i] == VisibilityBuffer::Empty || (grouped & (1u << i)))
+                    continue;
+                glm::vec2 weights(0.f);
+                uint32_t count = 0;
+                for (uint32_t j = i; j < spp; ++j)
+                    if (ids[j] == ids[i])
+                    {
+                        weights += barycentrics[j];
+                        grouped |= 1u << j;
+                        ++count;
+                    }
+                weights /= static_cast<float>(count);
+                sum += static_cast<float>(count) *
+                    this->ShadeFragment<Normals>(x, y, glm::vec3(weights, 1.f - weights.x - weights.y), originals[ids[i]]);
+                covered += count;
+            }
+            if (covered != 0)
+                pixels[x] = (glm::vec4(sum, static_cast<float>(covered)) + static_cast<float>(spp - covered) * pixels[x]) / static_cast<float>(spp);
+        }
+    }
+}
+
+template void Rasterizer::ResolveVisibilityMultisample<true>(const VisibilityBuffer&, const std::vector<Triangle>&, ImageHDR&, const TileRect&);
+template void Rasterizer::ResolveVisibilityMultisample<false>(const VisibilityBuffer&, const std::vector<Triangle>&, ImageHDR&, const TileRect&);
+
+TileRect Rasterizer::FullFrame() const
+{
+    return { 0, 0, this->ZBuffer.GetWidth(), this->ZBuffer.GetHeight() };
 }
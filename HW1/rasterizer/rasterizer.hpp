@@ -1,9 +1,16 @@
 #ifndef RASTERIZER_H
 #define RASTERIZER_H
 
+#include "depthpyramid.hpp"
 #include "entities.hpp"
 #include "image.hpp"
+#include "lightgrid.hpp"
 #include "loader.hpp"
+#include "rasterkernels.hpp"
+#include "samplepattern.hpp"
+#include "shadingcontext.hpp"
+#include "trianglesetup.hpp"
+#include "visibilitybuffer.hpp"
 #include <cstdint>
 
 class Rasterizer
@@ -11,9 +18,15 @@ class Rasterizer
 public:
     Rasterizer(Loader& loader);
 
+    // Size the buffers for a frame of `width` x `height` pixels instead of the configured resolution,
+    //  e.g. for one band of a frame rendered in strips
+    Rasterizer(Loader& loader, uint32_t width, uint32_t height);
+
     /// rasterizer.cpp
     // Render a single triangle, with no transformations, and possible anti-aliasing, based on config
     void DrawPrimitiveRaw(Image& image, Triangle trig, AntiAliasConfig config, uint32_t spp);
+    // Same as above, but only touch the pixels inside `tile`
+    void DrawPrimitiveRaw(Image& image, const Triangle& trig, AntiAliasConfig config, uint32_t spp, const TileRect& tile);
 
 
     // Add a model to the rasterizer. Provide rotation part of the transformation, and dispatch to the impl version
@@ -25,9 +38,44 @@ public:
 
     // Render the depth information of a single triangle.
     void DrawPrimitiveDepth(Triangle transformed, Triangle original, ImageGrey& ZBuffer);
-
-    // Render a single triangle, with blinn-phong shading
-    void DrawPrimitiveShaded(Triangle transformed, Triangle original, Image& image);
+    void DrawPrimitiveDepth(const Triangle& transformed, ImageGrey& ZBuffer, const TileRect& tile);
+
+    // Render a single triangle, with blinn-phong shading, into the float framebuffer
+    void DrawPrimitiveShaded(Triangle transformed, Triangle original, ImageHDR& image);
+    void DrawPrimitiveShaded(const Triangle& transformed, const Triangle& original, ImageHDR& image, const TileRect& tile);
+
+    // Render the depth of a single triangle into ZBuffer, recording `id` and the barycentric
+    //  coordinates in the visibility buffer wherever the triangle becomes the nearest one
+    void DrawPrimitiveVisibility(const Triangle& transformed, uint32_t id, VisibilityBuffer& visibility, const TileRect& tile);
+
+    // Shade every covered pixel of `tile` in the visibility buffer once, with blinn-phong shading,
+    //  into the float framebuffer. `originals` is indexed by the ids written in DrawPrimitiveVisibility.
+    void ResolveVisibility(const VisibilityBuffer& visibility, const std::vector<Triangle>& originals, ImageHDR& image, const TileRect& tile);
+
+    // The two above, compiled for meshes with vertex normals, or without them (Normals false) for flat
+    //  shading with the face normal; the untemplated forms use vertex normals. See rasterpasses.hpp.
+    template<bool Normals>
+    void DrawPrimitiveShaded(const Triangle& transformed, const Triangle& original, ImageHDR& image, const TileRect& tile);
+    template<bool Normals>
+    void ResolveVisibility(const VisibilityBuffer& visibility, const std::vector<Triangle>& originals, ImageHDR& image, const TileRect& tile);
+
+    // MSAA shading: the per-sample forms of DrawPrimitiveDepth, DrawPrimitiveVisibility, DrawPrimitiveShaded
+    //  and ResolveVisibility. Coverage and depth are tested at every sample against SampleDepth, `visibility`
+    //  holds `spp` entries per pixel, and a triangle is shaded once per pixel, at the centroid of the samples
+    //  it owns. The forward pass leaves its colors in SampleHDR until ResolveShadedMultisample.
+    void DrawPrimitiveDepthMultisample(const Triangle& transformed, const TileRect& tile);
+    void DrawPrimitiveVisibilityMultisample(const Triangle& transformed, uint32_t id, VisibilityBuffer& visibility, const TileRect& tile);
+    template<bool Normals>
+    void DrawPrimitiveShadedMultisample(const Triangle& transformed, const Triangle& original, const TileRect& tile);
+    template<bool Normals>
+    void ResolveVisibilityMultisample(const VisibilityBuffer& visibility, const std::vector<Triangle>& originals, ImageHDR& image, const TileRect& tile);
+
+    // MSAA forward shading: set every pixel of `tile` to the average of its samples in SampleHDR, the
+    //  samples no triangle covers keeping the pixel's color
+    void ResolveShadedMultisample(ImageHDR& image, const TileRect& tile);
+
+    // The rectangle covering the whole frame held in the buffers
+    TileRect FullFrame() const;
 
     // rasterizer_impl.cpp
 
@@ -37,13 +85,23 @@ public:
      * @param x: x coordinate of the pixel
      * @param y: y coordinate of the pixel
      * @param trig: the triangle in which the pixel is considered; see class `Triangle` in `entities.hpp`
-     * @param config: the anti-aliasing configuration, which can be either `NONE` or `SSAA`
-     * @param spp: the number of samples per pixel. Only useful if config is set to `SSAA`
+     * @param config: the anti-aliasing configuration, which can be `NONE`, `SSAA` or `MSAA`
+     * @param spp: the number of samples per pixel. Only useful if config is set to `SSAA` or `MSAA`
      * @param image: the image to render the pixel on. See class `Image` in `image.hpp` for APIs of read/write operations
      * @param color: the color to render the pixel with, if the pixel is completely inside the triangle
      */
     void DrawPixel(uint32_t x, uint32_t y, Triangle trig, AntiAliasConfig config, uint32_t spp, Image& image, Color color);
 
+    // MSAA: add the covered samples of a pixel to SampleMask and store `color`, shaded once for the pixel, in each of them
+    void StoreMultisample(uint32_t x, uint32_t y, uint32_t mask, Image& image, Color color);
+
+    // MSAA: set every covered pixel of `tile` to the average of its samples, the uncovered ones keeping
+    //  the pixel's color, then clear its samples
+    void ResolveMultisample(Image& image, const TileRect& tile);
+
+    // The fixed sample positions for `spp` samples per pixel
+    const SamplePattern& GetSamplePattern(uint32_t spp) const;
+
 
     /**
      * Add the corresponding model transformation to the rasterizer. 
@@ -96,6 +154,18 @@ public:
      */
     void ShadeAtPixel(uint32_t x, uint32_t y, Triangle original, Triangle transformed, Image& image);
 
+    /**
+     * Shade a pixel already known to be visible, given its barycentric coordinates in the triangle.
+     * @param barycentric: the barycentric coordinates of the pixel center with respect to the transformed triangle
+     * @param original: the original triangle in the model space (before MVP transformation)
+     * @return: the linear color of the pixel, 1 being full intensity
+     */
+    glm::vec3 ShadeFragment(uint32_t x, uint32_t y, glm::vec3 barycentric, const Triangle& original);
+
+    // Same as above, with the normal interpolated from the vertex normals (Normals), or the face normal
+    template<bool Normals>
+    glm::vec3 ShadeFragment(uint32_t x, uint32_t y, glm::vec3 barycentric, const Triangle& original);
+
 public:
     // Configs
     Loader& loader;
@@ -104,9 +174,35 @@ public:
     glm::mat4x4 projection;
     glm::mat4x4 screenspace;
 
+    // Row kernels of the depth and shading passes, chosen from the CPU at construction
+    const RasterKernels& kernels;
+
+    // Lights, camera position and material of the frame, gathered once at construction
+    ShadingContext shading;
+
+    // Per-tile light lists; when set, fragments are shaded with their tile's lights only
+    const LightGrid* lightGrid = nullptr;
+
     // Buffers
     ImageGrey ZBuffer;
 
+    // Per-block and per-cell depth bounds of ZBuffer, used to reject hidden triangles early.
+    //  Kept in sync by InitZBuffer and DrawPrimitiveDepth when they are given ZBuffer itself.
+    DepthPyramid ZPyramid;
+
+    // MSAA: covered samples per pixel, bit i for sample i. Empty unless MSAA is configured.
+    ImageBuffer<uint32_t> SampleMask;
+
+    // MSAA: buffers with `spp` consecutive entries per pixel, sample i of pixel x at x * spp + i. Each is
+    //  empty unless the task reads it: the colors of the coverage tasks, the depth of shading, and the
+    //  linear colors of forward shading.
+    Image SampleColor;
+    ImageGrey SampleDepth;
+    ImageHDR SampleHDR;
+
+    // Sample positions for the configured spp, built at construction; null without anti-aliasing
+    const SamplePattern* samplePattern;
+
     // Configurations 
     /** 
      * The default value for the ZBuffer during initialization.
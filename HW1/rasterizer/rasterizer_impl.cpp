@@ -3,91 +3,74 @@
 #include "image.hpp"
 #include "loader.hpp"
 #include "rasterizer.hpp"
-#include <random>
+#include "rasterpasses.hpp"
+#include "tonemap.hpp"
 #include <iostream>
 // TODO
 bool IsPixelInsideTriangle(float x, float y, Triangle trig)
 {
-    // Convert trig positions to vec3 by dropping the w component from vec4
-    trig.Homogenize();
-    glm::vec3 vec_a = glm::vec3(trig.pos[0]);  // Convert directly from vec4 to vec3
-    glm::vec3 vec_b = glm::vec3(trig.pos[1]);
-    glm::vec3 vec_c = glm::vec3(trig.pos[2]);
-
-    glm::vec3 vec_p = glm::vec3(x, y, 0.0f);
-
-    // Calculate cross products
-    glm::vec3 cross_product_1 = glm::cross(vec_b - vec_a, vec_p - vec_a);
-    glm::vec3 cross_product_2 = glm::cross(vec_c - vec_b, vec_p - vec_b);
-    glm::vec3 cross_product_3 = glm::cross(vec_a - vec_c, vec_p - vec_c);
-
-    // Check if the point is inside the triangle by comparing the sign of the z-component of the cross products
-    float z1 = cross_product_1.z;
-    float z2 = cross_product_2.z;
-    float z3 = cross_product_3.z;
+    // Same snapped edge functions and top-left fill rule as the raster passes, so a point on
+    //  an edge shared by two triangles is inside exactly one of them
+    return TriangleSetup(trig).Covers(x, y);
+}
 
-    // Check if all signs are the same and non-zero
-    if ((z1 > 0 && z2 > 0 && z3 > 0) || (z1 < 0 && z2 < 0 && z3 < 0) || (z1 * z2 * z3 == 0))
-    {
-        return true;
-    }
-    return false;
+void Rasterizer::DrawPixel(uint32_t x, uint32_t y, Triangle trig, AntiAliasConfig config, uint32_t spp, Image& image, Color color)
+{
+    // The coverage passes restricted to this one pixel, which must lie in the image
+    TileRect pixel = TileRect{ 0, 0, image.GetWidth(), image.GetHeight() }.Intersect({ x, y, x + 1, y + 1 });
+    if (!pixel.Empty())
+        CoverPrimitive(*this, image, trig, config, spp, color, pixel);
 }
 
-std::vector<glm::vec3> GenerateSamplesInPixel(uint32_t x, uint32_t y, uint32_t spp)
+void Rasterizer::StoreMultisample(uint32_t x, uint32_t y, uint32_t mask, Image& /*image*/, Color color)
 {
-    // Generate spp samples in the pixel with uniform distribution in the range [0, 1]
-  // Vector to store the generated samples
-    std::vector<glm::vec3> samples;
-
-    // Create a random number generator
-    std::random_device rd;
-    std::mt19937 gen(rd());  // Mersenne Twister random number engine
-    std::uniform_real_distribution<float> dis(0.0f, 1.0f);  // Uniform distribution in range [0, 1]
-    // std::normal_distribution<float> dis(0.5f, 1.0f);  // Normal distribution with mean 0 and standard deviation 1
-    // Generate 'spp' samples
-    for (uint32_t i = 0; i < spp; ++i)
+    // shade once per pixel and keep the color of every covered sample until ResolveMultisample
+    const uint32_t spp = this->samplePattern->Count();
+    mask &= this->samplePattern->FullMask();
+    if (mask != 0)
     {
-        // Generate random (x, y) coordinates within the pixel
-        float sample_x = dis(gen);  // Random float between 0 and 1 for x-axis
-        float sample_y = dis(gen);  // Random float between 0 and 1 for y-axis
-
-        // Create a sample point (x + sample_x, y + sample_y, z)
-        // We use the pixel location `(x, y)` and offset by a random sample within the pixel's unit square
-        samples.push_back(glm::vec3(x + sample_x, y + sample_y, 0.0f));  // z = 0 for now
+        this->SampleMask.Row(y)[x] |= mask;
+        Color* colors = this->SampleColor.Row(y) + static_cast<size_t>(x) * spp;
+        for (uint32_t i = 0; i < spp; ++i)
+            if (mask & (1u << i))
+                colors[i] = color;
     }
-
-    return samples;
 }
 
-
-void Rasterizer::DrawPixel(uint32_t x, uint32_t y, Triangle trig, AntiAliasConfig config, uint32_t spp, Image& image, Color color)
+void Rasterizer::ResolveMultisample(Image& image, const TileRect& tile)
 {
-    if (config == AntiAliasConfig::NONE)            // if anti-aliasing is off
-    {
-        if (IsPixelInsideTriangle(x + 0.5, y + 0.5, trig))
-        {
-            image.Set(x, y, color);
-        }   
-
-    }
-    else if (config == AntiAliasConfig::SSAA)       // if anti-aliasing is on
+    const uint32_t spp = this->samplePattern->Count();
+    for (uint32_t y = tile.y0; y < tile.y1; ++y)
     {
-        // Generate spp samples in the pixel
-        std::vector<glm::vec3> samples = GenerateSamplesInPixel(x, y, spp);
-        int count = 0;
-        for (uint32_t i = 0; i < spp; i++)
-        {
-            if (IsPixelInsideTriangle(samples[i].x, samples[i].y, trig))
+        uint32_t* masks = this->SampleMask.Row(y);
+        const Color* samples = this->SampleColor.Row(y);
+        for (uint32_t x = tile.x0; x < tile.x1; ++x)
+            if (masks[x] != 0)
             {
-                ++count;
+                // samples no triangle covered show what the pixel held before
+                const Color& pixel = image.At(x, y);
+                const Color* colors = samples + static_cast<size_t>(x) * spp;
+                float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+                for (uint32_t i = 0; i < spp; ++i)
+                {
+                    const Color& c = (masks[x] & (1u << i)) ? colors[i] : pixel;
+                    sum[0] += c.r;
+                    sum[1] += c.g;
+                    sum[2] += c.b;
+                    sum[3] += c.a;
+                }
+                const float scale = 1.f / static_cast<float>(spp);
+                image.At(x, y) = Color(sum[0] * scale, sum[1] * scale, sum[2] * scale, sum[3] * scale);
+                masks[x] = 0;       // ready for the next frame drawn into the same buffers
             }
-        }
-        // Set the color of the sample
-        double ratio = count / spp;
-        image.Set(x, y, color * (count / spp));
     }
-    return;
+}
+
+const SamplePattern& Rasterizer::GetSamplePattern(uint32_t spp) const
+{
+    if (this->samplePattern && this->samplePattern->Count() == spp)
+        return *this->samplePattern;
+    return SamplePattern::Get(spp);
 }
 
 // TODO
@@ -252,7 +235,7 @@ glm::vec3 Rasterizer::BarycentricCoordinate(glm::vec2 pos, Triangle trig)
 
 float Rasterizer::zBufferDefault = -2.0f;          // assume the default value of ZBuffer is infinity
 // TODO
-void Rasterizer::UpdateDepthAtPixel(uint32_t x, uint32_t y, Triangle original, Triangle transformed, ImageGrey& ZBuffer)
+void Rasterizer::UpdateDepthAtPixel(uint32_t x, uint32_t y, Triangle /*original*/, Triangle transformed, ImageGrey& ZBuffer)
 {
     if (IsPixelInsideTriangle(x + 0.5, y + 0.5, transformed))
     {
@@ -262,9 +245,9 @@ void Rasterizer::UpdateDepthAtPixel(uint32_t x, uint32_t y, Triangle original, T
         // float result = glm::dot(barycentric, glm::vec3(original.pos[0].z, original.pos[1].z, original.pos[2].z));
         float result = glm::dot(barycentric, glm::vec3(transformed.pos[0].z, transformed.pos[1].z, transformed.pos[2].z));
         
-        if (result > ZBuffer.Get(x, y)){
-            ZBuffer.Set(x, y, result);
-        }
+        float& stored = ZBuffer.At(x, y);
+        if (result > stored)
+            stored = result;
     }
     return;
 }
@@ -282,90 +265,59 @@ glm::vec3 CalculateNormal(glm::vec3 barycentric, Triangle original)
     return glm::normalize(normal);
 }
 
-Color CalculateColor_BlinnPhong(glm::vec3 pos, glm::vec3 normal, glm::vec3 view_pos, std::vector<Light> lights, Color ambient, float specularExponent)
+glm::vec3 CalculateColor_BlinnPhong(glm::vec3 pos, glm::vec3 normal, const ShadingContext& context, const LightArrays& lights)
 {
-    Color result;
-    glm::vec3 lightDir;
-    glm::vec3 half;
-    float diffuse;
-    float specular;
-    Color ambientColor = ambient;
-    Color diffuseColor;
-    Color specularColor;
-    glm::vec3 view = glm::normalize(view_pos - pos);
-
-    float diffuse_decay;
-    float specular_decay;
-    result = ambientColor;
-
-    specularExponent = specularExponent;
-    for (auto& light : lights)
-    {
-        // Calculate the light direction
-        lightDir = glm::normalize(light.pos - pos);
-
-        // Calculate the half vector
-        half = glm::normalize(lightDir + view);
-
-        // Calculate the diffuse term
-        diffuse = glm::max(glm::dot(normal, lightDir), 0.0f);
-
-        // Calculate the specular term
-        specular = glm::pow(glm::max(glm::dot(normal, half), 0.0f), specularExponent);
-
-        // Calculate the light decay
-        diffuse_decay = light.intensity / (glm::length(light.pos - pos) * glm::length(light.pos - pos));
-
-        // Calculate the diffuse term
-        diffuseColor = (diffuse_decay * diffuse) * light.color;
-
-        // Calculate the specular decay
-        specular_decay = light.intensity / (glm::length(light.pos - pos) * glm::length(light.pos - pos));
-
-        // Calculate the specular term
-        specularColor = (specular_decay * specular) * light.color;
-
-        // Calculate the final color
-        result = diffuseColor + specularColor + result;
-    }
-    return result;
+    // camera and material are gathered once per frame; see ShadingContext::Shade
+    return context.Shade(pos, normal, lights);
 }
 
 // TODO
 void Rasterizer::ShadeAtPixel(uint32_t x, uint32_t y, Triangle original, Triangle transformed, Image& image)
 {
 
-    // Calculate the barycentric coordinates of the pixel
-    Color result;
-    float depth;
-    
-    std::vector<Light> lights = this->loader.GetLights();
-    Color ambient = this->loader.GetAmbientColor();
-    float specularExponent = this->loader.GetSpecularExponent();
-    glm::vec3 cam_pos = this->loader.GetCamera().pos;
-
     if (IsPixelInsideTriangle(x + 0.5, y + 0.5, transformed))
     {
         glm::vec3 barycentric = BarycentricCoordinate(glm::vec2(x + 0.5, y + 0.5), transformed);           // Bug Fix: x + 0.5, y + 0.5, or the pixel will be at the top-left corner of the triangle
 
         // Calculate the original depth of the pixel
         // depth = glm::dot(barycentric, glm::vec3(original.pos[0].z, original.pos[1].z, original.pos[2].z));
-        depth = glm::dot(barycentric, glm::vec3(transformed.pos[0].z, transformed.pos[1].z, transformed.pos[2].z));
+        float depth = glm::dot(barycentric, glm::vec3(transformed.pos[0].z, transformed.pos[1].z, transformed.pos[2].z));
 
+        if (depth == this->ZBuffer.At(x, y))
+            image.Set(x, y, PackColor(ToneMapColor(this->ShadeFragment(x, y, barycentric, original), this->loader.GetToneMapping())));
+    }
+    return;
+}
 
-        if (depth == this->ZBuffer.Get(x, y))
-        {
-            // Calculate the normal of the pixel
-            glm::vec3 normal = CalculateNormal(barycentric, original);
+// Normal of the plane of the triangle, facing the side from which its vertices run counter-clockwise
+glm::vec3 CalculateFaceNormal(const Triangle& original)
+{
+    glm::vec3 a = glm::vec3(original.pos[0]);
+    glm::vec3 b = glm::vec3(original.pos[1]);
+    glm::vec3 c = glm::vec3(original.pos[2]);
+    return glm::normalize(glm::cross(b - a, c - a));
+}
 
-            glm::vec3 original_coords = CalculateCoordsWithBarycentric(barycentric, original.pos);
+glm::vec3 Rasterizer::ShadeFragment(uint32_t x, uint32_t y, glm::vec3 barycentric, const Triangle& original)
+{
+    return this->ShadeFragment<true>(x, y, barycentric, original);
+}
 
-            // glm::vec3 view_pos = glm::normalize(cam_pos);
+template<bool Normals>
+glm::vec3 Rasterizer::ShadeFragment(uint32_t x, uint32_t y, glm::vec3 barycentric, const Triangle& original)
+{
+    // Calculate the normal of the pixel, or take the triangle's own if the mesh has no normals
+    glm::vec3 normal;
+    if constexpr (Normals)
+        normal = CalculateNormal(barycentric, original);
+    else
+        normal = CalculateFaceNormal(original);
 
-            result = CalculateColor_BlinnPhong(original_coords, normal, cam_pos, lights, ambient, specularExponent);
+    glm::vec3 original_coords = CalculateCoordsWithBarycentric(barycentric, original.pos);
 
-            image.Set(x, y, result);
-        }
-    }
-    return;
+    const LightArrays& lights = this->lightGrid ? this->lightGrid->At(x, y) : this->shading.lights;
+    return CalculateColor_BlinnPhong(original_coords, normal, this->shading, lights);
 }
+
+template glm::vec3 Rasterizer::ShadeFragment<true>(uint32_t, uint32_t, glm::vec3, const Triangle&);
+template glm::vec3 Rasterizer::ShadeFragment<false>(uint32_t, uint32_t, glm::vec3, const Triangle&);
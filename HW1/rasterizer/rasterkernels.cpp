@@ -0,0 +1,302 @@
+#include "rasterkernels.hpp"
+
+#include <iostream>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define RASTER_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define RASTER_TARGET_AVX2
+    #else
+        #define RASTER_TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#else
+    #define RASTER_X86 0
+#endif
+
+static_assert(TriangleSetup::StepSpan == 8, "SIMD kernels assume 8 pixels per span");
+
+// Scalar reference
+
+template<bool Inside>
+static uint32_t DepthSpanScalar(const TriangleSetup& setup, uint32_t y, uint32_t xSpan, uint32_t xBegin, uint32_t xEnd, float* zrow)
+{
+    TriangleSetup::Edges edgesStart;
+    float depthStart;
+    setup.SpanStart(xSpan, y, edgesStart, depthStart);
+
+    uint32_t mask = 0;
+    for (uint32_t k = 0; k != TriangleSetup::StepSpan; ++k)
+    {
+        uint32_t x = xSpan + k;
+        if (x < xBegin || x >= xEnd || (!Inside && !setup.EdgesInSpan(edgesStart, k).Inside()))
+            continue;
+        float depth = setup.DepthInSpan(depthStart, k);
+        if (depth > zrow[x])
+        {
+            zrow[x] = depth;
+            mask |= 1u << k;
+        }
+    }
+    return mask;
+}
+
+template<bool Inside>
+static uint32_t VisibleSpanScalar(const TriangleSetup& setup, uint32_t y, uint32_t xSpan, uint32_t xBegin, uint32_t xEnd, const float* zrow)
+{
+    TriangleSetup::Edges edgesStart;
+    float depthStart;
+    setup.SpanStart(xSpan, y, edgesStart, depthStart);
+
+    uint32_t mask = 0;
+    for (uint32_t k = 0; k != TriangleSetup::StepSpan; ++k)
+    {
+        uint32_t x = xSpan + k;
+        if (x < xBegin || x >= xEnd)
+            continue;
+        if ((Inside || setup.EdgesInSpan(edgesStart, k).Inside()) && setup.DepthInSpan(depthStart, k) == zrow[x])
+            mask |= 1u << k;
+    }
+    return mask;
+}
+
+#if RASTER_X86
+
+// SSE2: edge values are stepped in 64-bit pairs, and the depths in two 4-wide halves per
+//  span. Spans that straddle [xBegin, xEnd) fall back to the scalar lanes, so that no memory
+//  outside the row range is touched.
+
+// Bit k is set if pixel k of the span is covered
+static inline uint32_t CoverageSse(const TriangleSetup& setup, const TriangleSetup::Edges& edgesStart)
+{
+    __m128i e[3], step[3];
+    for (int i = 0; i != 3; ++i)
+    {
+        int64_t s = setup.EdgeStep(i);
+        e[i] = _mm_set_epi64x(edgesStart.e[i] + s, edgesStart.e[i]);
+        step[i] = _mm_set1_epi64x(2 * s);
+    }
+
+    uint32_t outside = 0;
+    for (uint32_t k = 0; k != 8; k += 2)
+    {
+        // a lane is outside if any of its values is negative, i.e. has the sign bit set
+        __m128i any = _mm_or_si128(_mm_or_si128(e[0], e[1]), e[2]);
+        outside |= static_cast<uint32_t>(_mm_movemask_pd(_mm_castsi128_pd(any))) << k;
+        for (int i = 0; i != 3; ++i)
+            e[i] = _mm_add_epi64(e[i], step[i]);
+    }
+    return ~outside & 0xFFu;
+}
+
+// Lane j is all ones if bit j of `bits` is set
+static inline __m128 LaneMaskSse(uint32_t bits)
+{
+    const __m128i lanes = _mm_setr_epi32(1, 2, 4, 8);
+    return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<int>(bits)), lanes), lanes));
+}
+
+template<bool Inside>
+static uint32_t DepthSpanSse(const TriangleSetup& setup, uint32_t y, uint32_t xSpan, uint32_t xBegin, uint32_t xEnd, float* zrow)
+{
+    if (xSpan < xBegin || xSpan + 8 > xEnd)
+        return DepthSpanScalar<Inside>(setup, y, xSpan, xBegin, xEnd, zrow);
+
+    TriangleSetup::Edges edgesStart;
+    float depthStart;
+    setup.SpanStart(xSpan, y, edgesStart, depthStart);
+
+    uint32_t coverage = Inside ? 0xFFu : CoverageSse(setup, edgesStart);
+    uint32_t mask = 0;
+    for (uint32_t half = 0; half != 8; half += 4)
+    {
+        uint32_t bits = (coverage >> half) & 0xFu;
+        if (bits == 0)
+            continue;
+        const __m128 offsets = _mm_setr_ps(half + 0.f, half + 1.f, half + 2.f, half + 3.f);
+        __m128 covered = LaneMaskSse(bits);
+        __m128 depth = _mm_add_ps(_mm_set1_ps(depthStart), _mm_mul_ps(_mm_set1_ps(setup.dzdx), offsets));
+        __m128 stored = _mm_loadu_ps(zrow + xSpan + half);
+        __m128 closer = _mm_and_ps(covered, _mm_cmpgt_ps(depth, stored));
+        uint32_t closerMask = static_cast<uint32_t>(_mm_movemask_ps(closer));
+        if (closerMask == 0)
+            continue;
+        _mm_storeu_ps(zrow + xSpan + half, _mm_or_ps(_mm_and_ps(closer, depth), _mm_andnot_ps(closer, stored)));
+        mask |= closerMask << half;
+    }
+    return mask;
+}
+
+template<bool Inside>
+static uint32_t VisibleSpanSse(const TriangleSetup& setup, uint32_t y, uint32_t xSpan, uint32_t xBegin, uint32_t xEnd, const float* zrow)
+{
+    if (xSpan < xBegin || xSpan + 8 > xEnd)
+        return VisibleSpanScalar<Inside>(setup, y, xSpan, xBegin, xEnd, zrow);
+
+    TriangleSetup::Edges edgesStart;
+    float depthStart;
+    setup.SpanStart(xSpan, y, edgesStart, depthStart);
+
+    uint32_t coverage = Inside ? 0xFFu : CoverageSse(setup, edgesStart);
+    if (coverage == 0)
+        return 0;
+
+    uint32_t mask = 0;
+    for (uint32_t half = 0; half != 8; half += 4)
+    {
+        const __m128 offsets = _mm_setr_ps(half + 0.f, half + 1.f, half + 2.f, half + 3.f);
+        __m128 covered = LaneMaskSse((coverage >> half) & 0xFu);
+        __m128 depth = _mm_add_ps(_mm_set1_ps(depthStart), _mm_mul_ps(_mm_set1_ps(setup.dzdx), offsets));
+        __m128 visible = _mm_and_ps(covered, _mm_cmpeq_ps(depth, _mm_loadu_ps(zrow + xSpan + half)));
+        mask |= static_cast<uint32_t>(_mm_movemask_ps(visible)) << half;
+    }
+    return mask;
+}
+
+// AVX2: one 8-wide vector per span. Lanes outside [xBegin, xEnd) are masked off in
+//  the loads and stores, so partial spans never touch memory outside the row range.
+
+// Lane k is all ones if pixel k of the span is covered
+RASTER_TARGET_AVX2 static inline __m256i CoverageAvx2(const TriangleSetup& setup, const TriangleSetup::Edges& edgesStart)
+{
+    // edge values of pixels 0-3 and 4-7 in 64-bit lanes; a pixel is outside if any of its values is negative
+    __m256i low = _mm256_setzero_si256(), high = _mm256_setzero_si256();
+    for (int i = 0; i != 3; ++i)
+    {
+        int64_t e = edgesStart.e[i], s = setup.EdgeStep(i);
+        __m256i values = _mm256_setr_epi64x(e, e + s, e + 2 * s, e + 3 * s);
+        low = _mm256_or_si256(low, values);
+        high = _mm256_or_si256(high, _mm256_add_epi64(values, _mm256_set1_epi64x(4 * s)));
+    }
+    uint32_t outside = static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(low))) |
+                       static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(high))) << 4;
+
+    // spread bit k of the coverage to lane k
+    const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(~outside & 0xFFu)), lanes), lanes);
+}
+
+template<bool Inside>
+RASTER_TARGET_AVX2 static inline __m256 SpanMaskAvx2(const TriangleSetup& setup, const TriangleSetup::Edges& edgesStart,
+    uint32_t xSpan, uint32_t xBegin, uint32_t xEnd)
+{
+    __m256i covered = Inside ? _mm256_set1_epi32(-1) : CoverageAvx2(setup, edgesStart);
+
+    // xBegin - 1 < x < xEnd, compared as signed integers (all values are below 2^31)
+    __m256i x = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(xSpan)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i inRange = _mm256_and_si256(
+        _mm256_cmpgt_epi32(x, _mm256_set1_epi32(static_cast<int>(xBegin) - 1)),
+        _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(xEnd)), x));
+
+    return _mm256_castsi256_ps(_mm256_and_si256(covered, inRange));
+}
+
+template<bool Inside>
+RASTER_TARGET_AVX2 static uint32_t DepthSpanAvx2(const TriangleSetup& setup, uint32_t y, uint32_t xSpan, uint32_t xBegin, uint32_t xEnd, float* zrow)
+{
+    const __m256 offsets = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+    TriangleSetup::Edges edgesStart;
+    float depthStart;
+    setup.SpanStart(xSpan, y, edgesStart, depthStart);
+
+    __m256 mask = SpanMaskAvx2<Inside>(setup, edgesStart, xSpan, xBegin, xEnd);
+    if (_mm256_movemask_ps(mask) == 0)
+        return 0;
+
+    __m256 depth = _mm256_add_ps(_mm256_set1_ps(depthStart), _mm256_mul_ps(_mm256_set1_ps(setup.dzdx), offsets));
+    __m256 stored = _mm256_maskload_ps(zrow + xSpan, _mm256_castps_si256(mask));
+    __m256 closer = _mm256_and_ps(mask, _mm256_cmp_ps(depth, stored, _CMP_GT_OQ));
+    uint32_t closerMask = static_cast<uint32_t>(_mm256_movemask_ps(closer));
+    if (closerMask != 0)
+        _mm256_maskstore_ps(zrow + xSpan, _mm256_castps_si256(closer), depth);
+    return closerMask;
+}
+
+template<bool Inside>
+RASTER_TARGET_AVX2 static uint32_t VisibleSpanAvx2(const TriangleSetup& setup, uint32_t y, uint32_t xSpan, uint32_t xBegin, uint32_t xEnd, const float* zrow)
+{
+    const __m256 offsets = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+    TriangleSetup::Edges edgesStart;
+    float depthStart;
+    setup.SpanStart(xSpan, y, edgesStart, depthStart);
+
+    __m256 mask = SpanMaskAvx2<Inside>(setup, edgesStart, xSpan, xBegin, xEnd);
+    if (_mm256_movemask_ps(mask) == 0)
+        return 0;
+
+    __m256 depth = _mm256_add_ps(_mm256_set1_ps(depthStart), _mm256_mul_ps(_mm256_set1_ps(setup.dzdx), offsets));
+    __m256 stored = _mm256_maskload_ps(zrow + xSpan, _mm256_castps_si256(mask));
+    __m256 visible = _mm256_and_ps(mask, _mm256_cmp_ps(depth, stored, _CMP_EQ_OQ));
+    return static_cast<uint32_t>(_mm256_movemask_ps(visible));
+}
+
+#endif
+
+// Rows are walked span by span with the span kernel of each level
+template<uint32_t (*DepthSpan)(const TriangleSetup&, uint32_t, uint32_t, uint32_t, uint32_t, float*)>
+static bool DepthRow(const TriangleSetup& setup, uint32_t y, uint32_t xBegin, uint32_t xEnd, float* zrow)
+{
+    uint32_t written = 0;
+    for (uint32_t xSpan = xBegin & ~(TriangleSetup::StepSpan - 1); xSpan < xEnd; xSpan += TriangleSetup::StepSpan)
+        written |= DepthSpan(setup, y, xSpan, xBegin, xEnd, zrow);
+    return written != 0;
+}
+
+SimdLevel DetectSimdLevel()
+{
+#if RASTER_X86
+    #if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] >= 7)
+        {
+            __cpuidex(info, 7, 0);
+            bool avx2 = (info[1] & (1 << 5)) != 0;
+            __cpuid(info, 1);
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            if (avx2 && osxsave && (_xgetbv(0) & 0x6) == 0x6)
+                return SimdLevel::AVX2;
+        }
+        return SimdLevel::SSE;
+    #else
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse2"))
+            return SimdLevel::SSE;
+        return SimdLevel::SCALAR;
+    #endif
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+const RasterKernels& GetRasterKernels(SimdLevel level)
+{
+    static const RasterKernels scalar{ SimdLevel::SCALAR, DepthRow<DepthSpanScalar<false>>, DepthSpanScalar<false>, VisibleSpanScalar<false>,
+        DepthSpanScalar<true>, VisibleSpanScalar<true> };
+#if RASTER_X86
+    static const RasterKernels sse{ SimdLevel::SSE, DepthRow<DepthSpanSse<false>>, DepthSpanSse<false>, VisibleSpanSse<false>,
+        DepthSpanSse<true>, VisibleSpanSse<true> };
+    static const RasterKernels avx2{ SimdLevel::AVX2, DepthRow<DepthSpanAvx2<false>>, DepthSpanAvx2<false>, VisibleSpanAvx2<false>,
+        DepthSpanAvx2<true>, VisibleSpanAvx2<true> };
+#endif
+    static const SimdLevel detected = DetectSimdLevel();
+
+    if (level == SimdLevel::AUTO)
+        level = detected;
+    else if (static_cast<int>(level) > static_cast<int>(detected))
+    {
+        std::cout << "[WARNING] requested SIMD level is not supported by this CPU, falling back\n";
+        level = detected;
+    }
+
+#if RASTER_X86
+    if (level == SimdLevel::AVX2)
+        return avx2;
+    if (level == SimdLevel::SSE)
+        return sse;
+#endif
+    return scalar;
+}
@@ -0,0 +1,49 @@
+#ifndef RASTERKERNELS_H
+#define RASTERKERNELS_H
+
+#include <cstdint>
+
+#include "loader.hpp"
+#include "trianglesetup.hpp"
+
+// Row kernels of the depth and shading passes, evaluating the pixels of a
+//  TriangleSetup::StepSpan wide span at once. Every implementation produces
+//  bit-identical results to the scalar reference (TriangleSetup::ForEachInRow),
+//  and the implementation is picked at runtime from the instruction sets of the CPU.
+struct RasterKernels
+{
+    SimdLevel level;
+
+    /**
+     * Depth-test the covered pixel centers of row y in [xBegin, xEnd), storing the depth
+     * into the ZBuffer wherever it is nearer (greater) than the stored one.
+     * @param zrow: pointer to column 0 of row y of the ZBuffer
+     * @return: whether any depth was stored
+     */
+    bool (*DepthRow)(const TriangleSetup& setup, uint32_t y, uint32_t xBegin, uint32_t xEnd, float* zrow);
+
+    /**
+     * Depth-test the span starting at column xSpan (a multiple of StepSpan) of row y, as DepthRow does.
+     * @return: bit k is set if the depth of pixel xSpan + k was stored
+     */
+    uint32_t (*DepthSpan)(const TriangleSetup& setup, uint32_t y, uint32_t xSpan, uint32_t xBegin, uint32_t xEnd, float* zrow);
+
+    /**
+     * Find the visible pixels in the span starting at column xSpan (a multiple of StepSpan) of row y.
+     * @return: bit k is set if pixel xSpan + k is covered, inside [xBegin, xEnd), and its depth equals the ZBuffer
+     */
+    uint32_t (*VisibleSpan)(const TriangleSetup& setup, uint32_t y, uint32_t xSpan, uint32_t xBegin, uint32_t xEnd, const float* zrow);
+
+    // DepthSpan and VisibleSpan for spans whose pixel centers in [xBegin, xEnd) are all known to be
+    //  covered (BlockCoverage::INSIDE), skipping the edge tests
+    uint32_t (*DepthSpanInside)(const TriangleSetup& setup, uint32_t y, uint32_t xSpan, uint32_t xBegin, uint32_t xEnd, float* zrow);
+    uint32_t (*VisibleSpanInside)(const TriangleSetup& setup, uint32_t y, uint32_t xSpan, uint32_t xBegin, uint32_t xEnd, const float* zrow);
+};
+
+// The best level supported by the running CPU
+SimdLevel DetectSimdLevel();
+
+// Kernels for the requested level. AUTO, or a level the CPU does not support, gives the detected one
+const RasterKernels& GetRasterKernels(SimdLevel level = SimdLevel::AUTO);
+
+#endif
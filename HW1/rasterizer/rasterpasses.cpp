@@ -0,0 +1,288 @@
+#include "rasterpasses.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "binner.hpp"
+#include "rasterizer.hpp"
+#include "samplepattern.hpp"
+#include "trianglesetup.hpp"
+
+// Sample count of the anti-aliased passes compiled for no particular count, which read it from the pattern
+static constexpr uint32_t DynamicSpp = 0;
+
+RasterMode GetRasterMode(const Loader& loader)
+{
+    RasterMode mode;
+    mode.type = loader.GetType();
+    if ((mode.type == TestType::TRIANGLE || mode.type == TestType::SHADING) && loader.GetAntiAliasConfig() != AntiAliasConfig::NONE)
+    {
+        mode.antiAlias = loader.GetAntiAliasConfig();
+        mode.spp = loader.GetSpp();
+    }
+    if (mode.type == TestType::SHADING)
+    {
+        mode.shading = loader.GetShadingMode();
+        mode.normals = (loader.GetMesh().GetNormalCount() > 0);
+    }
+    return mode;
+}
+
+// Coverage of one triangle, with the sample loop unrolled for a fixed sample count.
+//  `samplePattern` is only read with anti-aliasing.
+template<AntiAliasConfig AntiAlias, uint32_t Spp>
+static void CoverPrimitive(Rasterizer& rasterizer, Image& image, const Triangle& trig, const SamplePattern* samplePattern,
+    Color color, const TileRect& tile)
+{
+    TileRect box;
+    if (!ClampedBoundingBox(trig, tile, box))
+        return;
+
+    TriangleSetup setup(trig);
+    if (!setup.valid)
+        return;
+
+    // Blocks outside the triangle are skipped and blocks inside it are filled without edge tests
+    if constexpr (AntiAlias == AntiAliasConfig::NONE)
+    {
+        setup.ForEachBlock(box, false, [&](const TileRect& block, BlockCoverage coverage)
+        {
+            for (uint32_t y = block.y0; y < block.y1; ++y)
+            {
+                if (coverage == BlockCoverage::INSIDE)
+                {
+                    Color* row = image.Row(y);
+                    std::fill(row + block.x0, row + block.x1, color);
+                }
+                else
+                {
+                    setup.ForEachInRow(y, block.x0, block.x1, [&](uint32_t x, const TriangleSetup::Edges&, float)
+                    {
+                        image.At(x, y) = color;
+                    });
+                }
+            }
+        });
+    }
+    else
+    {
+        const SamplePattern& samples = *samplePattern;
+        const uint32_t count = (Spp == DynamicSpp) ? samples.Count() : Spp;
+        setup.ForEachBlock(box, true, [&](const TileRect& block, BlockCoverage coverage)
+        {
+            for (uint32_t y = block.y0; y < block.y1; ++y)
+                for (uint32_t x = block.x0; x < block.x1; ++x)
+                {
+                    uint32_t covered = count, mask = samples.FullMask();
+                    if (coverage == BlockCoverage::PARTIAL)
+                    {
+                        covered = mask = 0;
+                        for (uint32_t i = 0; i < count; ++i)
+                        {
+                            if (setup.Covers(x + samples[i].x, y + samples[i].y))
+                            {
+                                ++covered;
+                                mask |= 1u << (i & 31);
+                            }
+                        }
+                    }
+
+                    // SSAA: a pixel covered by every sample shows this triangle alone; partial coverage is
+                    //  added to what the pixel holds, so the triangles sharing an edge sum to full coverage
+                    if constexpr (AntiAlias == AntiAliasConfig::SSAA)
+                    {
+                        if (covered == count)
+                            image.At(x, y) = color;
+                        else if (covered != 0)
+                            image.At(x, y) = image.At(x, y) + color * (static_cast<float>(covered) / count);
+                    }
+                    else
+                        rasterizer.StoreMultisample(x, y, mask, image, color);
+                }
+        });
+    }
+}
+
+template<AntiAliasConfig AntiAlias, uint32_t Spp>
+static void CoveragePass(Rasterizer& rasterizer, const RasterTargets& targets, const std::vector<uint32_t>& bin, const TileRect& tile)
+{
+    for (uint32_t i : bin)
+        CoverPrimitive<AntiAlias, Spp>(rasterizer, targets.image, targets.transformed[i], rasterizer.samplePattern, Color::White, tile);
+    if constexpr (AntiAlias == AntiAliasConfig::MSAA)
+        rasterizer.ResolveMultisample(targets.image, tile);
+}
+
+void CoverPrimitive(Rasterizer& rasterizer, Image& image, const Triangle& trig, AntiAliasConfig config, uint32_t spp,
+    Color color, const TileRect& tile)
+{
+    switch (config)
+    {
+    case AntiAliasConfig::SSAA:
+        CoverPrimitive<AntiAliasConfig::SSAA, DynamicSpp>(rasterizer, image, trig, &rasterizer.GetSamplePattern(spp), color, tile);
+        break;
+    case AntiAliasConfig::MSAA:
+        CoverPrimitive<AntiAliasConfig::MSAA, DynamicSpp>(rasterizer, image, trig, &rasterizer.GetSamplePattern(spp), color, tile);
+        break;
+    default:
+        CoverPrimitive<AntiAliasConfig::NONE, 1>(rasterizer, image, trig, nullptr, color, tile);
+        break;
+    }
+}
+
+static void DepthPass(Rasterizer& rasterizer, const RasterTargets& targets, const std::vector<uint32_t>& bin, const TileRect& tile)
+{
+    for (uint32_t i : bin)
+        rasterizer.DrawPrimitiveDepth(targets.transformed[i], rasterizer.ZBuffer, tile);
+}
+
+// one raster pass records the nearest triangle per pixel
+static void VisibilityPass(Rasterizer& rasterizer, const RasterTargets& targets, const std::vector<uint32_t>& bin, const TileRect& tile)
+{
+    targets.visibility.Clear(tile);
+    for (uint32_t i : bin)
+        rasterizer.DrawPrimitiveVisibility(targets.transformed[i], i, targets.visibility, tile);
+}
+
+template<bool Normals>
+static void ShadedPass(Rasterizer& rasterizer, const RasterTargets& targets, const std::vector<uint32_t>& bin, const TileRect& tile)
+{
+    for (uint32_t i : bin)
+        rasterizer.DrawPrimitiveShaded<Normals>(targets.transformed[i], targets.original[i], targets.hdr, tile);
+}
+
+// every covered pixel is shaded once
+template<bool Normals>
+static void ResolvePass(Rasterizer& rasterizer, const RasterTargets& targets, const std::vector<uint32_t>&, const TileRect& tile)
+{
+    rasterizer.ResolveVisibility<Normals>(targets.visibility, targets.original, targets.hdr, tile);
+}
+
+// MSAA shading: depth, and the nearest triangle, at every sample; each pixel is shaded once per triangle
+//  owning some of its samples, and the samples are averaged into the pixel
+
+static void DepthPassMultisample(Rasterizer& rasterizer, const RasterTargets& targets, const std::vector<uint32_t>& bin, const TileRect& tile)
+{
+    for (uint32_t i : bin)
+        rasterizer.DrawPrimitiveDepthMultisample(targets.transformed[i], tile);
+}
+
+static void VisibilityPassMultisample(Rasterizer& rasterizer, const RasterTargets& targets, const std::vector<uint32_t>& bin, const TileRect& tile)
+{
+    const uint32_t spp = rasterizer.samplePattern->Count();
+    targets.visibility.Clear({ tile.x0 * spp, tile.y0, tile.x1 * spp, tile.y1 });
+    for (uint32_t i : bin)
+        rasterizer.DrawPrimitiveVisibilityMultisample(targets.transformed[i], i, targets.visibility, tile);
+}
+
+template<bool Normals>
+static void ShadedPassMultisample(Rasterizer& rasterizer, const RasterTargets& targets, const std::vector<uint32_t>& bin, const TileRect& tile)
+{
+    for (uint32_t i : bin)
+        rasterizer.DrawPrimitiveShadedMultisample<Normals>(targets.transformed[i], targets.original[i], tile);
+    rasterizer.ResolveShadedMultisample(targets.hdr, tile);
+}
+
+template<bool Normals>
+static void ResolvePassMultisample(Rasterizer& rasterizer, const RasterTargets& targets, const std::vector<uint32_t>&, const TileRect& tile)
+{
+    rasterizer.ResolveVisibilityMultisample<Normals>(targets.visibility, targets.original, targets.hdr, tile);
+}
+
+// The passes of one mode. Combinations that no task produces do not compile.
+template<TestType Type, AntiAliasConfig AntiAlias = AntiAliasConfig::NONE, uint32_t Spp = 1,
+    ShadingMode Shading = ShadingMode::FORWARD, bool Normals = false>
+static RasterPasses MakePasses()
+{
+    constexpr bool coverage = (Type == TestType::TRIANGLE || Type == TestType::TRANSFORM);
+    static_assert(coverage || Type == TestType::SHADING_DEPTH || Type == TestType::SHADING, "transform tests are not rasterized");
+    constexpr bool multisampled = (Type == TestType::SHADING && AntiAlias == AntiAliasConfig::MSAA);
+    static_assert(AntiAlias == AntiAliasConfig::NONE || coverage || multisampled, "only coverage tasks and MSAA shading are anti-aliased");
+    static_assert((AntiAlias == AntiAliasConfig::NONE) == (Spp == 1), "a fixed sample count needs anti-aliasing, and anti-aliasing more than one sample");
+    static_assert(!multisampled || Spp == DynamicSpp, "MSAA shading reads the sample count from the pattern");
+    static_assert(Spp <= 32, "MSAA masks hold at most 32 samples");
+    static_assert(Shading == ShadingMode::FORWARD || Type == TestType::SHADING, "only shading tasks have a shading mode");
+    static_assert(!Normals || Type == TestType::SHADING, "only shading tasks read normals");
+
+    if constexpr (coverage)
+        return { nullptr, CoveragePass<AntiAlias, Spp> };
+    else if constexpr (Type == TestType::SHADING_DEPTH)
+        return { DepthPass, nullptr };
+    else if constexpr (multisampled && Shading == ShadingMode::VISIBILITY)
+        return { VisibilityPassMultisample, ResolvePassMultisample<Normals> };
+    else if constexpr (multisampled)
+        return { DepthPassMultisample, ShadedPassMultisample<Normals> };
+    else if constexpr (Shading == ShadingMode::VISIBILITY)
+        return { VisibilityPass, ResolvePass<Normals> };
+    else
+        return { DepthPass, ShadedPass<Normals> };
+}
+
+// Anti-aliased coverage passes, with common sample counts compiled in
+template<TestType Type, AntiAliasConfig AntiAlias>
+static const RasterPasses& GetCoveragePasses(uint32_t spp)
+{
+    static const RasterPasses spp2 = MakePasses<Type, AntiAlias, 2>();
+    static const RasterPasses spp4 = MakePasses<Type, AntiAlias, 4>();
+    static const RasterPasses spp8 = MakePasses<Type, AntiAlias, 8>();
+    static const RasterPasses spp16 = MakePasses<Type, AntiAlias, 16>();
+    static const RasterPasses dynamic = MakePasses<Type, AntiAlias, DynamicSpp>();
+
+    switch (spp)
+    {
+    case 2: return spp2;
+    case 4: return spp4;
+    case 8: return spp8;
+    case 16: return spp16;
+    default: return dynamic;
+    }
+}
+
+template<TestType Type>
+static const RasterPasses& GetCoveragePasses(AntiAliasConfig antiAlias, uint32_t spp)
+{
+    static const RasterPasses none = MakePasses<Type>();
+
+    switch (antiAlias)
+    {
+    case AntiAliasConfig::SSAA: return GetCoveragePasses<Type, AntiAliasConfig::SSAA>(spp);
+    case AntiAliasConfig::MSAA: return GetCoveragePasses<Type, AntiAliasConfig::MSAA>(spp);
+    default: return none;
+    }
+}
+
+const RasterPasses& GetRasterPasses(const RasterMode& mode)
+{
+    static const RasterPasses transform = MakePasses<TestType::TRANSFORM>();
+    static const RasterPasses depth = MakePasses<TestType::SHADING_DEPTH>();
+    static const RasterPasses forward = MakePasses<TestType::SHADING, AntiAliasConfig::NONE, 1, ShadingMode::FORWARD, true>();
+    static const RasterPasses forwardFlat = MakePasses<TestType::SHADING, AntiAliasConfig::NONE, 1, ShadingMode::FORWARD, false>();
+    static const RasterPasses visibility = MakePasses<TestType::SHADING, AntiAliasConfig::NONE, 1, ShadingMode::VISIBILITY, true>();
+    static const RasterPasses visibilityFlat = MakePasses<TestType::SHADING, AntiAliasConfig::NONE, 1, ShadingMode::VISIBILITY, false>();
+    static const RasterPasses forwardMsaa = MakePasses<TestType::SHADING, AntiAliasConfig::MSAA, DynamicSpp, ShadingMode::FORWARD, true>();
+    static const RasterPasses forwardFlatMsaa = MakePasses<TestType::SHADING, AntiAliasConfig::MSAA, DynamicSpp, ShadingMode::FORWARD, false>();
+    static const RasterPasses visibilityMsaa = MakePasses<TestType::SHADING, AntiAliasConfig::MSAA, DynamicSpp, ShadingMode::VISIBILITY, true>();
+    static const RasterPasses visibilityFlatMsaa = MakePasses<TestType::SHADING, AntiAliasConfig::MSAA, DynamicSpp, ShadingMode::VISIBILITY, false>();
+
+    switch (mode.type)
+    {
+    case TestType::TRIANGLE:
+        return GetCoveragePasses<TestType::TRIANGLE>(mode.antiAlias, mode.spp);
+    case TestType::TRANSFORM:
+        return transform;
+    case TestType::SHADING_DEPTH:
+        return depth;
+    case TestType::SHADING:
+        if (mode.antiAlias == AntiAliasConfig::MSAA)
+        {
+            if (mode.shading == ShadingMode::VISIBILITY)
+                return mode.normals ? visibilityMsaa : visibilityFlatMsaa;
+            return mode.normals ? forwardMsaa : forwardFlatMsaa;
+        }
+        if (mode.shading == ShadingMode::VISIBILITY)
+            return mode.normals ? visibility : visibilityFlat;
+        return mode.normals ? forward : forwardFlat;
+    default:
+        throw std::runtime_error("no raster passes for task " + std::to_string(static_cast<int>(mode.type)));
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef RASTERPASSES_H
+#define RASTERPASSES_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entities.hpp"
+#include "image.hpp"
+#include "loader.hpp"
+#include "visibilitybuffer.hpp"
+
+class Rasterizer;
+
+// The settings that change what the raster loops do, fixed for a whole frame. Settings that
+//  a task ignores are reset to their defaults, so equal modes always rasterize the same way.
+struct RasterMode
+{
+    TestType type = TestType::TRIANGLE;
+    AntiAliasConfig antiAlias = AntiAliasConfig::NONE;
+    uint32_t spp = 1;                               // samples per pixel, 1 without anti-aliasing
+    ShadingMode shading = ShadingMode::FORWARD;
+    bool normals = false;                           // shade with vertex normals, or with face normals if the mesh has none
+};
+
+// The mode of the loader's task and mesh
+RasterMode GetRasterMode(const Loader& loader);
+
+// What the raster passes of a frame read and write
+struct RasterTargets
+{
+    const std::vector<Triangle>& transformed;       // screen space
+    const std::vector<Triangle>& original;          // model space, same order
+    Image& image;
+    ImageHDR& hdr;
+    VisibilityBuffer& visibility;
+};
+
+/**
+ * A raster pass over one tile.
+ * @param bin: indices into the triangle lists of `targets`, in submission order
+ * @param tile: the pixels the pass may touch
+ */
+using TilePass = void (*)(Rasterizer& rasterizer, const RasterTargets& targets, const std::vector<uint32_t>& bin, const TileRect& tile);
+
+// The passes of one raster mode, each compiled for that mode alone: the task, anti-aliasing mode,
+//  sample count, shading mode and normals are template parameters, so the loops over triangles,
+//  pixels and samples carry no branch on them. Unused passes are null.
+struct RasterPasses
+{
+    TilePass depth;         // depth or visibility, run on every tile before any color
+    TilePass color;         // coverage or shading
+};
+
+// The passes for `mode`, picked once per frame
+const RasterPasses& GetRasterPasses(const RasterMode& mode);
+
+// Coverage of one triangle within `tile`, as the coverage passes draw it but with the mode picked at
+//  run time. MSAA samples stay in the rasterizer's SampleMask and SampleColor until ResolveMultisample.
+void CoverPrimitive(Rasterizer& rasterizer, Image& image, const Triangle& trig, AntiAliasConfig config, uint32_t spp,
+    Color color, const TileRect& tile);
+
+#endif
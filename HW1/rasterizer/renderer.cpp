@@ -1,11 +1,29 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
 #include <string>
 
+#include "binner.hpp"
+#include "clipper.hpp"
+#include "culler.hpp"
+#include "encodequeue.hpp"
 #include "image.hpp"
+#include "imagewriter.hpp"
+#include "lightgrid.hpp"
 #include "loader.hpp"
+#include "lod.hpp"
 #include "rasterizer.hpp"
+#include "rasterpasses.hpp"
 #include "renderer.hpp"
+#include "threadpool.hpp"
+#include "tonemap.hpp"
+#include "vertexcache.hpp"
 
 void PrintTask(const Loader& loader)
 {
@@ -27,6 +45,13 @@ void PrintTaskTriangle(const Triangle& trig)
     std::cout << msg;
 }
 
+void PrintCullStats(const CullStats& stats)
+{
+    std::cout << "Culled " << stats.Culled() << " of " << stats.submitted << " triangles ("
+        << stats.backface << " back-face, " << stats.frustum << " frustum, " << stats.small << " small), "
+        << stats.passed << " rasterized\n";
+}
+
 void PrintTaskTransformTest(const glm::vec3 input, const glm::vec4 output, const glm::vec3 expected)
 {
     std::string sephead = "===============Task: Transform Test===============\n";
@@ -41,6 +66,77 @@ void PrintTaskTransformTest(const glm::vec3 input, const glm::vec4 output, const
     std::cout << msg;
 }
 
+// Hand the first `rows` rows of a band to the writer, top row first, as buffers store rows bottom-up
+static void WriteBand(ImageWriter& writer, const Image& band, uint32_t rows)
+{
+    for (uint32_t y = rows; y-- > 0; )
+        writer.WriteRow(band.Row(y));
+}
+
+// Depth bands are converted to grey before they are written
+static void DepthToGrey(const ImageGrey& depth, Image& band, uint32_t rows)
+{
+    for (uint32_t y = 0; y < rows; ++y)
+    {
+        const float* from = depth.Row(y);
+        Color* to = band.Row(y);
+        for (uint32_t x = 0; x < depth.GetWidth(); ++x)
+            to[x] = GreyColor(from[x]);
+    }
+}
+
+// Load the model matrices and the camera of the loader's current frame into the rasterizer,
+//  and return the matrix taking world space to screen space
+static glm::mat4 SetupFrame(Rasterizer& rasterizer, const Loader& loader)
+{
+    rasterizer.model.clear();
+    if (loader.GetType() == TestType::TRIANGLE)
+    {
+        // notice that glm::mat4x4 is column-major, so the actual matrix is the transpose of the matrix read off
+        uint32_t halfWidth = loader.GetWidth() / 2;
+        uint32_t halfHeight = loader.GetHeight() / 2;
+        rasterizer.model.push_back(glm::mat4x4(1.0f));      // Add an identity model matrix to avoid special judgement below
+        return glm::mat4x4{
+            halfWidth, 0         , 0, 0,
+            0        , halfHeight, 0, 0, 
+            0        , 0         , 0, 0,             // discard z values
+            halfWidth, halfHeight, 0, 1
+        };
+    }
+
+    // First load the matrices to the rasterizer
+    for (size_t index = 0; index != loader.GetTransforms().size(); ++index)
+    {
+        MeshTransform transform = loader.GetTransforms()[index];
+        rasterizer.AddModel(transform);
+    }
+
+    rasterizer.SetView();
+    rasterizer.SetProjection();
+    rasterizer.SetScreenSpace();
+    if (loader.GetType() == TestType::SHADING)
+        rasterizer.shading.cameraPos = loader.GetCamera().pos;
+
+    // Compose the matrices
+    return rasterizer.screenspace * rasterizer.projection * rasterizer.view;
+}
+
+// The triangles one shape leaves after clipping and culling
+struct RendererShapeTriangles
+{
+    std::vector<Triangle> transformed;
+    std::vector<Triangle> original;
+};
+
+// Milliseconds elapsed since `start`, which is then moved to now
+static double Lap(std::chrono::steady_clock::time_point& start)
+{
+    auto now = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(now - start).count();
+    start = now;
+    return ms;
+}
+
 void Renderer::Render(int argc, char** argv)
 {
     std::string modelName;
@@ -49,59 +145,39 @@ void Renderer::Render(int argc, char** argv)
     if (argc != 1)
     {
         yamlConfigName = argv[1];
-        std::cout << "using customized config name" << yamlConfigName << std::endl;
+        if (this->verbose)
+            std::cout << "using customized config name" << yamlConfigName << std::endl;
     }
 
+    this->stats = RenderStats();
+    auto clock = std::chrono::steady_clock::now();
+
     Loader loader(yamlConfigName);
     bool success = loader.Load();
 
     if (success)
     {
-        PrintTask(loader);
-        Image image(loader.GetWidth(), loader.GetHeight(), loader.GetOutputName());
-
-        Rasterizer rasterizer(loader);
-
-        glm::mat4x4 viewxprojection{
-            1, 0, 0, 0,
-            0, 1, 0, 0,
-            0, 0, 1, 0,
-            0, 0, 0, 1
-        };
+        if (this->verbose)
+            PrintTask(loader);
+        // Frames are rendered in horizontal bands of at most `bandHeight` rows, every buffer sized to a band;
+        //  the vertex stage runs once per frame. Without a strip height there is one band, the whole frame.
+        const uint32_t width = loader.GetWidth();
+        const uint32_t height = loader.GetHeight();
+        const uint32_t bandHeight = (loader.GetStripHeight() == 0) ? height : std::min(loader.GetStripHeight(), height);
 
-        if (loader.GetType() == TestType::TRIANGLE)
-        {
-            // notice that glm::mat4x4 is column-major, so the actual matrix is the transpose of the matrix read off
-            uint32_t halfWidth = loader.GetWidth() / 2;
-            uint32_t halfHeight = loader.GetHeight() / 2;
-            viewxprojection = glm::mat4x4{
-                halfWidth, 0         , 0, 0,
-                0        , halfHeight, 0, 0, 
-                0        , 0         , 0, 0,             // discard z values
-                halfWidth, halfHeight, 0, 1
-            };
-            rasterizer.model.push_back(glm::mat4x4(1.0f));      // Add an identity model matrix to avoid special judgement below
-        }
-        else
-        {
-            // First load the matrices to the rasterizer
-            for (size_t index = 0; index != loader.GetTransforms().size(); ++index)
-            {
-                MeshTransform transform = loader.GetTransforms()[index];
-                rasterizer.AddModel(transform);
-            }
+        // Shading accumulates linear light in float, and is packed into an Image once before writing
+        bool shading = (loader.GetType() == TestType::SHADING);
+        ImageHDR hdr(shading ? width : 0, shading ? bandHeight : 0, loader.GetOutputName());
+        const glm::vec4 background = glm::vec4(Color::Black.r, Color::Black.g, Color::Black.b, Color::Black.a) / 255.f;
 
-            rasterizer.SetView();
-            rasterizer.SetProjection();
-            rasterizer.SetScreenSpace();
+        // Meshes and buffers are loaded once and reused by every frame of an animation
+        Rasterizer rasterizer(loader, width, bandHeight);
+        this->stats.load = Lap(clock);
 
-            // Compose the matrices
-            viewxprojection = rasterizer.screenspace * rasterizer.projection * rasterizer.view;
-        }
-        
         // If this is test on transforms, then do not need to iterate over the meshes
         if (loader.GetType() == TestType::TRANSFORM_TEST)
         {
+            glm::mat4 viewxprojection = SetupFrame(rasterizer, loader);
             glm::vec3 input = loader.GetTestInput();
             glm::vec3 expected = loader.GetTestExpected();
             glm::vec4 input4(input, 1);
@@ -111,94 +187,235 @@ void Renderer::Render(int argc, char** argv)
 
             glm::vec4 output = viewxprojection * rasterizer.model[0] * input4;
             PrintTaskTransformTest(input, output, expected);
+            return;
         }
-        else 
+
+        // Every band is handed to the output stage as soon as it is drawn. Animations encode on a thread
+        //  of their own, with half of the threads, so that frame k + 1 is rendered while frame k is encoded;
+        //  bands then alternate between two images, one being drawn while the other is encoded.
+        ThreadPool pool;
+        const uint32_t frames = loader.GetFrameCount();
+        const bool pipelined = (frames > 1);
+        std::optional<ThreadPool> encodePool;
+        if (pipelined)
+            encodePool.emplace(std::max<size_t>(1, pool.GetThreadCount() / 2));
+        ThreadPool& writerPool = pipelined ? encodePool.value() : pool;
+
+        std::vector<Image> images;
+        for (size_t i = 0; i < (pipelined ? 2u : 1u); ++i)
+            images.emplace_back(width, bandHeight, loader.GetOutputName());
+        size_t bandCount = 0;
+
+        // declared last so that its jobs finish before anything they use is destroyed
+        EncodeQueue queue(pipelined);
+
+        const Mesh& mesh = loader.GetMesh();
+        const std::vector<MeshShape>& shapes = mesh.GetShapes();
+
+        TestType type = loader.GetType();
+        bool deferred = (type == TestType::SHADING && loader.GetShadingMode() == ShadingMode::VISIBILITY);
+
+        // MSAA shading keeps a depth, and a visibility entry, per sample
+        const uint32_t samples = (type == TestType::SHADING && loader.GetAntiAliasConfig() == AntiAliasConfig::MSAA) ? loader.GetSpp() : 1;
+        VisibilityBuffer visibility(deferred ? width * samples : 0, deferred ? bandHeight : 0);
+
+        // One vertex cache per thread of the vertex stage, and the triangles of every shape
+        const size_t vertexWorkers = std::min(pool.GetThreadCount(), std::max<size_t>(shapes.size(), 1));
+        std::vector<VertexCache> vertexCaches(vertexWorkers, VertexCache(GetVertexKernels(loader.GetSimdLevel())));
+        std::vector<RendererShapeTriangles> shapeTrigs(vertexWorkers > 1 ? shapes.size() : 0);
+
+        for (uint32_t frame = 0; frame < frames; ++frame)
         {
-            auto& shapes = loader.GetShapes();
-            auto& attribs = loader.GetAttribs();
+            loader.SetFrame(frame);
+            const glm::mat4 viewxprojection = SetupFrame(rasterizer, loader);
 
-            if (loader.GetType() == TestType::SHADING_DEPTH || loader.GetType() == TestType::SHADING)
-                rasterizer.InitZBuffer(rasterizer.ZBuffer);
+            // The raster loops of the frame are compiled for its task and anti-aliasing mode
+            const RasterPasses& passes = GetRasterPasses(GetRasterMode(loader));
+            std::shared_ptr<ImageWriter> writer = ImageWriter::Open(loader.GetOutputName(frame), loader.GetOutputFormat(),
+                loader.GetPngLevel(), width, height, writerPool);
 
             std::vector<Triangle> transformedTrigs;
             std::vector<Triangle> originalTrigs;
-            
-            const size_t fv = 3;
-            for (size_t s = 0; s < shapes.size(); s++) 
+
+            // Vertex stage: transform every face of every shape to screen space, once for the whole frame.
+            //  The guard band is as large as the viewport itself on every side.
+            float guardBand = static_cast<float>(std::max(width, height));
+            Clipper clipper(width, height, loader.GetType() != TestType::TRIANGLE,
+                loader.GetCamera().nearClip, guardBand);
+            std::vector<Culler> cullers(vertexWorkers, Culler(loader.GetCullConfig(), width, height,
+                loader.GetType() != TestType::TRIANGLE, loader.GetAntiAliasConfig() != AntiAliasConfig::NONE));
+
+            // Each shape is drawn at the coarsest level of detail whose error stays within the threshold
+            LodSelector lod(loader.GetLodThreshold(), loader.GetType() != TestType::TRIANGLE, loader.GetCamera().nearClip);
+
+            // Shapes are handed out one at a time to workers with a vertex cache and a culler of their own.
+            //  With several workers each shape keeps its triangles apart, and they are joined in shape order
+            //  afterwards, so the result does not depend on the thread count; a single worker appends directly.
+            const bool joined = (vertexWorkers > 1);
+            std::atomic<size_t> nextShape{ 0 };
+            pool.ParallelFor(vertexWorkers, [&](size_t worker)
             {
-                if (loader.GetType() == TestType::SHADING)
+                VertexCache& vertices = vertexCaches[worker];
+                Culler& culler = cullers[worker];
+                for (size_t s = nextShape++; s < shapes.size(); s = nextShape++)
                 {
-                    transformedTrigs.clear();
-                    originalTrigs.clear();
-                    transformedTrigs.reserve(shapes.size());
-                    originalTrigs.reserve(shapes.size());
-                }
+                    // init to identity so that the program will no crash even without model matrices being added
+                    glm::mat4 modelMat = glm::mat4(1.f);
+                    if (rasterizer.model.size() > s)
+                        modelMat = rasterizer.model[s];
 
-                // Loop over faces(polygon)
-                size_t index_offset = 0;
-                for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) 
-                {
-                    // Loop over vertices in the face.
-                    Triangle transformed, original;
-                    for (size_t v = 0; v < fv; v++) 
+                    // Each distinct vertex of the shape is transformed once, then faces are gathered by index
+                    const glm::mat4 modelToScreen = viewxprojection * modelMat;
+                    vertices.Transform(lod.Select(mesh, shapes[s], modelToScreen), mesh, modelMat, modelToScreen);
+
+                    std::vector<Triangle>& outTransformed = joined ? shapeTrigs[s].transformed : transformedTrigs;
+                    std::vector<Triangle>& outOriginal = joined ? shapeTrigs[s].original : originalTrigs;
+                    if (joined)
                     {
-                        // access to vertex
-                        tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-                        tinyobj::real_t vx = attribs.vertices[3 * size_t(idx.vertex_index) + 0];
-                        tinyobj::real_t vy = attribs.vertices[3 * size_t(idx.vertex_index) + 1];
-                        tinyobj::real_t vz = attribs.vertices[3 * size_t(idx.vertex_index) + 2];
-                        glm::vec4 vec(vx, vy, vz, 1);
-                        
-                        // init to identity so that the program will no crash even without model matrices being added
-                        glm::mat4 modelMat = glm::mat4(1.f);
-                        if (rasterizer.model.size() > s)
-                            modelMat = rasterizer.model[s];
-
-                        if (loader.GetType() == TestType::TRIANGLE)
-                            transformed.pos[v] = viewxprojection * vec;
-                        else
-                            transformed.pos[v] = viewxprojection * modelMat * vec;
-
-                        original.pos[v] = modelMat * vec;
-
-                        if (idx.normal_index >= 0) 
-                        {
-                            tinyobj::real_t nx = attribs.normals[3 * size_t(idx.normal_index) + 0];
-                            tinyobj::real_t ny = attribs.normals[3 * size_t(idx.normal_index) + 1];
-                            tinyobj::real_t nz = attribs.normals[3 * size_t(idx.normal_index) + 2];
-                            original.normal[v] = modelMat * glm::vec4(nx, ny, nz, 1);
-                        }
+                        outTransformed.clear();
+                        outOriginal.clear();
                     }
+                    for (size_t f = 0; f < vertices.GetFaceCount(); f++)
+                    {
+                        Triangle transformed, original;
+                        vertices.Assemble(f, transformed, original);
 
-                    transformed.Homogenize();
+                        // Clip against the near plane and the guard band, homogenize, then drop what cannot be seen
+                        size_t clipped = clipper.Clip(transformed, original, outTransformed, outOriginal);
+                        culler.Filter(clipped, outTransformed, outOriginal);
+                    }
+                }
+            });
+
+            if (joined)
+            {
+                size_t trigCount = 0;
+                for (const RendererShapeTriangles& trigs : shapeTrigs)
+                    trigCount += trigs.transformed.size();
+                transformedTrigs.reserve(trigCount);
+                originalTrigs.reserve(trigCount);
+                for (const RendererShapeTriangles& trigs : shapeTrigs)
+                {
+                    transformedTrigs.insert(transformedTrigs.end(), trigs.transformed.begin(), trigs.transformed.end());
+                    originalTrigs.insert(originalTrigs.end(), trigs.original.begin(), trigs.original.end());
+                }
+            }
 
 #if defined PRINT_TRIG_DETAIL
-                    PrintTaskTriangle(transformed);
+            for (const Triangle& trig : transformedTrigs)
+                PrintTaskTriangle(trig);
 #endif
 
-                    if (loader.GetType() == TestType::TRIANGLE || loader.GetType() == TestType::TRANSFORM)
-                        rasterizer.DrawPrimitiveRaw(image, transformed, loader.GetAntiAliasConfig(), loader.GetSpp());
-                    else if (loader.GetType() == TestType::SHADING_DEPTH || loader.GetType() == TestType::SHADING)
-                        rasterizer.DrawPrimitiveDepth(transformed, original, rasterizer.ZBuffer);
-                    
-                    if (loader.GetType() == TestType::SHADING)
+            CullStats cullStats;
+            for (const Culler& culler : cullers)
+                cullStats += culler.GetStats();
+            this->stats.culling += cullStats;
+            if (this->verbose)
+                PrintCullStats(cullStats);
+
+            for (const Triangle& trig : transformedTrigs)
+            {
+                const auto& p = trig.pos;
+                this->stats.pixels += 0.5 * std::abs(static_cast<double>(
+                    (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x)));
+            }
+            this->stats.triangles += transformedTrigs.size();
+            this->stats.vertex += Lap(clock);
+
+            // Output rows are stored bottom-up and written top-down, so bands go from the top of the image down
+            const glm::mat4 screenspace = rasterizer.screenspace;
+            std::vector<Triangle> bandTrigs;
+            for (uint32_t top = height; top > 0; )
+            {
+                const uint32_t y0 = (top > bandHeight) ? top - bandHeight : 0;
+                const uint32_t rows = top - y0;
+                top = y0;
+
+                // The last image drawn into was released by the encoder when the previous band was pushed
+                Image& image = images[bandCount++ % images.size()];
+                if (bandCount > images.size())
+                    image.Clear(Color::Black);
+                if (bandCount > 1)
+                    hdr.Clear(background);
+
+                // Moving every position down by y0 puts the band's first row at row 0 of the buffers. The
+                //  frame's triangles are shifted rather than transformed again, and binning skips those
+                //  outside the band; a single band draws the frame's triangles as they are.
+                glm::mat4 shift(1.f);
+                shift[3][1] = -static_cast<float>(y0);
+                rasterizer.screenspace = shift * screenspace;
+                if (rows != height)
+                {
+                    bandTrigs = transformedTrigs;
+                    for (Triangle& trig : bandTrigs)
+                        for (glm::vec4& pos : trig.pos)
+                            pos.y -= static_cast<float>(y0);
+                }
+                const std::vector<Triangle>& bandTransformed = (rows != height) ? bandTrigs : transformedTrigs;
+
+                // Binning stage: sort the triangles into screen tiles, keeping submission order per tile.
+                //  Tiles match the depth pyramid cells, so each tile also owns its pyramid entries.
+                TileBinner binner(width, rows, DepthPyramid::CellSize);
+                for (size_t i = 0; i < bandTransformed.size(); ++i)
+                    binner.Bin(bandTransformed[i], static_cast<uint32_t>(i));
+                this->stats.vertex += Lap(clock);
+
+                // Raster stage: tiles cover disjoint pixels of the image and the ZBuffer, so they are
+                //  rasterized concurrently without locking. All depth is resolved before any shading,
+                //  which gives the same per-pixel result as the serial per-shape passes.
+                const RasterTargets targets{ bandTransformed, originalTrigs, image, hdr, visibility };
+                if (passes.depth != nullptr)
+                {
+                    rasterizer.InitZBuffer(rasterizer.ZBuffer);
+
+                    pool.ParallelFor(binner.GetTileCount(), [&](size_t tile)
                     {
-                        transformedTrigs.push_back(transformed);
-                        originalTrigs.push_back(original);
-                    }
+                        passes.depth(rasterizer, targets, binner.GetBin(tile), binner.GetTileRect(tile));
+                    });
+                    this->stats.depth += Lap(clock);
+                }
+
+                // Light culling: once depth is final, every tile keeps only the lights that reach its pixels
+                std::optional<LightGrid> lightGrid;
+                if (type == TestType::SHADING && loader.GetLightCutoff() > 0)
+                {
+                    lightGrid.emplace(rasterizer.shading, rasterizer.view, rasterizer.projection, rasterizer.screenspace,
+                        width, rows, DepthPyramid::CellSize, loader.GetLightCutoff());
+                    rasterizer.lightGrid = &lightGrid.value();
+                }
 
-                    index_offset += fv;
+                if (passes.color != nullptr)
+                {
+                    pool.ParallelFor(binner.GetTileCount(), [&](size_t tile)
+                    {
+                        const TileRect rect = binner.GetTileRect(tile);
+                        if (lightGrid.has_value())
+                            lightGrid->Build((samples > 1) ? rasterizer.SampleDepth : rasterizer.ZBuffer, Rasterizer::zBufferDefault, rect, samples);
+                        passes.color(rasterizer, targets, binner.GetBin(tile), rect);
+                    });
+                    this->stats.shade += Lap(clock);
                 }
+                rasterizer.lightGrid = nullptr;
 
-                if (loader.GetType() == TestType::SHADING)
-                    for (size_t i = 0; i < transformedTrigs.size(); ++i)
-                        rasterizer.DrawPrimitiveShaded(transformedTrigs[i], originalTrigs[i], image);
+                if (shading)
+                    ToneMap(hdr, image, loader.GetToneMapping(), loader.GetDither());
+                else if (type == TestType::SHADING_DEPTH)
+                    DepthToGrey(rasterizer.ZBuffer, image, rows);
+
+                const bool lastBand = (top == 0);
+                queue.Push([writer, &image, rows, lastBand, frame]()
+                {
+                    WriteBand(*writer, image, rows);
+                    if (lastBand && !writer->Finish())
+                        throw std::runtime_error("output of frame " + std::to_string(frame) + " was not written completely");
+                });
+                this->stats.write += Lap(clock);
             }
+            rasterizer.screenspace = screenspace;
+            ++this->stats.frames;
         }
 
-        if (loader.GetType() == TestType::SHADING_DEPTH)
-            rasterizer.ZBuffer.Write();
-        else if (loader.GetType() != TestType::TRANSFORM_TEST)
-            image.Write();
+        queue.Wait();
+        this->stats.write += Lap(clock);
     }
 }
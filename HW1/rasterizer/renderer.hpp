@@ -1,19 +1,42 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
+#include "culler.hpp"
 #include "entities.hpp"
 #include "rasterizer.hpp"
 #include "loader.hpp"
 
+// Measurements of the last Render call. Times are wall-clock milliseconds per pipeline stage.
+struct RenderStats
+{
+    double load = 0;            // yaml and obj loading, framebuffer allocation
+    double vertex = 0;          // transform, clip, cull and binning
+    double depth = 0;           // depth or visibility pass
+    double shade = 0;           // shading, or the whole raster pass for tasks without depth
+    double write = 0;           // encoding the output files, or waiting for the encoder
+    size_t frames = 0;          // frames rendered
+    size_t triangles = 0;       // triangles reaching the raster stage
+    double pixels = 0;          // screen-space area of those triangles, i.e. fragments before any depth test
+    CullStats culling;
+
+    inline double Total() const { return load + vertex + depth + shade + write; }
+};
+
 class Renderer
 {
 public:
     Renderer(std::string configName) : configName(configName) {  };
 
-    void Render(int argc, char** argv);      // main render call
+    void Render(int argc, char** argv);      // main render call; throws if an output file is not written completely
+
+    // Silence the configuration and statistics printouts, e.g. for repeated runs
+    inline void SetVerbose(bool verbose) { this->verbose = verbose; }
+    inline const RenderStats& GetStats() const { return this->stats; }
 
 private:
     std::string configName;
+    bool verbose = true;
+    RenderStats stats;
 };
 
 #endif
@@ -0,0 +1,38 @@
+#include "samplepattern.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+
+SamplePattern::SamplePattern(uint32_t spp)
+{
+    uint32_t columns = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(spp)))));
+    uint32_t rows = std::max(1u, (spp + columns - 1) / columns);
+
+    // mt19937 output is fully specified by the standard, unlike the distributions
+    std::mt19937 gen(0x9E3779B9u ^ spp);
+    auto jitter = [&gen]() { return static_cast<float>(gen() >> 8) / static_cast<float>(1u << 24); };
+
+    offsets.reserve(spp);
+    for (uint32_t i = 0; i != spp; ++i)
+    {
+        float x = (static_cast<float>(i % columns) + jitter()) / static_cast<float>(columns);
+        float y = (static_cast<float>(i / columns) + jitter()) / static_cast<float>(rows);
+        offsets.emplace_back(x, y);
+    }
+}
+
+const SamplePattern& SamplePattern::Get(uint32_t spp)
+{
+    static std::mutex mutex;
+    static std::map<uint32_t, std::unique_ptr<SamplePattern>> tables;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<SamplePattern>& table = tables[spp];
+    if (!table)
+        table = std::make_unique<SamplePattern>(spp);
+    return *table;
+}
@@ -0,0 +1,33 @@
+#ifndef SAMPLEPATTERN_H
+#define SAMPLEPATTERN_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../thirdparty/glm/glm.hpp"
+
+// Fixed sub-pixel sample positions for anti-aliasing.
+//  The pixel is split into a grid of ceil(sqrt(spp)) columns and as many rows as needed,
+//  and every sample is jittered inside its own cell with a fixed seed, so the pattern is
+//  stratified, identical for every pixel, and reproducible between runs.
+class SamplePattern
+{
+public:
+    SamplePattern(uint32_t spp);
+
+    // The table for `spp` samples, built on first use and shared afterwards. Thread-safe.
+    static const SamplePattern& Get(uint32_t spp);
+
+    inline uint32_t Count() const { return static_cast<uint32_t>(offsets.size()); }
+
+    // Offset of sample i from the pixel corner, in [0, 1)^2
+    inline const glm::vec2& operator[] (size_t i) const { return offsets[i]; }
+
+    // The sample mask with every sample covered, sample i being bit i & 31
+    inline uint32_t FullMask() const { return Count() >= 32 ? ~0u : (1u << Count()) - 1u; }
+
+private:
+    std::vector<glm::vec2> offsets;
+};
+
+#endif
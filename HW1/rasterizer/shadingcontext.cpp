@@ -0,0 +1,149 @@
+#include "shadingcontext.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "loader.hpp"
+
+void LightArrays::Clear()
+{
+    x.clear(); y.clear(); z.clear();
+    intensity.clear();
+    r.clear(); g.clear(); b.clear();
+}
+
+void LightArrays::Add(const Light& light)
+{
+    x.push_back(light.pos.x);
+    y.push_back(light.pos.y);
+    z.push_back(light.pos.z);
+    intensity.push_back(light.intensity);
+    r.push_back(static_cast<float>(light.color.r) / 255.f);
+    g.push_back(static_cast<float>(light.color.g) / 255.f);
+    b.push_back(static_cast<float>(light.color.b) / 255.f);
+}
+
+void LightArrays::Add(const LightArrays& from, size_t index)
+{
+    x.push_back(from.x[index]);
+    y.push_back(from.y[index]);
+    z.push_back(from.z[index]);
+    intensity.push_back(from.intensity[index]);
+    r.push_back(from.r[index]);
+    g.push_back(from.g[index]);
+    b.push_back(from.b[index]);
+}
+
+ShadingContext::ShadingContext(const Loader& loader)
+{
+    // only shading tasks carry lights and material parameters
+    if (loader.GetType() != TestType::SHADING)
+        return;
+
+    for (const Light& light : loader.GetLights())
+        this->lights.Add(light);
+    this->cameraPos = loader.GetCamera().pos;
+    Color ambient = loader.GetAmbientColor();
+    this->ambient = glm::vec3(ambient.r, ambient.g, ambient.b) / 255.f;
+    this->specularExponent = loader.GetSpecularExponent();
+
+    float rounded = std::round(this->specularExponent);
+    if (rounded == this->specularExponent && rounded >= 1.f && rounded <= 256.f)
+        this->integerExponent = static_cast<uint32_t>(rounded);
+}
+
+void ShadingContext::Power(float* values, size_t count) const
+{
+    if (this->integerExponent == 0)
+    {
+        for (size_t i = 0; i < count; ++i)
+            values[i] = std::pow(values[i], this->specularExponent);
+        return;
+    }
+
+    // exponentiation by squaring, one bit of the exponent at a time over all values
+    float base[ShadingContext::Chunk];
+    float result[ShadingContext::Chunk];
+    for (size_t i = 0; i < count; ++i)
+    {
+        base[i] = values[i];
+        result[i] = 1.f;
+    }
+    for (uint32_t e = this->integerExponent; e != 0; e >>= 1)
+    {
+        if (e & 1u)
+            for (size_t i = 0; i < count; ++i)
+                result[i] *= base[i];
+        for (size_t i = 0; i < count; ++i)
+            base[i] *= base[i];
+    }
+    for (size_t i = 0; i < count; ++i)
+        values[i] = result[i];
+}
+
+glm::vec3 ShadingContext::Shade(glm::vec3 pos, glm::vec3 normal, const LightArrays& lights) const
+{
+    glm::vec3 view = glm::normalize(this->cameraPos - pos);
+
+    const float* lx = lights.x.data();
+    const float* ly = lights.y.data();
+    const float* lz = lights.z.data();
+    const float* li = lights.intensity.data();
+    const float* lr = lights.r.data();
+    const float* lg = lights.g.data();
+    const float* lb = lights.b.data();
+
+    // Accumulated in float with no clamping; the framebuffer is converted to 8 bits once, at output
+    glm::vec3 sum = this->ambient;
+
+    // Lights are processed in fixed-size chunks on the stack; each loop below is branch-free
+    //  over the chunk, so the compiler can vectorize it across lights
+    float diffuse[ShadingContext::Chunk];
+    float specular[ShadingContext::Chunk];
+    float decay[ShadingContext::Chunk];
+    float weight[ShadingContext::Chunk];
+    for (size_t first = 0; first < lights.Count(); first += ShadingContext::Chunk)
+    {
+        const size_t count = std::min(ShadingContext::Chunk, lights.Count() - first);
+
+        for (size_t k = 0; k < count; ++k)
+        {
+            size_t i = first + k;
+            float dx = lx[i] - pos.x;
+            float dy = ly[i] - pos.y;
+            float dz = lz[i] - pos.z;
+            float distance2 = dx * dx + dy * dy + dz * dz;
+            float invDistance = 1.f / std::sqrt(distance2);
+            float ldx = dx * invDistance;
+            float ldy = dy * invDistance;
+            float ldz = dz * invDistance;
+
+            float hx = ldx + view.x;
+            float hy = ldy + view.y;
+            float hz = ldz + view.z;
+            float invHalf = 1.f / std::sqrt(hx * hx + hy * hy + hz * hz);
+            hx *= invHalf;
+            hy *= invHalf;
+            hz *= invHalf;
+
+            diffuse[k] = std::max(normal.x * ldx + normal.y * ldy + normal.z * ldz, 0.f);
+            specular[k] = std::max(normal.x * hx + normal.y * hy + normal.z * hz, 0.f);
+            decay[k] = li[i] / distance2;
+        }
+
+        Power(specular, count);
+
+        // diffuse and specular share the light color, so one weight per light remains
+        for (size_t k = 0; k < count; ++k)
+            weight[k] = decay[k] * (diffuse[k] + specular[k]);
+        for (size_t k = 0; k < count; ++k)
+        {
+            size_t i = first + k;
+            sum.r += lr[i] * weight[k];
+            sum.g += lg[i] * weight[k];
+            sum.b += lb[i] * weight[k];
+        }
+    }
+
+    return sum;
+}
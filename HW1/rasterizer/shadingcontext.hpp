@@ -0,0 +1,58 @@
+#ifndef SHADINGCONTEXT_H
+#define SHADINGCONTEXT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entities.hpp"
+
+class Loader;
+
+// Point lights in structure-of-arrays form, so that the per-light loop of the shader
+//  reads each attribute contiguously and carries no per-light objects
+struct LightArrays
+{
+    std::vector<float> x, y, z;
+    std::vector<float> intensity;
+    std::vector<float> r, g, b;         // color in [0, 1]
+
+    inline size_t Count() const { return intensity.size(); }
+
+    void Clear();
+    void Add(const Light& light);
+    void Add(const LightArrays& from, size_t index);
+};
+
+// Everything Blinn-Phong shading needs that is constant over a frame, gathered once
+//  from the loader instead of being copied out of it for every fragment
+struct ShadingContext
+{
+    LightArrays lights;
+    glm::vec3 cameraPos = glm::vec3(0.f);
+    glm::vec3 ambient = glm::vec3(0.f);     // in [0, 1]
+    float specularExponent = 1.f;
+
+    // set when specularExponent is a small positive integer, so powers are taken by repeated squaring
+    uint32_t integerExponent = 0;
+
+    ShadingContext() = default;
+    explicit ShadingContext(const Loader& loader);
+
+    /**
+     * Linear Blinn-Phong color of a surface point lit by `lights`, where 1 is full intensity.
+     * Nothing is clamped; values above 1 are left to the tone mapping of the framebuffer.
+     * @param pos: the surface point in model space
+     * @param normal: the normalized surface normal
+     */
+    glm::vec3 Shade(glm::vec3 pos, glm::vec3 normal, const LightArrays& lights) const;
+    inline glm::vec3 Shade(glm::vec3 pos, glm::vec3 normal) const { return Shade(pos, normal, this->lights); }
+
+private:
+    // number of lights evaluated together in Shade
+    static constexpr size_t Chunk = 16;
+
+    // values[i] = values[i] ^ specularExponent, for count <= Chunk
+    void Power(float* values, size_t count) const;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "syntheticscene.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <array>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Fisher-Yates with the raw generator, so that a seed gives the same order with every standard library
+template<typename T>
+static void Shuffle(std::vector<T>& values, std::mt19937& rng)
+{
+    for (size_t i = values.size(); i > 1; --i)
+        std::swap(values[i - 1], values[rng() % i]);
+}
+
+std::string WriteSyntheticScene(const SyntheticSceneConfig& config, const std::string& name)
+{
+    if (config.width == 0 || config.height == 0)
+        throw std::runtime_error("synthetic scene needs a non-empty resolution");
+    if (config.geometry != "soup" && config.geometry != "grid")
+        throw std::runtime_error("unknown synthetic geometry " + config.geometry);
+
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    const float pi = 3.14159265358979f;
+
+    // The plane z = 0 spans [-1, 1] in both axes on screen, i.e. half a resolution per unit
+    float unitsPerPixelX = 2.f / static_cast<float>(config.width);
+    float unitsPerPixelY = 2.f / static_cast<float>(config.height);
+
+    // Circumradius of an equilateral triangle with the requested edge length
+    float radius = config.size / std::sqrt(3.f);
+
+    // Half extent (in the [-1, 1] range) of the square region holding the triangle centers
+    float triangleArea = std::sqrt(3.f) / 4.f * config.size * config.size;
+    float coveredArea = triangleArea * static_cast<float>(config.triangles) / std::max(config.overdraw, 1e-3f);
+    float fraction = coveredArea / (static_cast<float>(config.width) * static_cast<float>(config.height));
+    float extent = std::min(std::sqrt(fraction), 1.f);
+
+    std::string objName = name + ".obj";
+    std::ofstream obj(objName);
+    if (!obj)
+        throw std::runtime_error("cannot write " + objName);
+
+    obj << "o Synthetic\n";
+    if (config.geometry == "grid")
+    {
+        // One grid of right triangles with legs of `size` pixels per unit of overdraw, each at its own depth
+        const uint32_t layers = std::max(1u, static_cast<uint32_t>(std::lround(config.overdraw)));
+        const uint32_t cells = static_cast<uint32_t>(std::ceil(std::sqrt(config.triangles / (2.0 * layers))));
+        const uint32_t side = cells + 1;
+        auto id = [&](uint32_t layer, uint32_t i, uint32_t j) { return (layer * side + j) * side + i; };
+
+        // vertices are written in a random order, as are the faces
+        std::vector<uint32_t> slots(static_cast<size_t>(layers) * side * side);
+        std::iota(slots.begin(), slots.end(), 0u);
+        Shuffle(slots, rng);
+
+        std::vector<float> positions(slots.size() * 3);
+        for (uint32_t layer = 0; layer < layers; ++layer)
+        {
+            float z = -0.5f * (static_cast<float>(layer) + 0.5f) / static_cast<float>(layers);
+            for (uint32_t j = 0; j < side; ++j)
+                for (uint32_t i = 0; i < side; ++i)
+                {
+                    float* p = &positions[static_cast<size_t>(slots[id(layer, i, j)]) * 3];
+                    p[0] = (static_cast<float>(i) - 0.5f * static_cast<float>(cells)) * config.size * unitsPerPixelX;
+                    p[1] = (static_cast<float>(j) - 0.5f * static_cast<float>(cells)) * config.size * unitsPerPixelY;
+                    p[2] = z;
+                }
+        }
+        for (size_t v = 0; v < slots.size(); ++v)
+            obj << "v " << positions[v * 3] << ' ' << positions[v * 3 + 1] << ' ' << positions[v * 3 + 2] << '\n';
+        obj << "vn 0 0 1\n";
+
+        // counter-clockwise on screen; faces beyond the requested count are dropped after shuffling
+        std::vector<std::array<uint32_t, 3>> faces;
+        for (uint32_t layer = 0; layer < layers; ++layer)
+            for (uint32_t j = 0; j < cells; ++j)
+                for (uint32_t i = 0; i < cells; ++i)
+                {
+                    uint32_t a = slots[id(layer, i, j)], b = slots[id(layer, i + 1, j)];
+                    uint32_t c = slots[id(layer, i + 1, j + 1)], d = slots[id(layer, i, j + 1)];
+                    faces.push_back({ a, b, c });
+                    faces.push_back({ a, c, d });
+                }
+        Shuffle(faces, rng);
+        faces.resize(std::min<size_t>(faces.size(), config.triangles));
+        for (const auto& face : faces)
+            obj << "f " << face[0] + 1 << "//1 " << face[1] + 1 << "//1 " << face[2] + 1 << "//1\n";
+    }
+    else
+    {
+        for (uint32_t t = 0; t < config.triangles; ++t)
+        {
+            float cx = (2.f * unit(rng) - 1.f) * extent;
+            float cy = (2.f * unit(rng) - 1.f) * extent;
+            float z = -0.5f * unit(rng);                    // behind the plane, away from the camera
+            float angle = 2.f * pi * unit(rng);
+
+            // counter-clockwise on screen, i.e. facing the camera
+            for (int k = 0; k < 3; ++k)
+            {
+                float a = angle + static_cast<float>(k) * 2.f * pi / 3.f;
+                obj << "v " << cx + radius * std::cos(a) * unitsPerPixelX << ' '
+                    << cy + radius * std::sin(a) * unitsPerPixelY << ' ' << z << '\n';
+            }
+        }
+        obj << "vn 0 0 1\n";
+        for (uint32_t t = 0; t < config.triangles; ++t)
+            obj << "f " << 3 * t + 1 << "//1 " << 3 * t + 2 << "//1 " << 3 * t + 3 << "//1\n";
+    }
+
+    std::string yamlName = name + ".yaml";
+    std::ofstream yaml(yamlName);
+    if (!yaml)
+        throw std::runtime_error("cannot write " + yamlName);
+
+    // nearClip / (camera distance) * 2 / camera width = 1 maps the plane z = 0 onto the viewport
+    yaml << "task: " << config.task << "\n"
+        << "antialias: none\n"
+        << "resolution:\n"
+        << "    width: " << config.width << "\n"
+        << "    height: " << config.height << "\n"
+        << "simd: " << config.simd << "\n"
+        << "obj: " << name << "\n"
+        << "output: " << name << "\n"
+        << "format: " << config.format << "\n"
+        << "png-level: " << config.pngLevel << "\n"
+        << "mesh-order: " << config.meshOrder << "\n"
+        << "mesh-cache: true\n"
+        << "camera:\n"
+        << "    pos: [0.0, 0.0, 1.0]\n"
+        << "    lookAt: [0.0, 0.0, 0.0]\n"
+        << "    up: [0.0, 1.0, 0.0]\n"
+        << "    width: 0.2\n"
+        << "    height: 0.2\n"
+        << "    nearClip: 0.1\n"
+        << "    farClip: 100.0\n"
+        << "transforms:\n"
+        << "    -\n"
+        << "        rotation: [1.0, 0.0, 0.0, 0.0]\n"
+        << "        translation: [0.0, 0.0, 0.0]\n"
+        << "        scale: [1.0, 1.0, 1.0]\n";
+
+    if (config.task == "shading")
+        yaml << "shading-mode: " << config.shadingMode << "\n"
+            << "exponent: 8.0\n"
+            << "ambient: [10, 10, 10]\n"
+            << "light-cutoff: " << config.lightCutoff << "\n";
+
+    if (config.lights > 0)
+    {
+        yaml << "lights:\n";
+        for (uint32_t l = 0; l < config.lights; ++l)
+        {
+            yaml << "    -\n"
+                << "        pos: [" << 2.f * unit(rng) - 1.f << ", " << 2.f * unit(rng) - 1.f << ", "
+                << 0.5f + 1.5f * unit(rng) << "]\n"
+                << "        intensity: " << 0.1f + 0.4f * unit(rng) << "\n"
+                << "        color: [" << 64 + static_cast<int>(191.f * unit(rng)) << ", "
+                << 64 + static_cast<int>(191.f * unit(rng)) << ", "
+                << 64 + static_cast<int>(191.f * unit(rng)) << "]\n";
+        }
+    }
+
+    return yamlName;
+}
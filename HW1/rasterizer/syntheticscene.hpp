@@ -0,0 +1,39 @@
+#ifndef SYNTHETIC_SCENE_H
+#define SYNTHETIC_SCENE_H
+
+#include <cstdint>
+#include <string>
+
+// Parameters of a generated benchmark workload
+struct SyntheticSceneConfig
+{
+    uint32_t triangles = 10000;
+    float size = 16.f;                  // edge length of each triangle, in pixels
+    float overdraw = 2.f;               // average number of triangles covering a covered pixel
+    uint32_t lights = 2;
+    float lightCutoff = 1.f;            // light-cutoff of the yaml config
+    uint32_t width = 800;
+    uint32_t height = 800;
+    std::string task = "shading";       // any task of the yaml config except transform-test
+    std::string shadingMode = "visibility";
+    std::string simd = "auto";
+    uint32_t seed = 1;
+    std::string format = "png";         // output format, as in the yaml config
+    uint32_t pngLevel = 6;
+    std::string geometry = "soup";      // soup: separate triangles; grid: connected surfaces stored in random order
+    std::string meshOrder = "cache";    // mesh-order of the yaml config
+};
+
+/**
+ * Write `name`.obj and `name`.yaml describing a scene of randomly placed, camera-facing triangles.
+ * The camera looks down -z at the plane z = 0, which fills the viewport exactly, so triangle sizes
+ * are in pixels up to the perspective of their small depth offsets. Triangles are scattered over
+ * a centered region sized so that their total area is `overdraw` times its area (capped at the
+ * whole viewport), in random depth order. With the grid geometry the triangles instead tile
+ * `overdraw` stacked square grids sharing their vertices, with faces and vertices shuffled as an
+ * exporter might leave them. The same config and seed always give the same files.
+ * @return: the yaml filename, as passed to Renderer::Render
+ */
+std::string WriteSyntheticScene(const SyntheticSceneConfig& config, const std::string& name);
+
+#endif
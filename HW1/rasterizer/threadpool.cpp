@@ -0,0 +1,95 @@
+#include "threadpool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    // the caller of ParallelFor is the remaining thread
+    for (size_t i = 1; i < threadCount; ++i)
+        workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& job)
+{
+    if (count == 0)
+        return;
+
+    if (workers.empty() || count == 1)
+    {
+        for (size_t i = 0; i != count; ++i)
+            job(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->job = &job;
+        this->jobCount = count;
+        this->next.store(0);
+        this->pendingWorkers = workers.size();
+        this->error = nullptr;
+        ++this->generation;
+    }
+    wake.notify_all();
+
+    Drain();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pendingWorkers == 0; });
+    this->job = nullptr;
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void ThreadPool::Drain()
+{
+    for (size_t i = next.fetch_add(1); i < jobCount; i = next.fetch_add(1))
+    {
+        try
+        {
+            (*job)(i);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+}
+
+void ThreadPool::WorkerLoop()
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        Drain();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pendingWorkers == 0)
+            done.notify_one();
+    }
+}
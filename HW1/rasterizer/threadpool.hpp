@@ -0,0 +1,53 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that execute indexed jobs in parallel.
+// The calling thread takes part in the work, so a pool of size 1 runs everything inline.
+class ThreadPool
+{
+public:
+    // threadCount of 0 picks std::thread::hardware_concurrency()
+    ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator= (const ThreadPool&) = delete;
+
+    // Run job(i) for every i in [0, count) and block until all of them finish.
+    //  Indices are handed out dynamically, so jobs must not depend on each other.
+    //  The first exception thrown by any job is rethrown here.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+
+    // Number of threads taking part in ParallelFor, including the caller
+    inline size_t GetThreadCount() const { return workers.size() + 1; }
+
+private:
+    void WorkerLoop();
+    void Drain();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // state of the current ParallelFor call, guarded by mutex except for next
+    const std::function<void(size_t)>* job = nullptr;
+    size_t jobCount = 0;
+    std::atomic<size_t> next{ 0 };
+    size_t pendingWorkers = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "tonemap.hpp"
+
+#include <algorithm>
+
+// Thresholds of the 4x4 Bayer matrix, as offsets in [-0.5, 0.5) of a level
+static const float BayerOffsets[4][4] = {
+    { -0.46875f,  0.03125f, -0.34375f,  0.15625f },
+    {  0.28125f, -0.21875f,  0.40625f, -0.09375f },
+    { -0.31250f,  0.18750f, -0.43750f,  0.06250f },
+    {  0.43750f, -0.06250f,  0.31250f, -0.18750f },
+};
+static const float NoOffsets[4] = { 0.f, 0.f, 0.f, 0.f };
+
+template<ToneMapping mapping>
+static inline glm::vec3 Curve(glm::vec3 color)
+{
+    color = glm::max(color, glm::vec3(0.f));
+    if constexpr (mapping == ToneMapping::REINHARD)
+        color = color / (glm::vec3(1.f) + color);
+    else if constexpr (mapping == ToneMapping::ACES)
+        color = (color * (2.51f * color + 0.03f)) / (color * (2.43f * color + 0.59f) + 0.14f);
+    return glm::min(color, glm::vec3(1.f));
+}
+
+// Levels of a color in [0, 1], rounded to nearest after adding `offset`
+static inline glm::vec3 Levels(glm::vec3 color, float offset)
+{
+    // inputs are non-negative, so truncating after adding 0.5 rounds to nearest
+    return glm::clamp(255.f * color + (0.5f + offset), glm::vec3(0.f), glm::vec3(255.f));
+}
+
+// The mapping is a template parameter, so that each row is one branch-free loop over its pixels
+template<ToneMapping mapping>
+static void ToneMapRows(const ImageHDR& hdr, Image& image, uint32_t width, uint32_t height, bool dither)
+{
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const glm::vec4* in = hdr.Row(y);
+        Color* out = image.Row(y);
+        const float* offsets = dither ? BayerOffsets[y & 3] : NoOffsets;
+
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            glm::vec3 levels = Levels(Curve<mapping>(glm::vec3(in[x])), offsets[x & 3]);
+            out[x].r = static_cast<unsigned char>(static_cast<int32_t>(levels.r));
+            out[x].g = static_cast<unsigned char>(static_cast<int32_t>(levels.g));
+            out[x].b = static_cast<unsigned char>(static_cast<int32_t>(levels.b));
+            out[x].a = static_cast<unsigned char>(static_cast<int32_t>(std::clamp(255.f * in[x].a + 0.5f, 0.f, 255.f)));
+        }
+    }
+}
+
+glm::vec3 ToneMapColor(glm::vec3 color, ToneMapping mapping)
+{
+    if (mapping == ToneMapping::REINHARD)
+        return Curve<ToneMapping::REINHARD>(color);
+    else if (mapping == ToneMapping::ACES)
+        return Curve<ToneMapping::ACES>(color);
+    return Curve<ToneMapping::NONE>(color);
+}
+
+Color PackColor(glm::vec3 color, float offset)
+{
+    glm::vec3 levels = Levels(color, offset);
+    return Color(static_cast<float>(static_cast<int32_t>(levels.r)), static_cast<float>(static_cast<int32_t>(levels.g)),
+        static_cast<float>(static_cast<int32_t>(levels.b)), 255.f);
+}
+
+void ToneMap(const ImageHDR& hdr, Image& image, ToneMapping mapping, bool dither)
+{
+    const uint32_t width = std::min(hdr.GetWidth(), image.GetWidth());
+    const uint32_t height = std::min(hdr.GetHeight(), image.GetHeight());
+
+    if (mapping == ToneMapping::REINHARD)
+        ToneMapRows<ToneMapping::REINHARD>(hdr, image, width, height, dither);
+    else if (mapping == ToneMapping::ACES)
+        ToneMapRows<ToneMapping::ACES>(hdr, image, width, height, dither);
+    else
+        ToneMapRows<ToneMapping::NONE>(hdr, image, width, height, dither);
+}
@@ -0,0 +1,29 @@
+#ifndef TONEMAP_H
+#define TONEMAP_H
+
+#include <cstdint>
+
+#include "image.hpp"
+#include "loader.hpp"
+
+// Shading tasks accumulate light in a float framebuffer (ImageHDR); these convert it to the
+//  8-bit image once, right before it is written
+
+// Map a linear color, 1 being full intensity, into [0, 1]
+glm::vec3 ToneMapColor(glm::vec3 color, ToneMapping mapping);
+
+/**
+ * Round a color in [0, 1] to 8 bits per channel.
+ * @param offset: added before rounding, in [-0.5, 0.5) of a level; nonzero values dither
+ */
+Color PackColor(glm::vec3 color, float offset = 0.f);
+
+/**
+ * Tone map and pack every pixel of `hdr` into `image`, which must have the same size.
+ * Alpha is packed as is, without tone mapping.
+ * @param dither: whether to add a 4x4 ordered (Bayer) dither before rounding, which trades the
+ *  banding of smooth gradients for a fixed fine pattern
+ */
+void ToneMap(const ImageHDR& hdr, Image& image, ToneMapping mapping, bool dither);
+
+#endif
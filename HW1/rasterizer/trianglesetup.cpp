@@ -0,0 +1,96 @@
+#include "trianglesetup.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+TriangleSetup::TriangleSetup(const Triangle& trig)
+{
+    glm::vec3 v[3];
+    for (size_t i = 0; i != 3; ++i)
+        v[i] = glm::vec3(trig.pos[i]) / trig.pos[i].w;
+
+    valid = true;
+    for (size_t i = 0; i != 3; ++i)
+        valid = valid && std::abs(v[i].x) <= MaxCoordinate && std::abs(v[i].y) <= MaxCoordinate && std::isfinite(v[i].z);
+
+    int64_t X[3] = { 0, 0, 0 }, Y[3] = { 0, 0, 0 };
+    if (valid)
+    {
+        for (size_t i = 0; i != 3; ++i)
+        {
+            X[i] = Snap(v[i].x);
+            Y[i] = Snap(v[i].y);
+        }
+    }
+
+    // edge i runs from vertex (i + 1) % 3 to vertex (i + 2) % 3
+    for (int i = 0; i != 3; ++i)
+    {
+        int from = (i + 1) % 3, to = (i + 2) % 3;
+        a[i] = Y[from] - Y[to];
+        b[i] = X[to] - X[from];
+        ox[i] = X[from];
+        oy[i] = Y[from];
+    }
+
+    area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+    if (area < 0)
+    {
+        // clockwise: flip the edges so that the inside is positive
+        area = -area;
+        for (int i = 0; i != 3; ++i)
+        {
+            a[i] = -a[i];
+            b[i] = -b[i];
+        }
+    }
+    valid = valid && area != 0;
+
+    // (a, b) is the inward normal of the edge. A left edge has the inside to its right (a > 0), and
+    //  the edges kept among horizontal ones have the inside at greater y (b > 0). This is the top-left
+    //  rule in buffer coordinates, row 0 first; rows are stored bottom-up, so on the written image
+    //  those are the bottom edges of the triangle.
+    for (int i = 0; i != 3; ++i)
+    {
+        bool topLeft = a[i] > 0 || (a[i] == 0 && b[i] > 0);
+        bias[i] = topLeft ? 0 : -1;
+    }
+
+    rcpArea = valid ? static_cast<float>(1.0 / static_cast<double>(area)) : 0.f;
+
+    // the depth plane through the snapped vertices; a and b are per subpixel, so per pixel they scale by SubpixelScale
+    glm::vec3 z(v[0].z, v[1].z, v[2].z);
+    x0 = static_cast<float>(X[0]) / SubpixelScale;
+    y0 = static_cast<float>(Y[0]) / SubpixelScale;
+    z0 = z.x;
+    if (valid)
+    {
+        double scale = static_cast<double>(SubpixelScale) / static_cast<double>(area);
+        dzdx = static_cast<float>((a[0] * double(z.x) + a[1] * double(z.y) + a[2] * double(z.z)) * scale);
+        dzdy = static_cast<float>((b[0] * double(z.x) + b[1] * double(z.y) + b[2] * double(z.z)) * scale);
+    }
+    else
+        dzdx = dzdy = 0.f;
+    zmin = std::min({ z.x, z.y, z.z });
+    zmax = std::max({ z.x, z.y, z.z });
+}
+
+void TriangleSetup::DepthBounds(const TileRect& rect, float& lo, float& hi) const
+{
+    // pixel centers run from x0 + 0.5 to x1 - 0.5
+    float cx = 0.5f * (static_cast<float>(rect.x0) + static_cast<float>(rect.x1));
+    float cy = 0.5f * (static_cast<float>(rect.y0) + static_cast<float>(rect.y1));
+    float hw = 0.5f * (static_cast<float>(rect.x1 - rect.x0) - 1.f);
+    float hh = 0.5f * (static_cast<float>(rect.y1 - rect.y0) - 1.f);
+
+    float center = DepthAt(cx, cy);
+    float extent = std::abs(dzdx) * hw + std::abs(dzdy) * hh;
+
+    // a few float roundings on terms of this magnitude
+    float margin = 1e-5f * (1.f + std::abs(z0) +
+        std::abs(dzdx) * (std::abs(cx - x0) + hw + StepSpan) +
+        std::abs(dzdy) * (std::abs(cy - y0) + hh));
+
+    lo = std::max(center - extent, zmin) - margin;
+    hi = std::min(center + extent, zmax) + margin;
+}
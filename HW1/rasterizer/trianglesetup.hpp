@@ -0,0 +1,225 @@
+#ifndef TRIANGLESETUP_H
+#define TRIANGLESETUP_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "entities.hpp"
+
+#include "../thirdparty/glm/glm.hpp"
+
+// How the samples of a block of pixels lie against a triangle
+enum class BlockCoverage
+{
+    OUTSIDE,        // none is covered
+    PARTIAL,        // some may be covered; each needs its own edge test
+    INSIDE          // all are covered
+};
+
+// Per-triangle raster setup, built once before walking the pixels of a triangle.
+//  Vertices are snapped to fixed point with SubpixelBits fractional bits, and edge i,
+//  opposite to vertex i, has the integer edge function
+//      E_i(X, Y) = a[i] * (X - ox[i]) + b[i] * (Y - oy[i])
+//  in squared subpixel units, where (ox[i], oy[i]) is the first vertex of the edge. The
+//  edges are oriented so that E_i is positive inside whatever the winding, and E_i divided
+//  by the doubled area is the barycentric weight of vertex i. Edge values are exact, so
+//  coverage does not depend on float rounding, and the same values step by `a` along x.
+//
+//  Samples exactly on an edge belong to the triangle only if the edge is a top or a left
+//  edge in buffer coordinates, row 0 first (the D3D/OpenGL fill rule; rows are stored
+//  bottom-up, so the top edges are bottom edges on the written image). A sample on an edge
+//  shared by two triangles is covered by exactly one of them. The rule is folded into the
+//  stored values as a bias of -1 on the other edges, and a sample is covered when all three
+//  values are >= 0.
+struct TriangleSetup
+{
+    static constexpr int SubpixelBits = 8;
+    static constexpr int64_t SubpixelScale = int64_t(1) << SubpixelBits;
+
+    // Snapped vertices are limited to this many pixels from the origin, which keeps every
+    //  edge value within 64 bits; the clipper's guard band keeps triangles far inside it
+    static constexpr float MaxCoordinate = 1048576.f;
+
+    // The three edge values at one sample
+    struct Edges
+    {
+        int64_t e[3];
+
+        // no value is negative
+        inline bool Inside() const
+        {
+            return (e[0] | e[1] | e[2]) >= 0;
+        }
+    };
+
+    int64_t a[3], b[3];
+    int64_t ox[3], oy[3];
+    int64_t bias[3];        // -1 on edges that are neither top nor left, else 0
+
+    int64_t area;           // doubled area, E_0 + E_1 + E_2 == area everywhere before the bias
+    float rcpArea;
+
+    // depth plane z(x, y) = z0 + dzdx * (x - x0) + dzdy * (y - y0), anchored at the snapped vertex 0
+    float x0, y0, z0;
+    float dzdx, dzdy;
+    float zmin, zmax;       // depth range of the vertices
+
+    // false for triangles that are degenerate after snapping, which cover no pixel, and for
+    //  non-finite or out of range ones
+    bool valid;
+
+    // `trig` is in screen space; it is homogenized here if it is not already
+    TriangleSetup(const Triangle& trig);
+
+    // Round a screen-space coordinate to the subpixel grid
+    static inline int64_t Snap(float v)
+    {
+        return static_cast<int64_t>(std::llround(static_cast<double>(v) * SubpixelScale));
+    }
+
+    /**
+     * Conservative bounds of the depth of every pixel center in `rect`, widened by the
+     * rounding error of the stepped span values so that no rasterized depth falls outside.
+     */
+    void DepthBounds(const TileRect& rect, float& lo, float& hi) const;
+
+    // Edge values at (X, Y), in subpixels
+    inline Edges EdgesAt(int64_t X, int64_t Y) const
+    {
+        Edges edges;
+        for (int i = 0; i != 3; ++i)
+            edges.e[i] = a[i] * (X - ox[i]) + b[i] * (Y - oy[i]) + bias[i];
+        return edges;
+    }
+
+    inline float DepthAt(float x, float y) const
+    {
+        return z0 + dzdx * (x - x0) + dzdy * (y - y0);
+    }
+
+    inline bool Covers(float x, float y) const
+    {
+        return valid && EdgesAt(Snap(x), Snap(y)).Inside();
+    }
+
+    inline glm::vec3 Barycentric(const Edges& edges) const
+    {
+        return glm::vec3(static_cast<float>(edges.e[0] - bias[0]),
+                         static_cast<float>(edges.e[1] - bias[1]),
+                         static_cast<float>(edges.e[2] - bias[2])) * rcpArea;
+    }
+
+    // Edge and depth values are evaluated exactly at the first column of every `StepSpan`
+    //  columns, and the pixel k columns further has values base + k * step. The spans are
+    //  aligned to absolute pixel columns, so the value at a pixel never depends on where a
+    //  walk starts (e.g. on tile boundaries), and SIMD kernels computing the lanes of a span
+    //  at once give bit-identical results to the scalar walk.
+    static constexpr uint32_t StepSpan = 8;
+
+    // Edge and depth values at the pixel center of column xSpan (a multiple of StepSpan) in row y
+    inline void SpanStart(uint32_t xSpan, uint32_t y, Edges& edges, float& depth) const
+    {
+        edges = EdgesAt(int64_t(xSpan) * SubpixelScale + SubpixelScale / 2, int64_t(y) * SubpixelScale + SubpixelScale / 2);
+        depth = DepthAt(xSpan + 0.5f, y + 0.5f);
+    }
+
+    // Edge values step by a[i] * SubpixelScale per pixel
+    inline int64_t EdgeStep(int i) const
+    {
+        return a[i] * SubpixelScale;
+    }
+
+    inline Edges EdgesInSpan(const Edges& edgesStart, uint32_t k) const
+    {
+        Edges edges;
+        for (int i = 0; i != 3; ++i)
+            edges.e[i] = edgesStart.e[i] + EdgeStep(i) * k;
+        return edges;
+    }
+
+    inline float DepthInSpan(float depthStart, uint32_t k) const
+    {
+        return depthStart + dzdx * static_cast<float>(k);
+    }
+
+    /**
+     * Classify the subpixel rectangle [X0, X1] x [Y0, Y1], edges included. The edge functions are
+     * linear, so each one is extreme at a corner: the block is outside if an edge is negative at
+     * all four, and inside if every edge is non-negative at all four.
+     */
+    inline BlockCoverage Classify(int64_t X0, int64_t Y0, int64_t X1, int64_t Y1) const
+    {
+        bool inside = true;
+        for (int i = 0; i != 3; ++i)
+        {
+            int64_t e = a[i] * (X0 - ox[i]) + b[i] * (Y0 - oy[i]) + bias[i];
+            int64_t dx = a[i] * (X1 - X0), dy = b[i] * (Y1 - Y0);
+            int64_t lo = e + std::min<int64_t>(dx, 0) + std::min<int64_t>(dy, 0);
+            int64_t hi = e + std::max<int64_t>(dx, 0) + std::max<int64_t>(dy, 0);
+            if (hi < 0)
+                return BlockCoverage::OUTSIDE;
+            inside = inside && lo >= 0;
+        }
+        return inside ? BlockCoverage::INSIDE : BlockCoverage::PARTIAL;
+    }
+
+    // Classify the pixel centers of `rect`
+    inline BlockCoverage ClassifyCenters(const TileRect& rect) const
+    {
+        return Classify(int64_t(rect.x0) * SubpixelScale + SubpixelScale / 2, int64_t(rect.y0) * SubpixelScale + SubpixelScale / 2,
+                        int64_t(rect.x1) * SubpixelScale - SubpixelScale / 2, int64_t(rect.y1) * SubpixelScale - SubpixelScale / 2);
+    }
+
+    // Classify every point of the pixels of `rect`, such as the samples of a multisample pattern
+    inline BlockCoverage ClassifyArea(const TileRect& rect) const
+    {
+        return Classify(int64_t(rect.x0) * SubpixelScale, int64_t(rect.y0) * SubpixelScale,
+                        int64_t(rect.x1) * SubpixelScale, int64_t(rect.y1) * SubpixelScale);
+    }
+
+    /**
+     * Walk `box` in blocks of StepSpan x StepSpan pixels aligned to absolute pixel coordinates, so that
+     * each block row is a single span, and call block(rect, coverage) for every block not outside the
+     * triangle, with `rect` the part of the block inside `box`.
+     * @param area: classify whole pixels (ClassifyArea) instead of pixel centers (ClassifyCenters)
+     */
+    template<typename Block>
+    inline void ForEachBlock(const TileRect& box, bool area, Block&& block) const
+    {
+        for (uint32_t by = box.y0 / StepSpan; by <= (box.y1 - 1) / StepSpan; ++by)
+            for (uint32_t bx = box.x0 / StepSpan; bx <= (box.x1 - 1) / StepSpan; ++bx)
+            {
+                TileRect rect = box.Intersect({ bx * StepSpan, by * StepSpan, (bx + 1) * StepSpan, (by + 1) * StepSpan });
+                BlockCoverage coverage = area ? ClassifyArea(rect) : ClassifyCenters(rect);
+                if (coverage != BlockCoverage::OUTSIDE)
+                    block(rect, coverage);
+            }
+    }
+
+    /**
+     * Call fragment(x, edges, depth) for every covered pixel center of row y in [xBegin, xEnd).
+     * This is the scalar reference for the kernels in rasterkernels.hpp.
+     */
+    template<typename Fragment>
+    inline void ForEachInRow(uint32_t y, uint32_t xBegin, uint32_t xEnd, Fragment&& fragment) const
+    {
+        for (uint32_t xSpan = xBegin & ~(StepSpan - 1); xSpan < xEnd; xSpan += StepSpan)
+        {
+            Edges edgesStart;
+            float depthStart;
+            SpanStart(xSpan, y, edgesStart, depthStart);
+            for (uint32_t k = 0; k != StepSpan; ++k)
+            {
+                uint32_t x = xSpan + k;
+                if (x < xBegin || x >= xEnd)
+                    continue;
+                Edges e = EdgesInSpan(edgesStart, k);
+                if (e.Inside())
+                    fragment(x, e, DepthInSpan(depthStart, k));
+            }
+        }
+    }
+};
+
+#endif
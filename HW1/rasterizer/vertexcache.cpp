@@ -0,0 +1,90 @@
+#include "vertexcache.hpp"
+
+VertexCache::VertexCache(const VertexKernels& kernels) :
+    kernels(kernels) {  }
+
+uint32_t VertexCache::Slot(std::vector<uint32_t>& remap, std::vector<int>& used, int index)
+{
+    uint32_t& slot = remap[static_cast<size_t>(index)];
+    if (slot == UINT32_MAX)
+    {
+        slot = static_cast<uint32_t>(used.size());
+        used.push_back(index);
+    }
+    return slot;
+}
+
+void VertexCache::Transform(const ArrayView<MeshIndex>& indices, const Mesh& mesh, const glm::mat4& model, const glm::mat4& modelViewProjection)
+{
+    for (int index : usedVertices)
+        vertexRemap[static_cast<size_t>(index)] = UINT32_MAX;
+    for (int index : usedNormals)
+        normalRemap[static_cast<size_t>(index)] = UINT32_MAX;
+    usedVertices.clear();
+    usedNormals.clear();
+    vertexRemap.resize(mesh.GetVertexCount(), UINT32_MAX);
+    normalRemap.resize(mesh.GetNormalCount(), UINT32_MAX);
+
+    // Index pass: give every distinct vertex and normal a slot in first-use order
+    positionIndices.resize(indices.size);
+    normalIndices.resize(indices.size);
+    for (size_t i = 0; i != indices.size; ++i)
+    {
+        positionIndices[i] = Slot(vertexRemap, usedVertices, indices[i].vertex);
+        normalIndices[i] = indices[i].normal >= 0 ? Slot(normalRemap, usedNormals, indices[i].normal) : NoNormal;
+    }
+
+    // Transform pass: once per distinct vertex and normal
+    size_t vertexCount = usedVertices.size();
+    Gather(mesh.GetVertices(), usedVertices);
+    clipX.resize(vertexCount);
+    clipY.resize(vertexCount);
+    clipZ.resize(vertexCount);
+    clipW.resize(vertexCount);
+    modelX.resize(vertexCount);
+    modelY.resize(vertexCount);
+    modelZ.resize(vertexCount);
+    kernels.TransformPoints(modelViewProjection, vertexCount, sourceX.data(), sourceY.data(), sourceZ.data(),
+        clipX.data(), clipY.data(), clipZ.data(), clipW.data());
+    kernels.TransformPoints(model, vertexCount, sourceX.data(), sourceY.data(), sourceZ.data(),
+        modelX.data(), modelY.data(), modelZ.data(), nullptr);
+
+    size_t normalCount = usedNormals.size();
+    Gather(mesh.GetNormals(), usedNormals);
+    normalX.resize(normalCount);
+    normalY.resize(normalCount);
+    normalZ.resize(normalCount);
+    kernels.TransformDirections(NormalMatrix(model), normalCount, sourceX.data(), sourceY.data(), sourceZ.data(),
+        normalX.data(), normalY.data(), normalZ.data());
+}
+
+void VertexCache::Gather(const ArrayView<float>& triples, const std::vector<int>& used)
+{
+    sourceX.resize(used.size());
+    sourceY.resize(used.size());
+    sourceZ.resize(used.size());
+    for (size_t i = 0; i != used.size(); ++i)
+    {
+        const float* v = &triples[3 * static_cast<size_t>(used[i])];
+        sourceX[i] = v[0];
+        sourceY[i] = v[1];
+        sourceZ[i] = v[2];
+    }
+}
+
+void VertexCache::Assemble(size_t f, Triangle& transformed, Triangle& original) const
+{
+    for (size_t v = 0; v != 3; ++v)
+    {
+        uint32_t p = positionIndices[3 * f + v];
+        transformed.pos[v] = glm::vec4(clipX[p], clipY[p], clipZ[p], clipW[p]);
+        transformed.normal[v] = glm::vec4(0.f);
+        original.pos[v] = glm::vec4(modelX[p], modelY[p], modelZ[p], 1.f);
+
+        uint32_t n = normalIndices[3 * f + v];
+        if (n != NoNormal)
+            original.normal[v] = glm::vec4(normalX[n], normalY[n], normalZ[n], 0.f);
+        else
+            original.normal[v] = glm::vec4(0.f);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef VERTEXCACHE_H
+#define VERTEXCACHE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entities.hpp"
+#include "mesh.hpp"
+#include "vertexkernels.hpp"
+
+// Post-transform vertex cache for one shape at a time.
+//  Every distinct mesh vertex and normal index referenced by the shape is
+//  transformed once into structure-of-arrays buffers, and the corners of each
+//  face refer to those buffers by index, so a vertex shared by many faces is
+//  neither re-read nor re-transformed. The distinct positions and normals are
+//  gathered into contiguous arrays and transformed in batches by the vertex kernels.
+class VertexCache
+{
+public:
+    VertexCache(const VertexKernels& kernels);
+
+    /**
+     * Transform the vertices and normals referenced by `indices`, replacing the previous shape.
+     * @param indices: the triangles of a shape, or of one of its levels of detail
+     * @param model: the model matrix, giving the model-space (`original`) positions; normals are
+     *  transformed by its NormalMatrix
+     * @param modelViewProjection: the full matrix to screen space, before the divide by w, which
+     *  follows clipping
+     */
+    void Transform(const ArrayView<MeshIndex>& indices, const Mesh& mesh, const glm::mat4& model, const glm::mat4& modelViewProjection);
+
+    inline size_t GetFaceCount() const { return positionIndices.size() / 3; }
+    inline size_t GetVertexCount() const { return clipX.size(); }
+    inline size_t GetNormalCount() const { return normalX.size(); }
+
+    // Gather the three corners of face f of the current shape
+    void Assemble(size_t f, Triangle& transformed, Triangle& original) const;
+
+private:
+    const VertexKernels& kernels;
+
+    // slot of a mesh index in the compact buffers, assigned on first use
+    uint32_t Slot(std::vector<uint32_t>& remap, std::vector<int>& used, int index);
+
+    // copy the xyz triples of the `used` mesh indices into the source arrays
+    void Gather(const ArrayView<float>& triples, const std::vector<int>& used);
+
+    // per corner: slots into the position and normal buffers (NoNormal if the corner has none)
+    static constexpr uint32_t NoNormal = UINT32_MAX;
+    std::vector<uint32_t> positionIndices;
+    std::vector<uint32_t> normalIndices;
+
+    // gathered mesh positions, then normals, before their transform
+    std::vector<float> sourceX, sourceY, sourceZ;
+
+    // positions after modelViewProjection
+    std::vector<float> clipX, clipY, clipZ, clipW;
+    // positions and normals after model
+    std::vector<float> modelX, modelY, modelZ;
+    std::vector<float> normalX, normalY, normalZ;
+
+    // mesh index -> slot, UINT32_MAX when unused; only the used entries are reset between shapes
+    std::vector<uint32_t> vertexRemap, normalRemap;
+    std::vector<int> usedVertices, usedNormals;
+};
+
+#endif
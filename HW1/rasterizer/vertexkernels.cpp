@@ -0,0 +1,141 @@
+#include "vertexkernels.hpp"
+
+#include "rasterkernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define VERTEX_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define VERTEX_TARGET_AVX2
+    #else
+        #define VERTEX_TARGET_AVX2 __attribute__((target("avx2,fma")))
+    #endif
+#else
+    #define VERTEX_X86 0
+#endif
+
+// Scalar reference: plain multiplies and adds, as the build does not assume hardware FMA
+
+static void TransformPointsScalar(const glm::mat4& m, size_t count, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, float* outW)
+{
+    float* out[4] = { outX, outY, outZ, outW };
+    for (int r = 0; r != 4; ++r)
+    {
+        if (out[r] == nullptr)
+            continue;
+        for (size_t i = 0; i != count; ++i)
+            out[r][i] = m[0][r] * x[i] + m[3][r] + m[1][r] * y[i] + m[2][r] * z[i];
+    }
+}
+
+static void TransformDirectionsScalar(const glm::mat3& m, size_t count, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ)
+{
+    float* out[3] = { outX, outY, outZ };
+    for (int r = 0; r != 3; ++r)
+        for (size_t i = 0; i != count; ++i)
+            out[r][i] = m[0][r] * x[i] + m[1][r] * y[i] + m[2][r] * z[i];
+}
+
+#if VERTEX_X86
+
+// AVX2/FMA: 8 vertices per step, the remaining ones with masked loads and stores
+
+// Lanes [0, remaining) of a masked load or store
+VERTEX_TARGET_AVX2 static inline __m256i TailMask(size_t remaining)
+{
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(remaining)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+VERTEX_TARGET_AVX2 static void TransformPointsAvx2(const glm::mat4& m, size_t count, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ, float* outW)
+{
+    float* out[4] = { outX, outY, outZ, outW };
+    const size_t batched = count & ~size_t(7);
+    const __m256i tail = TailMask(count - batched);
+    for (int r = 0; r != 4; ++r)
+    {
+        if (out[r] == nullptr)
+            continue;
+        const __m256 m0 = _mm256_set1_ps(m[0][r]), m1 = _mm256_set1_ps(m[1][r]);
+        const __m256 m2 = _mm256_set1_ps(m[2][r]), m3 = _mm256_set1_ps(m[3][r]);
+        for (size_t i = 0; i != batched; i += 8)
+        {
+            __m256 v = _mm256_fmadd_ps(m0, _mm256_loadu_ps(x + i), m3);
+            v = _mm256_fmadd_ps(m1, _mm256_loadu_ps(y + i), v);
+            v = _mm256_fmadd_ps(m2, _mm256_loadu_ps(z + i), v);
+            _mm256_storeu_ps(out[r] + i, v);
+        }
+        if (batched != count)
+        {
+            __m256 v = _mm256_fmadd_ps(m0, _mm256_maskload_ps(x + batched, tail), m3);
+            v = _mm256_fmadd_ps(m1, _mm256_maskload_ps(y + batched, tail), v);
+            v = _mm256_fmadd_ps(m2, _mm256_maskload_ps(z + batched, tail), v);
+            _mm256_maskstore_ps(out[r] + batched, tail, v);
+        }
+    }
+}
+
+VERTEX_TARGET_AVX2 static void TransformDirectionsAvx2(const glm::mat3& m, size_t count, const float* x, const float* y, const float* z,
+    float* outX, float* outY, float* outZ)
+{
+    float* out[3] = { outX, outY, outZ };
+    const size_t batched = count & ~size_t(7);
+    const __m256i tail = TailMask(count - batched);
+    for (int r = 0; r != 3; ++r)
+    {
+        const __m256 m0 = _mm256_set1_ps(m[0][r]), m1 = _mm256_set1_ps(m[1][r]), m2 = _mm256_set1_ps(m[2][r]);
+        for (size_t i = 0; i != batched; i += 8)
+        {
+            __m256 v = _mm256_mul_ps(m0, _mm256_loadu_ps(x + i));
+            v = _mm256_fmadd_ps(m1, _mm256_loadu_ps(y + i), v);
+            v = _mm256_fmadd_ps(m2, _mm256_loadu_ps(z + i), v);
+            _mm256_storeu_ps(out[r] + i, v);
+        }
+        if (batched != count)
+        {
+            __m256 v = _mm256_mul_ps(m0, _mm256_maskload_ps(x + batched, tail));
+            v = _mm256_fmadd_ps(m1, _mm256_maskload_ps(y + batched, tail), v);
+            v = _mm256_fmadd_ps(m2, _mm256_maskload_ps(z + batched, tail), v);
+            _mm256_maskstore_ps(out[r] + batched, tail, v);
+        }
+    }
+}
+
+static bool DetectFma()
+{
+    #if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 12)) != 0;
+    #else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("fma");
+    #endif
+}
+
+#endif
+
+const VertexKernels& GetVertexKernels(SimdLevel level)
+{
+    static const VertexKernels scalar{ SimdLevel::SCALAR, TransformPointsScalar, TransformDirectionsScalar };
+#if VERTEX_X86
+    static const VertexKernels avx2{ SimdLevel::AVX2, TransformPointsAvx2, TransformDirectionsAvx2 };
+    static const bool supported = DetectSimdLevel() == SimdLevel::AVX2 && DetectFma();
+
+    if ((level == SimdLevel::AUTO || level == SimdLevel::AVX2) && supported)
+        return avx2;
+#endif
+    return scalar;
+}
+
+glm::mat3 NormalMatrix(const glm::mat4& model)
+{
+    glm::mat3 linear(model);
+    // a singular matrix flattens the mesh; its normals are left to the linear part rather than becoming NaN
+    if (glm::determinant(linear) == 0.f)
+        return linear;
+    return glm::transpose(glm::inverse(linear));
+}
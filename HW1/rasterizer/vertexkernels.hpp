@@ -0,0 +1,37 @@
+#ifndef VERTEXKERNELS_H
+#define VERTEXKERNELS_H
+
+#include <cstddef>
+
+#include "loader.hpp"
+
+#include "../thirdparty/glm/glm.hpp"
+
+// Batched transforms of the vertex stage over structure-of-arrays data. Every output row is
+//  summed in the same order, starting from the translation. The AVX2/FMA implementation fuses
+//  each multiply-add, so it may differ from the scalar reference, which serves every other level
+//  and CPUs without FMA, in the last bit.
+struct VertexKernels
+{
+    SimdLevel level;
+
+    /**
+     * out = matrix * (x, y, z, 1) for `count` points.
+     * @param outW: null when only the first three rows are needed, as for affine model matrices
+     */
+    void (*TransformPoints)(const glm::mat4& matrix, size_t count, const float* x, const float* y, const float* z,
+        float* outX, float* outY, float* outZ, float* outW);
+
+    // out = matrix * (x, y, z) for `count` directions, such as normals
+    void (*TransformDirections)(const glm::mat3& matrix, size_t count, const float* x, const float* y, const float* z,
+        float* outX, float* outY, float* outZ);
+};
+
+// Kernels for the requested level, resolved as GetRasterKernels does; AVX2 also needs FMA
+const VertexKernels& GetVertexKernels(SimdLevel level = SimdLevel::AUTO);
+
+// The matrix that carries normals along with `model`: the inverse transpose of its linear part,
+//  which keeps them perpendicular to the surface under non-uniform scaling and ignores translation
+glm::mat3 NormalMatrix(const glm::mat4& model);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef VISIBILITYBUFFER_H
+#define VISIBILITYBUFFER_H
+
+#include <cstdint>
+
+#include "entities.hpp"
+#include "image.hpp"
+
+#include "../thirdparty/glm/glm.hpp"
+
+// Per-pixel record of the nearest triangle, written by the depth pass and resolved
+//  by a separate shading pass that shades every covered pixel exactly once.
+struct VisibilityBuffer
+{
+    // id of pixels that no triangle covers
+    static constexpr uint32_t Empty = UINT32_MAX;
+
+    // index of the nearest triangle in the frame's triangle list
+    ImageBuffer<uint32_t> ids;
+    // barycentric weights of vertices 0 and 1 at the pixel center; vertex 2 gets the rest
+    ImageBuffer<glm::vec2> barycentrics;
+
+    VisibilityBuffer(uint32_t width, uint32_t height) :
+        ids(width, height), barycentrics(width, height) {  }
+
+    // Mark the pixels of `rect` as uncovered
+    inline void Clear(const TileRect& rect)
+    {
+        for (uint32_t y = rect.y0; y < rect.y1; ++y)
+            std::fill(ids.Row(y) + rect.x0, ids.Row(y) + rect.x1, Empty);
+    }
+};
+
+#endif
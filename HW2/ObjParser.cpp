@@ -0,0 +1,652 @@
+#include "ObjParser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <thread>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+// chunks are sized so that every thread gets a few of them, within these bounds
+constexpr size_t MIN_CHUNK_BYTES = size_t(256) << 10;
+constexpr size_t MAX_CHUNK_BYTES = size_t(16) << 20;
+
+/**
+ * @brief a state change between faces, applying to the faces of its chunk parsed after it
+*/
+struct ObjCommand {
+    enum class Kind { object, group, material, library, smoothing };
+
+    Kind kind;
+    size_t face;            // faces of the chunk before the command
+    size_t triangle = 0;    // triangles of the chunk before the command, set by triangulate()
+    size_t line;
+    std::string value;      // object or group name, material name or library list
+    unsigned int smoothing = 0;
+};
+
+/**
+ * @brief a face corner with a negative index, which is only resolved within its chunk until the
+ * number of records before the chunk is known
+*/
+struct ObjRelativeIndex {
+    size_t corner;
+    size_t line;
+    int field;              // 0 vertex, 1 normal, 2 texcoord
+};
+
+struct ObjMessage {
+    size_t line;            // line in the chunk, 0 when the message is not about a line
+    std::string text;
+};
+
+/**
+ * @brief one piece of the file, cut on line boundaries, and what was read from it
+*/
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+    size_t lines = 0;
+    size_t firstLine = 0;
+
+    std::vector<float> vertices, normals, texcoords;
+    size_t vertexOffset = 0, normalOffset = 0, texcoordOffset = 0;
+
+    std::vector<tinyobj::index_t> corners;
+    std::vector<unsigned int> faceSizes;
+    std::vector<ObjCommand> commands;
+    std::vector<ObjRelativeIndex> relative;
+    std::vector<tinyobj::index_t> triangles;    // three corners per triangle, in face order
+
+    std::vector<ObjMessage> warnings;
+    ObjMessage error {0, ""};
+};
+
+/**
+ * @brief triangles [first, last) of a chunk, all in one shape with one material and smoothing group
+*/
+struct ObjRun {
+    size_t chunk;
+    size_t first, last;
+    size_t shape;
+    size_t offset;          // triangles of the shape before the run
+    int material;
+    unsigned int smoothing;
+};
+
+static const std::string FACE_ERROR = "Failed to parse `f' line (e.g. a zero value for vertex index "
+    "or invalid relative vertex index).";
+
+static void parallelFor(size_t count, const std::function<void(size_t)>& job) {
+    size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count);
+    if (threadCount <= 1) {
+        for (size_t i = 0; i < count; i++) job(i);
+        return;
+    }
+    std::atomic<size_t> next {0};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; t++) {
+        threads.emplace_back([&]() {
+            for (size_t i = next++; i < count; i = next++) job(i);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+}
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static const char* skipSpace(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) p++;
+    return p;
+}
+
+static const char* tokenEnd(const char* p, const char* end) {
+    while (p < end && !isSpace(*p) && *p != '\r') p++;
+    return p;
+}
+
+static float parseReal(const char*& p, const char* end) {
+    p = skipSpace(p, end);
+    const char* last = tokenEnd(p, end);
+    const char* first = (p < last && *p == '+') ? p + 1 : p;
+    float value = 0.f;
+#if defined(__cpp_lib_to_chars)
+    auto result = std::from_chars(first, last, value);
+    if (result.ec != std::errc() || result.ptr != last) value = 0.f;
+#else
+    std::string token(first, last);
+    char* parsed = nullptr;
+    value = std::strtof(token.c_str(), &parsed);
+    if (parsed != token.c_str() + token.size()) value = 0.f;
+#endif
+    p = last;
+    return value;
+}
+
+/**
+ * @brief atoi: optional spaces and sign, then as many digits as there are
+*/
+static int parseInt(const char* p, const char* end) {
+    while (p < end && (isSpace(*p) || *p == '\r')) p++;
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-')) negative = (*p++ == '-');
+    int value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) value = value * 10 + (*p - '0');
+    return negative ? -value : value;
+}
+
+static const char* fieldEnd(const char* p, const char* end) {
+    while (p < end && *p != '/' && !isSpace(*p) && *p != '\r') p++;
+    return p;
+}
+
+static std::string parseString(const char*& p, const char* end) {
+    p = skipSpace(p, end);
+    const char* last = tokenEnd(p, end);
+    std::string value(p, last);
+    p = last;
+    return value;
+}
+
+/**
+ * @brief turn a 1-based or negative OBJ index into a 0-based one, negative ones relative to the
+ * `count` records of the chunk; returns false if the index is invalid
+*/
+static bool fixIndex(ObjChunk& chunk, int index, size_t count, int field, bool allowZero, int& out) {
+    if (index > 0) {
+        out = index - 1;
+        return true;
+    }
+    if (index == 0) {
+        chunk.warnings.push_back({chunk.lines, "A zero value index found (will have a value of -1 for normal and tex indices."});
+        out = -1;
+        return allowZero;
+    }
+    out = static_cast<int>(count) + index;
+    chunk.relative.push_back({chunk.corners.size(), chunk.lines, field});
+    return true;
+}
+
+/**
+ * @brief v, v//vn, v/vt or v/vt/vn
+*/
+static bool parseCorner(ObjChunk& chunk, const char*& p, const char* end, tinyobj::index_t& corner) {
+    corner.vertex_index = corner.normal_index = corner.texcoord_index = -1;
+    if (!fixIndex(chunk, parseInt(p, end), chunk.vertices.size() / 3, 0, false, corner.vertex_index)) return false;
+    p = fieldEnd(p, end);
+    if (p == end || *p != '/') return true;
+    p++;
+
+    if (p < end && *p == '/') {
+        p++;
+        if (!fixIndex(chunk, parseInt(p, end), chunk.normals.size() / 3, 1, true, corner.normal_index)) return false;
+        p = fieldEnd(p, end);
+        return true;
+    }
+
+    if (!fixIndex(chunk, parseInt(p, end), chunk.texcoords.size() / 2, 2, true, corner.texcoord_index)) return false;
+    p = fieldEnd(p, end);
+    if (p == end || *p != '/') return true;
+    p++;
+
+    if (!fixIndex(chunk, parseInt(p, end), chunk.normals.size() / 3, 1, true, corner.normal_index)) return false;
+    p = fieldEnd(p, end);
+    return true;
+}
+
+/**
+ * @brief read one line without its line break, returns false on a malformed face
+*/
+static bool parseLine(ObjChunk& chunk, const char* p, const char* end) {
+    p = skipSpace(p, end);
+    if (p == end || *p == '#') return true;
+    const size_t length = static_cast<size_t>(end - p);
+
+    if (p[0] == 'v' && length > 1 && isSpace(p[1])) {
+        p += 2;
+        for (int i = 0; i < 3; i++) chunk.vertices.push_back(parseReal(p, end));
+        return true;
+    }
+    if (p[0] == 'v' && length > 2 && p[1] == 'n' && isSpace(p[2])) {
+        p += 3;
+        for (int i = 0; i < 3; i++) chunk.normals.push_back(parseReal(p, end));
+        return true;
+    }
+    if (p[0] == 'v' && length > 2 && p[1] == 't' && isSpace(p[2])) {
+        p += 3;
+        for (int i = 0; i < 2; i++) chunk.texcoords.push_back(parseReal(p, end));
+        return true;
+    }
+
+    if (p[0] == 'f' && length > 1 && isSpace(p[1])) {
+        p = skipSpace(p + 2, end);
+        size_t first = chunk.corners.size();
+        while (p < end) {
+            tinyobj::index_t corner;
+            if (!parseCorner(chunk, p, end, corner)) {
+                chunk.error = {chunk.lines, FACE_ERROR};
+                return false;
+            }
+            chunk.corners.push_back(corner);
+            while (p < end && (isSpace(*p) || *p == '\r')) p++;
+        }
+        chunk.faceSizes.push_back(static_cast<unsigned int>(chunk.corners.size() - first));
+        return true;
+    }
+
+    ObjCommand command {ObjCommand::Kind::object, chunk.faceSizes.size(), 0, chunk.lines, ""};
+    if (length >= 6 && std::strncmp(p, "usemtl", 6) == 0) {
+        p += 6;
+        command.kind = ObjCommand::Kind::material;
+        command.value = parseString(p, end);
+    } else if (length > 6 && std::strncmp(p, "mtllib", 6) == 0 && isSpace(p[6])) {
+        command.kind = ObjCommand::Kind::library;
+        command.value.assign(p + 7, end);
+    } else if (p[0] == 'g' && length > 1 && isSpace(p[1])) {
+        // the names after `g`, joined by single spaces
+        command.kind = ObjCommand::Kind::group;
+        parseString(p, end);
+        while (true) {
+            while (p < end && (isSpace(*p) || *p == '\r')) p++;
+            if (p == end) break;
+            if (!command.value.empty()) command.value += ' ';
+            command.value += parseString(p, end);
+        }
+    } else if (p[0] == 'o' && length > 1 && isSpace(p[1])) {
+        command.kind = ObjCommand::Kind::object;
+        command.value.assign(p + 2, end);
+    } else if (p[0] == 's' && length > 1 && isSpace(p[1])) {
+        p = skipSpace(p + 2, end);
+        if (p == end || *p == '\r') return true;
+        command.kind = ObjCommand::Kind::smoothing;
+        if (end - p >= 3 && std::strncmp(p, "off", 3) == 0) {
+            command.smoothing = 0;
+        } else {
+            command.smoothing = static_cast<unsigned int>(std::max(0, parseInt(p, end)));
+        }
+    } else {
+        return true; // records the ray tracer does not use
+    }
+
+    chunk.commands.push_back(std::move(command));
+    return true;
+}
+
+static void parseChunk(ObjChunk& chunk) {
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(chunk.end - p)));
+        if (lineEnd == nullptr) lineEnd = chunk.end;
+        const char* end = (lineEnd > p && lineEnd[-1] == '\r') ? lineEnd - 1 : lineEnd;
+
+        chunk.lines++;
+        if (!parseLine(chunk, p, end)) return;
+        p = (lineEnd < chunk.end) ? lineEnd + 1 : chunk.end;
+    }
+}
+
+static int pointInTriangle(const float* x, const float* y, float testX, float testY) {
+    int inside = 0;
+    for (int i = 0, j = 2; i < 3; j = i++) {
+        if (((y[i] > testY) != (y[j] > testY)) &&
+            (testX < (x[j] - x[i]) * (testY - y[i]) / (y[j] - y[i]) + x[i])) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+/**
+ * @brief split a polygon of more than four corners by ear clipping, in the plane of the two axes
+ * its first corner spans, the same way as tinyobj's built-in triangulation
+*/
+static void clipEars(const tinyobj::index_t* face, size_t count, const std::vector<float>& v,
+              std::vector<tinyobj::index_t>& triangles) {
+    size_t axes[2] = {1, 2};
+    for (size_t k = 0; k < count; k++) {
+        size_t vi0 = size_t(face[k % count].vertex_index);
+        size_t vi1 = size_t(face[(k + 1) % count].vertex_index);
+        size_t vi2 = size_t(face[(k + 2) % count].vertex_index);
+        if (3 * vi0 + 2 >= v.size() || 3 * vi1 + 2 >= v.size() || 3 * vi2 + 2 >= v.size()) continue;
+
+        float e0x = v[vi1 * 3] - v[vi0 * 3], e0y = v[vi1 * 3 + 1] - v[vi0 * 3 + 1], e0z = v[vi1 * 3 + 2] - v[vi0 * 3 + 2];
+        float e1x = v[vi2 * 3] - v[vi1 * 3], e1y = v[vi2 * 3 + 1] - v[vi1 * 3 + 1], e1z = v[vi2 * 3 + 2] - v[vi1 * 3 + 2];
+        float cx = std::fabs(e0y * e1z - e0z * e1y);
+        float cy = std::fabs(e0z * e1x - e0x * e1z);
+        float cz = std::fabs(e0x * e1y - e0y * e1x);
+        const float epsilon = std::numeric_limits<float>::epsilon();
+        if (cx > epsilon || cy > epsilon || cz > epsilon) {
+            if (!(cx > cy && cx > cz)) {
+                axes[0] = 0;
+                if (cz > cx && cz > cy) axes[1] = 1;
+            }
+            break;
+        }
+    }
+
+    std::vector<tinyobj::index_t> remaining(face, face + count);
+    size_t guess = 0;
+    size_t iterationsLeft = count;
+    size_t previousRemaining = remaining.size();
+    while (remaining.size() > 3 && iterationsLeft > 0) {
+        size_t n = remaining.size();
+        if (guess >= n) guess -= n;
+        if (previousRemaining != n) {
+            previousRemaining = n;
+            iterationsLeft = n;
+        } else {
+            iterationsLeft--;
+        }
+
+        tinyobj::index_t ear[3];
+        float x[3], y[3];
+        for (size_t k = 0; k < 3; k++) {
+            ear[k] = remaining[(guess + k) % n];
+            size_t vi = size_t(ear[k].vertex_index);
+            bool valid = vi * 3 + axes[0] < v.size() && vi * 3 + axes[1] < v.size();
+            x[k] = valid ? v[vi * 3 + axes[0]] : 0.f;
+            y[k] = valid ? v[vi * 3 + axes[1]] : 0.f;
+        }
+
+        // skip internal angles
+        float cross = (x[1] - x[0]) * (y[2] - y[1]) - (y[1] - y[0]) * (x[2] - x[1]);
+        float area = (x[0] * y[1] - y[0] * x[1]) * 0.5f;
+        if (cross * area < 0.f) {
+            guess++;
+            continue;
+        }
+
+        // and ears with another corner inside
+        bool overlap = false;
+        for (size_t other = 3; other < n; other++) {
+            size_t vi = size_t(remaining[(guess + other) % n].vertex_index);
+            if (vi * 3 + axes[0] >= v.size() || vi * 3 + axes[1] >= v.size()) continue;
+            if (pointInTriangle(x, y, v[vi * 3 + axes[0]], v[vi * 3 + axes[1]])) {
+                overlap = true;
+                break;
+            }
+        }
+        if (overlap) {
+            guess++;
+            continue;
+        }
+
+        triangles.insert(triangles.end(), ear, ear + 3);
+        remaining.erase(remaining.begin() + static_cast<std::ptrdiff_t>((guess + 1) % n));
+    }
+
+    if (remaining.size() == 3) triangles.insert(triangles.end(), remaining.begin(), remaining.end());
+}
+
+/**
+ * @brief split the faces of a chunk into triangles: quads along their shorter diagonal,
+ * larger polygons by ear clipping
+*/
+static void triangulate(ObjChunk& chunk, const std::vector<float>& v) {
+    chunk.triangles.reserve(chunk.corners.size());
+    size_t command = 0;
+    size_t corner = 0;
+    for (size_t f = 0; f < chunk.faceSizes.size(); f++) {
+        while (command < chunk.commands.size() && chunk.commands[command].face == f) {
+            chunk.commands[command++].triangle = chunk.triangles.size() / 3;
+        }
+
+        const tinyobj::index_t* face = &chunk.corners[corner];
+        const size_t count = chunk.faceSizes[f];
+        corner += count;
+
+        if (count < 3) {
+            chunk.warnings.push_back({0, "Degenerated face found."});
+        } else if (count == 3) {
+            chunk.triangles.insert(chunk.triangles.end(), face, face + 3);
+        } else if (count == 4) {
+            size_t vi[4];
+            bool valid = true;
+            for (int k = 0; k < 4; k++) {
+                vi[k] = size_t(face[k].vertex_index);
+                valid = valid && 3 * vi[k] + 2 < v.size();
+            }
+            if (!valid) {
+                chunk.warnings.push_back({0, "Face with invalid vertex index found."});
+                continue;
+            }
+            float e02x = v[vi[2] * 3] - v[vi[0] * 3], e02y = v[vi[2] * 3 + 1] - v[vi[0] * 3 + 1], e02z = v[vi[2] * 3 + 2] - v[vi[0] * 3 + 2];
+            float e13x = v[vi[3] * 3] - v[vi[1] * 3], e13y = v[vi[3] * 3 + 1] - v[vi[1] * 3 + 1], e13z = v[vi[3] * 3 + 2] - v[vi[1] * 3 + 2];
+            if (e02x * e02x + e02y * e02y + e02z * e02z < e13x * e13x + e13y * e13y + e13z * e13z) {
+                chunk.triangles.insert(chunk.triangles.end(), {face[0], face[1], face[2], face[0], face[2], face[3]});
+            } else {
+                chunk.triangles.insert(chunk.triangles.end(), {face[0], face[1], face[3], face[1], face[2], face[3]});
+            }
+        } else {
+            clipEars(face, count, v, chunk.triangles);
+        }
+    }
+    while (command < chunk.commands.size()) chunk.commands[command++].triangle = chunk.triangles.size() / 3;
+}
+
+/**
+ * @brief the file names of an mtllib line, separated by spaces, where a backslash escapes the next character
+*/
+static std::vector<std::string> splitLibraries(const std::string& line) {
+    std::vector<std::string> names;
+    std::string name;
+    bool escaping = false;
+    for (char c : line) {
+        if (!escaping && c == '\\') {
+            escaping = true;
+            continue;
+        }
+        if (!escaping && c == ' ') {
+            if (!name.empty()) names.push_back(name);
+            name.clear();
+            continue;
+        }
+        escaping = false;
+        name += c;
+    }
+    names.push_back(name);
+    return names;
+}
+
+static std::string lineMessage(const ObjChunk& chunk, const ObjMessage& message) {
+    if (message.line == 0) return message.text + "\n";
+    return message.text + " Line " + std::to_string(chunk.firstLine + message.line) + ").\n";
+}
+
+bool ObjParser::parseFromFile(const std::string& filename, const std::string& mtlSearchPath) {
+    attrib = tinyobj::attrib_t();
+    shapes.clear();
+    materials.clear();
+    warnings.clear();
+    errors.clear();
+
+    std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+    if (!ifs) {
+        errors = "Cannot open file [" + filename + "]\n";
+        return false;
+    }
+    std::string text(static_cast<size_t>(ifs.tellg()), '\0');
+    ifs.seekg(0);
+    if (!ifs.read(text.data(), static_cast<std::streamsize>(text.size()))) {
+        errors = "Cannot read file [" + filename + "]\n";
+        return false;
+    }
+
+    // materials are looked up next to the model unless a search path is given
+    std::string searchPath = mtlSearchPath;
+    if (searchPath.empty()) {
+        size_t slash = filename.find_last_of("/\\");
+        if (slash != std::string::npos) searchPath = filename.substr(0, slash);
+    }
+
+    // cut the file into chunks ending on line breaks
+    const size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    const size_t chunkBytes = std::clamp(text.size() / (threadCount * 4), MIN_CHUNK_BYTES, MAX_CHUNK_BYTES);
+    std::vector<ObjChunk> chunks;
+    for (size_t begin = 0; begin < text.size();) {
+        size_t end = std::min(text.size(), begin + chunkBytes);
+        if (end < text.size()) {
+            size_t lineBreak = text.find('\n', end);
+            end = (lineBreak == std::string::npos) ? text.size() : lineBreak + 1;
+        }
+        chunks.emplace_back();
+        chunks.back().begin = text.data() + begin;
+        chunks.back().end = text.data() + end;
+        begin = end;
+    }
+
+    parallelFor(chunks.size(), [&](size_t c) { parseChunk(chunks[c]); });
+
+    size_t vertexCount = 0, normalCount = 0, texcoordCount = 0, lines = 0;
+    for (auto& chunk : chunks) {
+        chunk.firstLine = lines;
+        chunk.vertexOffset = vertexCount;
+        chunk.normalOffset = normalCount;
+        chunk.texcoordOffset = texcoordCount;
+        lines += chunk.lines;
+        vertexCount += chunk.vertices.size() / 3;
+        normalCount += chunk.normals.size() / 3;
+        texcoordCount += chunk.texcoords.size() / 2;
+        if (!chunk.error.text.empty()) {
+            errors = lineMessage(chunk, chunk.error);
+            return false;
+        }
+    }
+
+    // concatenate the records, resolve relative indices against earlier chunks and triangulate
+    attrib.vertices.resize(3 * vertexCount);
+    attrib.normals.resize(3 * normalCount);
+    attrib.texcoords.resize(2 * texcoordCount);
+    parallelFor(chunks.size(), [&](size_t c) {
+        ObjChunk& chunk = chunks[c];
+        std::copy(chunk.vertices.begin(), chunk.vertices.end(), attrib.vertices.begin() + 3 * chunk.vertexOffset);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), attrib.normals.begin() + 3 * chunk.normalOffset);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), attrib.texcoords.begin() + 2 * chunk.texcoordOffset);
+
+        for (const auto& relative : chunk.relative) {
+            tinyobj::index_t& corner = chunk.corners[relative.corner];
+            int& index = relative.field == 0 ? corner.vertex_index : (relative.field == 1 ? corner.normal_index : corner.texcoord_index);
+            index += static_cast<int>(relative.field == 0 ? chunk.vertexOffset : (relative.field == 1 ? chunk.normalOffset : chunk.texcoordOffset));
+            if (index < 0 && chunk.error.text.empty()) chunk.error = {relative.line, FACE_ERROR};
+        }
+
+        triangulate(chunk, attrib.vertices);
+    });
+
+    for (const auto& chunk : chunks) {
+        if (!chunk.error.text.empty()) {
+            errors = lineMessage(chunk, chunk.error);
+            return false;
+        }
+    }
+
+    // replay the commands in file order: `o` and `g` start a new shape, kept only if it gets a triangle
+    tinyobj::MaterialFileReader materialReader(searchPath);
+    std::map<std::string, int> materialMap;
+    std::vector<std::string> libraries;
+    std::string name;
+    int material = -1;
+    unsigned int smoothing = 0;
+    size_t shape = SIZE_MAX;
+
+    std::vector<ObjRun> runs;
+    std::vector<size_t> shapeTriangles;
+    auto addRun = [&](size_t c, size_t first, size_t last) {
+        if (first == last) return;
+        if (shape == SIZE_MAX) {
+            shape = shapes.size();
+            shapes.emplace_back();
+            shapes.back().name = name;
+            shapeTriangles.push_back(0);
+        }
+        runs.push_back({c, first, last, shape, shapeTriangles[shape], material, smoothing});
+        shapeTriangles[shape] += last - first;
+    };
+
+    for (size_t c = 0; c < chunks.size(); c++) {
+        const ObjChunk& chunk = chunks[c];
+        size_t first = 0;
+        for (const auto& command : chunk.commands) {
+            addRun(c, first, command.triangle);
+            first = command.triangle;
+
+            if (command.kind == ObjCommand::Kind::object || command.kind == ObjCommand::Kind::group) {
+                shape = SIZE_MAX;
+                name = command.value;
+                if (command.kind == ObjCommand::Kind::group && name.empty()) {
+                    warnings += "Empty group name. line: " + std::to_string(chunk.firstLine + command.line) + "\n";
+                }
+            } else if (command.kind == ObjCommand::Kind::material) {
+                auto found = materialMap.find(command.value);
+                if (found == materialMap.end()) warnings += "material [ '" + command.value + "' ] not found in .mtl\n";
+                material = found == materialMap.end() ? -1 : found->second;
+            } else if (command.kind == ObjCommand::Kind::library) {
+                bool found = false;
+                for (const auto& library : splitLibraries(command.value)) {
+                    if (std::find(libraries.begin(), libraries.end(), library) != libraries.end()) {
+                        found = true;
+                        continue;
+                    }
+                    std::string libraryWarning, libraryError;
+                    bool loaded = materialReader(library, &materials, &materialMap, &libraryWarning, &libraryError);
+                    warnings += libraryWarning;
+                    errors += libraryError;
+                    if (loaded) {
+                        found = true;
+                        libraries.push_back(library);
+                        break;
+                    }
+                }
+                if (!found) warnings += "Failed to load material file(s). Use default material.\n";
+            } else {
+                smoothing = command.smoothing;
+            }
+        }
+        addRun(c, first, chunk.triangles.size() / 3);
+    }
+
+    // fill every run into its own range of its shape
+    for (size_t s = 0; s < shapes.size(); s++) {
+        tinyobj::mesh_t& mesh = shapes[s].mesh;
+        mesh.indices.resize(3 * shapeTriangles[s]);
+        mesh.num_face_vertices.resize(shapeTriangles[s]);
+        mesh.material_ids.resize(shapeTriangles[s]);
+        mesh.smoothing_group_ids.resize(shapeTriangles[s]);
+    }
+    parallelFor(runs.size(), [&](size_t r) {
+        const ObjRun& run = runs[r];
+        const ObjChunk& chunk = chunks[run.chunk];
+        tinyobj::mesh_t& mesh = shapes[run.shape].mesh;
+        std::copy(chunk.triangles.begin() + 3 * run.first, chunk.triangles.begin() + 3 * run.last, mesh.indices.begin() + 3 * run.offset);
+        const size_t count = run.last - run.first;
+        std::fill_n(mesh.num_face_vertices.begin() + run.offset, count, 3u);
+        std::fill_n(mesh.material_ids.begin() + run.offset, count, run.material);
+        std::fill_n(mesh.smoothing_group_ids.begin() + run.offset, count, run.smoothing);
+    });
+
+    int greatest[3] = {-1, -1, -1};
+    for (const auto& chunk : chunks) {
+        for (const auto& message : chunk.warnings) warnings += lineMessage(chunk, message);
+        for (const auto& corner : chunk.corners) {
+            greatest[0] = std::max(greatest[0], corner.vertex_index);
+            greatest[1] = std::max(greatest[1], corner.normal_index);
+            greatest[2] = std::max(greatest[2], corner.texcoord_index);
+        }
+    }
+    if (greatest[0] >= static_cast<int>(vertexCount)) warnings += "Vertex indices out of bounds.\n";
+    if (greatest[1] >= static_cast<int>(normalCount)) warnings += "Vertex normal indices out of bounds.\n";
+    if (greatest[2] >= static_cast<int>(texcoordCount)) warnings += "Vertex texcoord indices out of bounds.\n";
+
+    return true;
+}
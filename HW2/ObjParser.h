@@ -0,0 +1,36 @@
+#pragma once
+
+#include "tiny_obj_loader.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Wavefront OBJ reader that parses a file on all hardware threads, in place of tinyobj::ObjReader
+ * with its default configuration (triangulation on, simple ear clipping).
+ * The file is cut into chunks on line boundaries that are parsed concurrently; their vertices are then
+ * concatenated, relative indices resolved and faces triangulated and grouped into shapes exactly as
+ * tinyobj does. Only v, vn, vt, f, o, g, s, usemtl and mtllib are read.
+*/
+class ObjParser {
+public:
+    /**
+     * @brief parse `filename`, returns false on a malformed file with the reason in error()
+     * @param mtlSearchPath where the material libraries named by `mtllib` are looked up,
+     * the directory of `filename` when empty
+    */
+    bool parseFromFile(const std::string& filename, const std::string& mtlSearchPath = "");
+
+    const tinyobj::attrib_t& getAttrib() const { return attrib; }
+    const std::vector<tinyobj::shape_t>& getShapes() const { return shapes; }
+    const std::vector<tinyobj::material_t>& getMaterials() const { return materials; }
+    const std::string& warning() const { return warnings; }
+    const std::string& error() const { return errors; }
+
+private:
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warnings;
+    std::string errors;
+};
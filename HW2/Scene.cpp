@@ -2,9 +2,7 @@
 #include "Config.h"
 #include <iostream>
 #include <filesystem>
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
+#include <cassert>
 
 
 Vec3 Scene::trace(const Ray &ray, int bouncesLeft, bool discardEmission) {
@@ -18,23 +16,21 @@ Vec3 Scene::trace(const Ray &ray, int bouncesLeft, bool discardEmission) {
     return {};
 }
 
-tinyobj::ObjReader Scene::reader {};
-
 void Scene::addObjects(std::string_view modelPath, std::string_view searchPath) {
-    tinyobj::ObjReaderConfig config;
-    config.mtl_search_path = searchPath;
-    if (!reader.ParseFromFile(std::string(modelPath), config)) {
-        if (!reader.Error().empty()) {
-            std::cerr << "TinyObjReader: " << reader.Error();
+    // large models are parsed on all hardware threads
+    ObjParser reader;
+    if (!reader.parseFromFile(std::string(modelPath), std::string(searchPath))) {
+        if (!reader.error().empty()) {
+            std::cerr << "ObjParser: " << reader.error();
             std::filesystem::path relative(modelPath);
             std::cerr << "Reading file " << std::filesystem::absolute(relative) << " error. File may be malformed or not exist.\n";
         }
         exit(1);
     }
 
-    auto& attrib = reader.GetAttrib();
-    auto& shapes = reader.GetShapes();
-    auto& materials = reader.GetMaterials();
+    auto& attrib = reader.getAttrib();
+    auto& shapes = reader.getShapes();
+    auto& materials = reader.getMaterials();
 
     // Loop over shapes
     for (size_t s = 0; s < shapes.size(); s++) {
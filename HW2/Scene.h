@@ -1,6 +1,6 @@
 #pragma once
 
-#include "tiny_obj_loader.h"
+#include "ObjParser.h"
 #include "Accel.h"
 
 #include <string>
@@ -8,7 +8,6 @@
 
 class Scene {
 public:
-    static tinyobj::ObjReader reader;
     std::vector<Object*> objects;
     std::vector<Object*> lights;
     BVH bvh;